@@ -70,12 +70,9 @@ extern const char *g_aiaStorageFolder;
 extern char *g_aiaLwaRefreshToken;
 extern char *g_aiaLwaClientId;
 
-/** The amount of audio data to keep in the microphone buffer. */
-#define AMOUNT_OF_AUDIO_DATA_IN_MIC_BUFFER ( (AiaDurationMs_t)10000 )
-
-/** Buffer size in samples. */
-#define MIC_BUFFER_SIZE_IN_SAMPLES \
-    ( ( size_t )( AMOUNT_OF_AUDIO_DATA_IN_MIC_BUFFER * AIA_MICROPHONE_SAMPLE_RATE_HZ / AIA_MS_PER_SECOND ) )
+/** Buffer size in samples for a given amount of audio data. */
+#define MIC_BUFFER_SIZE_IN_SAMPLES( _historyMs ) \
+    ( ( size_t )( (uint64_t)( _historyMs ) * AIA_MICROPHONE_SAMPLE_RATE_HZ / AIA_MS_PER_SECOND ) )
 
 #ifdef AIA_DEMO_AUDIO_ENABLE
 /**
@@ -111,6 +108,7 @@ char *AIA_DEMO_CASE_TO_STRING[] = {
 #define AIA_EVENT_CAP_CHANGED ( 0x1 << 2 )
 #define AIA_EVENT_REGISTERED ( 0x1 << 3 )
 #define AIA_EVENT_DUMMY ( 0x1 << 4 )
+#define AIA_EVENT_CLOCK_SYNCHRONIZED ( 0x1 << 5 )
 
 static EventGroupHandle_t aia_eg;
 
@@ -120,12 +118,20 @@ static EventGroupHandle_t aia_eg;
 #define AIA_DEMO_EG_SET( _event ) xEventGroupSetBits( aia_eg, _event )
 #define AIA_DEMO_EG_GET() xEventGroupGetBits( aia_eg )
 
-/** Buffer size in bytes; */
-static const size_t MIC_BUFFER_SIZE_IN_BYTES = MIC_BUFFER_SIZE_IN_SAMPLES * AIA_MICROPHONE_BUFFER_WORD_SIZE;
+/** Buffer size in bytes for a given amount of audio data. */
+#define MIC_BUFFER_SIZE_IN_BYTES( _historyMs ) \
+    ( MIC_BUFFER_SIZE_IN_SAMPLES( _historyMs ) * AIA_MICROPHONE_BUFFER_WORD_SIZE )
 
 /** Arbitrary. */
 static const size_t MIC_NUM_READERS = 2;
 
+/**
+ * Whether the microphone is released under memory pressure while no client
+ * uses it. This only frees memory when its buffer comes from the heap.
+ */
+#define AIA_SAMPLE_APP_RELEASE_MICROPHONE \
+    ( AIA_MEMORY_BUDGET_ENABLE && !AIA_SAMPLE_APP_STATIC_ALLOCATION )
+
 /** @name Methods that simply print states to stdout. */
 /** @{ */
 static void onAiaConnectionSuccessfulSimpleUI( void *userData );
@@ -200,6 +206,16 @@ static void onPlayOfflineAlertTone( void* userData );
 static bool onStopOfflineAlertTone( void* userData );
 #endif
 
+#ifdef AIA_ENABLE_CLOCK
+/**
+ * Callback from the clock port once the clock has been synchronized with the
+ * service.
+ *
+ * @param userData Context for this callback.
+ */
+static void onClockSynchronized( void *userData );
+#endif
+
 /**
  * Processes inputted command from a user.
  *
@@ -224,6 +240,13 @@ static bool initAiaClient( AiaSampleApp_t *sampleApp );
  */
 static bool registerAia( AiaSampleApp_t *sampleApp );
 
+/**
+ * Drops the registration in progress and its staged storage writes, and stops the demo.
+ *
+ * @param sampleApp The @c AiaSampleApp_t that was registering.
+ */
+static void failRegistration( AiaSampleApp_t *sampleApp );
+
 /**
  * Container of all components necessary for the client to run.
  */
@@ -245,6 +268,17 @@ struct AiaSampleApp
     /** Used to capture and write microphone data to the @c microphoneBuffer. */
     AiaMicrophoneBufferWriter_t *microphoneBufferWriter;
 
+    /** The amount of audio data @c microphoneBuffer holds. */
+    AiaDurationMs_t microphoneHistoryMs;
+
+    /** The amount of audio data requested through @c
+     * AiaSampleApp_SetMicrophoneHistory(). Accessed atomically. */
+    uint32_t requestedMicrophoneHistoryMs;
+
+    /** Held while the microphone is created or destroyed, and for as long as
+     * @c aiaClient holds @c microphoneBufferReader. */
+    AiaMutex_t microphoneMutex;
+
     /** The Aia client. */
     AiaClient_t *aiaClient;
 
@@ -269,6 +303,11 @@ struct AiaSampleApp
     /** Pointer to the offline alert that is currently being played */
     AiaAlertSlot_t* offlineAlertInProgress;
 
+#if AIA_SAMPLE_APP_STATIC_ALLOCATION
+    /** Storage for @c offlineAlertInProgress. */
+    AiaAlertSlot_t offlineAlertStorage;
+#endif
+
     /** Keeps track of the time offline alert playback started at */
     AiaTimepointSeconds_t offlineAlertPlaybackStartTime;
 #endif
@@ -300,73 +339,133 @@ struct AiaSampleApp
     AiaCapabilitiesSenderState_t capState;
 };
 
-AiaSampleApp_t *AiaSampleApp_Create( AiaMqttConnectionPointer_t mqttConnection, const char *iotClientId )
-{
-    /* Enabled mbed TLS threading layer. */
-    AiaMbedtlsThreading_Init();
-
-    /**
-     * Initialize mbed TLS contexts needed for random number generation.
-     * Required if AiaRandom_Rand() and AiaRandom_Seed() are using the
-     * AiaRandomMbedtls implementation.
-     */
-    AiaRandomMbedtls_Init();
-
-    /**
-     * Initialize Aia MbedTLS Crypto usage.
-     */
-    if( !AiaCryptoMbedtls_Init() )
-    {
-        AiaLogError( "AiaCryptoMbedtls_Init failed" );
-        AiaRandomMbedtls_Cleanup();
-        AiaMbedtlsThreading_Cleanup();
-        return NULL;
-    }
+#if AIA_SAMPLE_APP_STATIC_ALLOCATION
+/** @name Statically reserved storage for the single sample app. */
+/** @{ */
+static AiaSampleApp_t g_aiaSampleAppStorage;
+static bool g_aiaSampleAppStorageInUse;
+/* Sized so that the buffer can be moved up to a DMA-aligned address. */
+static uint8_t g_aiaMicrophoneBufferStorage[ MIC_BUFFER_SIZE_IN_BYTES( AIA_SAMPLE_APP_MAX_MICROPHONE_HISTORY_MS ) +
+                                            AIA_MEMORY_DMA_ALIGNMENT - 1 ];
+static StaticEventGroup_t aia_egStorage;
+/** @} */
+#endif
 
-    if( !AiaRandom_Seed( iotClientId, strlen( iotClientId ) ) )
+/**
+ * Allocates a zero'd @c AiaSampleApp_t and creates its microphone mutex.
+ *
+ * @return The sample app, or @c NULL on failure.
+ */
+static AiaSampleApp_t *allocateSampleApp( void )
+{
+#if AIA_SAMPLE_APP_STATIC_ALLOCATION
+    if( g_aiaSampleAppStorageInUse )
     {
-        AiaCryptoMbedtls_Cleanup();
-        AiaRandomMbedtls_Cleanup();
-        AiaMbedtlsThreading_Cleanup();
-        AiaLogError( "AiaRandom_Seed failed" );
+        AiaLogError( "Only one sample app may exist with static allocation" );
         return NULL;
     }
-
-    /* TODO: ADSER-1690 Simplify cleanup. */
+    memset( &g_aiaSampleAppStorage, 0, sizeof( g_aiaSampleAppStorage ) );
+    AiaSampleApp_t *sampleApp = &g_aiaSampleAppStorage;
+#else
     AiaSampleApp_t *sampleApp = (AiaSampleApp_t *)AiaCalloc( 1, sizeof( AiaSampleApp_t ) );
     if( !sampleApp )
     {
         AiaLogError( "AiaCalloc failed, bytes=%zu.", sizeof( AiaSampleApp_t ) );
-        AiaCryptoMbedtls_Cleanup();
-        AiaRandomMbedtls_Cleanup();
-        AiaMbedtlsThreading_Cleanup();
         return NULL;
     }
+#endif
+    if( !AiaMutex( Create )( &sampleApp->microphoneMutex, false ) )
+    {
+        AiaLogError( "AiaMutex( Create ) failed" );
+#if !AIA_SAMPLE_APP_STATIC_ALLOCATION
+        AiaFree( sampleApp );
+#endif
+        return NULL;
+    }
+#if AIA_SAMPLE_APP_STATIC_ALLOCATION
+    g_aiaSampleAppStorageInUse = true;
+#endif
+    return sampleApp;
+}
 
-    sampleApp->mqttConnection = mqttConnection;
+/**
+ * Releases an @c AiaSampleApp_t obtained from @c allocateSampleApp().
+ *
+ * @param sampleApp The sample app to release.
+ */
+static void releaseSampleApp( AiaSampleApp_t *sampleApp )
+{
+    AiaMutex( Destroy )( &sampleApp->microphoneMutex );
+#if AIA_SAMPLE_APP_STATIC_ALLOCATION
+    AiaAssert( sampleApp == &g_aiaSampleAppStorage );
+    g_aiaSampleAppStorageInUse = false;
+#else
+    AiaFree( sampleApp );
+#endif
+}
 
-    sampleApp->rawMicrophoneBuffer = AiaCalloc( MIC_BUFFER_SIZE_IN_BYTES, 1 );
+/**
+ * Allocates a raw microphone buffer aligned for DMA. The recorder writes into
+ * this buffer before anything reads from it, so it is not zero'd.
+ *
+ * @param bytes The size of the buffer.
+ * @return The buffer, or @c NULL on failure.
+ */
+static void *allocateMicrophoneBuffer( size_t bytes )
+{
+#if AIA_SAMPLE_APP_STATIC_ALLOCATION
+    AiaAssert( bytes + AIA_MEMORY_DMA_ALIGNMENT - 1 <= sizeof( g_aiaMicrophoneBufferStorage ) );
+    return (void *)( ( (uintptr_t)g_aiaMicrophoneBufferStorage + AIA_MEMORY_DMA_ALIGNMENT - 1 ) &
+                     ~(uintptr_t)( AIA_MEMORY_DMA_ALIGNMENT - 1 ) );
+#else
+    void *buffer = AiaMallocAlignedFor( AIA_MEMORY_SUBSYSTEM_MICROPHONE, bytes, 1, AIA_MEMORY_DMA_ALIGNMENT );
+    if( !buffer )
+    {
+        AiaLogError( "AiaMallocAligned failed, bytes=%zu", bytes );
+    }
+    return buffer;
+#endif
+}
+
+/**
+ * Releases a buffer obtained from @c allocateMicrophoneBuffer().
+ *
+ * @param buffer The buffer to release.
+ */
+static void releaseMicrophoneBuffer( void *buffer )
+{
+#if AIA_SAMPLE_APP_STATIC_ALLOCATION
+    (void)buffer;
+#else
+    AiaFreeAligned( buffer );
+#endif
+}
+
+/**
+ * Creates the microphone buffer, its reader and writer, and the recorder that
+ * feeds it.
+ *
+ * @param sampleApp The sample app to create the microphone for.
+ * @param historyMs The amount of audio data the buffer should hold.
+ * @return @c true on success or @c false otherwise, in which case nothing is
+ * left allocated.
+ */
+static bool createMicrophone( AiaSampleApp_t *sampleApp, AiaDurationMs_t historyMs )
+{
+    size_t bytes = MIC_BUFFER_SIZE_IN_BYTES( historyMs );
+    sampleApp->rawMicrophoneBuffer = allocateMicrophoneBuffer( bytes );
     if( !sampleApp->rawMicrophoneBuffer )
     {
-        AiaLogError( "AiaCalloc failed, bytes=%zu", MIC_BUFFER_SIZE_IN_BYTES );
-        AiaFree( sampleApp );
-        AiaCryptoMbedtls_Cleanup();
-        AiaRandomMbedtls_Cleanup();
-        AiaMbedtlsThreading_Cleanup();
-        return NULL;
+        return false;
     }
 
-    sampleApp->microphoneBuffer = AiaDataStreamBuffer_Create( sampleApp->rawMicrophoneBuffer, MIC_BUFFER_SIZE_IN_BYTES,
+    sampleApp->microphoneBuffer = AiaDataStreamBuffer_Create( sampleApp->rawMicrophoneBuffer, bytes,
                                                               AIA_MICROPHONE_BUFFER_WORD_SIZE, MIC_NUM_READERS );
     if( !sampleApp->microphoneBuffer )
     {
         AiaLogError( "AiaDataStreamBuffer_Create failed" );
-        AiaFree( sampleApp->rawMicrophoneBuffer );
-        AiaFree( sampleApp );
-        AiaCryptoMbedtls_Cleanup();
-        AiaRandomMbedtls_Cleanup();
-        AiaMbedtlsThreading_Cleanup();
-        return NULL;
+        releaseMicrophoneBuffer( sampleApp->rawMicrophoneBuffer );
+        return false;
     }
 
     sampleApp->microphoneBufferReader = AiaDataStreamBuffer_CreateReader(
@@ -375,12 +474,8 @@ AiaSampleApp_t *AiaSampleApp_Create( AiaMqttConnectionPointer_t mqttConnection,
     {
         AiaLogError( "AiaDataStreamBuffer_CreateReader failed" );
         AiaDataStreamBuffer_Destroy( sampleApp->microphoneBuffer );
-        AiaFree( sampleApp->rawMicrophoneBuffer );
-        AiaFree( sampleApp );
-        AiaCryptoMbedtls_Cleanup();
-        AiaRandomMbedtls_Cleanup();
-        AiaMbedtlsThreading_Cleanup();
-        return NULL;
+        releaseMicrophoneBuffer( sampleApp->rawMicrophoneBuffer );
+        return false;
     }
 
     sampleApp->microphoneBufferWriter = AiaDataStreamBuffer_CreateWriter(
@@ -390,12 +485,8 @@ AiaSampleApp_t *AiaSampleApp_Create( AiaMqttConnectionPointer_t mqttConnection,
         AiaLogError( "AiaDataStreamBuffer_CreateWriter failed" );
         AiaDataStreamReader_Destroy( sampleApp->microphoneBufferReader );
         AiaDataStreamBuffer_Destroy( sampleApp->microphoneBuffer );
-        AiaFree( sampleApp->rawMicrophoneBuffer );
-        AiaFree( sampleApp );
-        AiaCryptoMbedtls_Cleanup();
-        AiaRandomMbedtls_Cleanup();
-        AiaMbedtlsThreading_Cleanup();
-        return NULL;
+        releaseMicrophoneBuffer( sampleApp->rawMicrophoneBuffer );
+        return false;
     }
 
 #ifdef AIA_DEMO_AUDIO_ENABLE
@@ -406,26 +497,236 @@ AiaSampleApp_t *AiaSampleApp_Create( AiaMqttConnectionPointer_t mqttConnection,
         AiaDataStreamWriter_Destroy( sampleApp->microphoneBufferWriter );
         AiaDataStreamReader_Destroy( sampleApp->microphoneBufferReader );
         AiaDataStreamBuffer_Destroy( sampleApp->microphoneBuffer );
-        AiaFree( sampleApp->rawMicrophoneBuffer );
-        AiaFree( sampleApp );
+        releaseMicrophoneBuffer( sampleApp->rawMicrophoneBuffer );
+        return false;
+    }
+
+    sampleApp->isMicrophoneActive = false;
+#endif
+
+    sampleApp->microphoneHistoryMs = historyMs;
+    return true;
+}
+
+/**
+ * Destroys everything created by @c createMicrophone().
+ *
+ * @param sampleApp The sample app to destroy the microphone of.
+ */
+static void destroyMicrophone( AiaSampleApp_t *sampleApp )
+{
+#ifdef AIA_DEMO_AUDIO_ENABLE
+    AiaPortAudioMicrophoneRecorder_Destroy( sampleApp->portAudioMicrophoneRecorder );
+    sampleApp->portAudioMicrophoneRecorder = NULL;
+#endif
+    AiaDataStreamWriter_Destroy( sampleApp->microphoneBufferWriter );
+    AiaDataStreamReader_Destroy( sampleApp->microphoneBufferReader );
+    AiaDataStreamBuffer_Destroy( sampleApp->microphoneBuffer );
+    releaseMicrophoneBuffer( sampleApp->rawMicrophoneBuffer );
+    sampleApp->microphoneBufferWriter = NULL;
+    sampleApp->microphoneBufferReader = NULL;
+    sampleApp->microphoneBuffer = NULL;
+    sampleApp->rawMicrophoneBuffer = NULL;
+}
+
+/**
+ * Rebuilds the microphone so that it holds the amount of audio data last
+ * requested through @c AiaSampleApp_SetMicrophoneHistory(). The caller must
+ * hold @c microphoneMutex, and no Aia client may exist. The old buffer is
+ * released before the new one is allocated, so that shrinking never needs more
+ * memory than is already in use.
+ *
+ * @param sampleApp The sample app to act on.
+ * @return @c true if the microphone holds the requested amount or the previous
+ * one, or @c false if it could not be recreated at all.
+ */
+static bool resizeMicrophone( AiaSampleApp_t *sampleApp )
+{
+    AiaDurationMs_t previousMs = sampleApp->microphoneHistoryMs;
+    AiaDurationMs_t requestedMs = AiaAtomic_Load_u32( &sampleApp->requestedMicrophoneHistoryMs );
+    AiaAssert( !sampleApp->aiaClient );
+    if( requestedMs == previousMs || !sampleApp->microphoneBuffer )
+    {
+        return true;
+    }
+
+    destroyMicrophone( sampleApp );
+    if( createMicrophone( sampleApp, requestedMs ) )
+    {
+        AiaLogInfo( "Microphone history resized, previousMs=%" PRIu32 ", historyMs=%" PRIu32, previousMs,
+                    requestedMs );
+        return true;
+    }
+
+    AiaLogError( "Failed to resize microphone history, historyMs=%" PRIu32, requestedMs );
+    AiaAtomic_Store_u32( &sampleApp->requestedMicrophoneHistoryMs, previousMs );
+    if( !createMicrophone( sampleApp, previousMs ) )
+    {
+        AiaLogError( "Failed to restore microphone history, historyMs=%" PRIu32, previousMs );
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Makes sure the microphone exists with the requested history, and keeps it
+ * from being released or resized until @c unlockMicrophone() is called. An Aia
+ * client must only hold @c microphoneBufferReader between the two.
+ *
+ * @param sampleApp The sample app to act on.
+ * @return @c true on success or @c false if the microphone could not be
+ * recreated, in which case it is not locked.
+ */
+static bool lockMicrophone( AiaSampleApp_t *sampleApp )
+{
+    AiaMutex( Lock )( &sampleApp->microphoneMutex );
+    bool ready = sampleApp->microphoneBuffer
+                     ? resizeMicrophone( sampleApp )
+                     : createMicrophone( sampleApp, AiaAtomic_Load_u32( &sampleApp->requestedMicrophoneHistoryMs ) );
+    if( !ready )
+    {
+        AiaMutex( Unlock )( &sampleApp->microphoneMutex );
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Undoes @c lockMicrophone().
+ *
+ * @param sampleApp The sample app to act on.
+ */
+static void unlockMicrophone( AiaSampleApp_t *sampleApp )
+{
+    AiaMutex( Unlock )( &sampleApp->microphoneMutex );
+}
+
+#if AIA_SAMPLE_APP_RELEASE_MICROPHONE
+/**
+ * Pressure callback of @c AIA_MEMORY_SUBSYSTEM_MICROPHONE. Releases the
+ * microphone unless it is locked, which it is while an Aia client exists. It
+ * is created again by the next @c lockMicrophone(). While it is locked, the
+ * history is shrunk to @c AIA_SAMPLE_APP_MIN_MICROPHONE_HISTORY_MS instead.
+ */
+static bool onMicrophoneMemoryPressure( AiaMemorySubsystem_t subsystem, size_t bytes, void *userData )
+{
+    AiaSampleApp_t *sampleApp = (AiaSampleApp_t *)userData;
+    (void)subsystem;
+    (void)bytes;
+    if( !AiaMutex( TryLock )( &sampleApp->microphoneMutex ) )
+    {
+        /* Shrink the history at the next point where the microphone is closed. */
+        AiaAtomic_Store_u32( &sampleApp->requestedMicrophoneHistoryMs, AIA_SAMPLE_APP_MIN_MICROPHONE_HISTORY_MS );
+        return false;
+    }
+    bool released = sampleApp->microphoneBuffer != NULL;
+    if( released )
+    {
+        destroyMicrophone( sampleApp );
+        AiaLogInfo( "Released the microphone under memory pressure" );
+    }
+    AiaMutex( Unlock )( &sampleApp->microphoneMutex );
+    return released;
+}
+#endif
+
+#ifdef AIA_ENABLE_SPEAKER
+/**
+ * Allocates the slot that holds the offline alert being played.
+ *
+ * @param sampleApp The sample app playing the alert.
+ * @return The slot, or @c NULL on failure.
+ */
+static AiaAlertSlot_t *allocateOfflineAlert( AiaSampleApp_t *sampleApp )
+{
+#if AIA_SAMPLE_APP_STATIC_ALLOCATION
+    return &sampleApp->offlineAlertStorage;
+#else
+    (void)sampleApp;
+    AiaAlertSlot_t *offlineAlert = AiaMallocFor( AIA_MEMORY_SUBSYSTEM_ALERTS, 1, sizeof( AiaAlertSlot_t ) );
+    if( !offlineAlert )
+    {
+        AiaLogError( "AiaMalloc failed, bytes=%zu.", sizeof( AiaAlertSlot_t ) );
+    }
+    return offlineAlert;
+#endif
+}
+
+/**
+ * Releases @c sampleApp->offlineAlertInProgress, if any.
+ *
+ * @param sampleApp The sample app playing the alert.
+ */
+static void releaseOfflineAlert( AiaSampleApp_t *sampleApp )
+{
+#if !AIA_SAMPLE_APP_STATIC_ALLOCATION
+    AiaFree( sampleApp->offlineAlertInProgress );
+#endif
+    sampleApp->offlineAlertInProgress = NULL;
+}
+#endif
+
+AiaSampleApp_t *AiaSampleApp_Create( AiaMqttConnectionPointer_t mqttConnection, const char *iotClientId )
+{
+    /* Enabled mbed TLS threading layer. */
+    AiaMbedtlsThreading_Init();
+
+    /**
+     * Initialize mbed TLS contexts needed for random number generation.
+     * Required if AiaRandom_Rand() and AiaRandom_Seed() are using the
+     * AiaRandomMbedtls implementation.
+     */
+    AiaRandomMbedtls_Init();
+
+    /**
+     * Initialize Aia MbedTLS Crypto usage.
+     */
+    if( !AiaCryptoMbedtls_Init() )
+    {
+        AiaLogError( "AiaCryptoMbedtls_Init failed" );
+        AiaRandomMbedtls_Cleanup();
+        AiaMbedtlsThreading_Cleanup();
+        return NULL;
+    }
+
+    if( !AiaRandom_Seed( iotClientId, strlen( iotClientId ) ) )
+    {
+        AiaCryptoMbedtls_Cleanup();
+        AiaRandomMbedtls_Cleanup();
+        AiaMbedtlsThreading_Cleanup();
+        AiaLogError( "AiaRandom_Seed failed" );
+        return NULL;
+    }
+
+    /* TODO: ADSER-1690 Simplify cleanup. */
+    AiaSampleApp_t *sampleApp = allocateSampleApp();
+    if( !sampleApp )
+    {
         AiaCryptoMbedtls_Cleanup();
         AiaRandomMbedtls_Cleanup();
         AiaMbedtlsThreading_Cleanup();
         return NULL;
     }
 
-    sampleApp->isMicrophoneActive = false;
+    sampleApp->mqttConnection = mqttConnection;
+
+    AiaAtomic_Store_u32( &sampleApp->requestedMicrophoneHistoryMs, AIA_SAMPLE_APP_MICROPHONE_HISTORY_MS );
+    if( !createMicrophone( sampleApp, AIA_SAMPLE_APP_MICROPHONE_HISTORY_MS ) )
+    {
+        releaseSampleApp( sampleApp );
+        AiaCryptoMbedtls_Cleanup();
+        AiaRandomMbedtls_Cleanup();
+        AiaMbedtlsThreading_Cleanup();
+        return NULL;
+    }
 
+#ifdef AIA_DEMO_AUDIO_ENABLE
     sampleApp->opusDecoder = AiaOpusDecoder_Create();
     if( !sampleApp->opusDecoder )
     {
         AiaLogError( "AiaOpusDecoder_Create failed" );
-        AiaPortAudioMicrophoneRecorder_Destroy( sampleApp->portAudioMicrophoneRecorder );
-        AiaDataStreamWriter_Destroy( sampleApp->microphoneBufferWriter );
-        AiaDataStreamReader_Destroy( sampleApp->microphoneBufferReader );
-        AiaDataStreamBuffer_Destroy( sampleApp->microphoneBuffer );
-        AiaFree( sampleApp->rawMicrophoneBuffer );
-        AiaFree( sampleApp );
+        destroyMicrophone( sampleApp );
+        releaseSampleApp( sampleApp );
         AiaCryptoMbedtls_Cleanup();
         AiaRandomMbedtls_Cleanup();
         AiaMbedtlsThreading_Cleanup();
@@ -437,12 +738,8 @@ AiaSampleApp_t *AiaSampleApp_Create( AiaMqttConnectionPointer_t mqttConnection,
     {
         AiaLogError( "AiaPortAudioSpeakerPlayer_Create failed" );
         AiaOpusDecoder_Destroy( sampleApp->opusDecoder );
-        AiaPortAudioMicrophoneRecorder_Destroy( sampleApp->portAudioMicrophoneRecorder );
-        AiaDataStreamWriter_Destroy( sampleApp->microphoneBufferWriter );
-        AiaDataStreamReader_Destroy( sampleApp->microphoneBufferReader );
-        AiaDataStreamBuffer_Destroy( sampleApp->microphoneBuffer );
-        AiaFree( sampleApp->rawMicrophoneBuffer );
-        AiaFree( sampleApp );
+        destroyMicrophone( sampleApp );
+        releaseSampleApp( sampleApp );
         AiaCryptoMbedtls_Cleanup();
         AiaRandomMbedtls_Cleanup();
         AiaMbedtlsThreading_Cleanup();
@@ -458,13 +755,9 @@ AiaSampleApp_t *AiaSampleApp_Create( AiaMqttConnectionPointer_t mqttConnection,
 #ifdef AIA_DEMO_AUDIO_ENABLE
         AiaPortAudioSpeaker_Destroy( sampleApp->portAudioSpeaker );
         AiaOpusDecoder_Destroy( sampleApp->opusDecoder );
-        AiaPortAudioMicrophoneRecorder_Destroy( sampleApp->portAudioMicrophoneRecorder );
 #endif
-        AiaDataStreamWriter_Destroy( sampleApp->microphoneBufferWriter );
-        AiaDataStreamReader_Destroy( sampleApp->microphoneBufferReader );
-        AiaDataStreamBuffer_Destroy( sampleApp->microphoneBuffer );
-        AiaFree( sampleApp->rawMicrophoneBuffer );
-        AiaFree( sampleApp );
+        destroyMicrophone( sampleApp );
+        releaseSampleApp( sampleApp );
         AiaCryptoMbedtls_Cleanup();
         AiaRandomMbedtls_Cleanup();
         AiaMbedtlsThreading_Cleanup();
@@ -485,7 +778,17 @@ AiaSampleApp_t *AiaSampleApp_Create( AiaMqttConnectionPointer_t mqttConnection,
     g_aiaLwaRefreshToken = AIA_REG_HTTPS_LWA_REFRESH_TOKEN;
     g_aiaLwaClientId = AIA_REG_HTTPS_LWA_CLIENT_ID;
 
+#if AIA_SAMPLE_APP_STATIC_ALLOCATION
+    aia_eg = xEventGroupCreateStatic( &aia_egStorage );
+#else
     aia_eg = xEventGroupCreate();
+#endif
+#ifdef AIA_ENABLE_CLOCK
+    AiaClock_SetSynchronizedCallback( onClockSynchronized, sampleApp );
+#endif
+#if AIA_SAMPLE_APP_RELEASE_MICROPHONE
+    AiaMemory_SetPressureCallback( AIA_MEMORY_SUBSYSTEM_MICROPHONE, onMicrophoneMemoryPressure, sampleApp );
+#endif
     sampleApp->isAiaClientConnected = false;
     sampleApp->toRunDemo = true;
     sampleApp->capState = AIA_CAPABILITIES_STATE_NONE;
@@ -502,6 +805,12 @@ void AiaSampleApp_Destroy( AiaSampleApp_t *sampleApp )
         return;
     }
 
+#ifdef AIA_ENABLE_CLOCK
+    AiaClock_SetSynchronizedCallback( NULL, NULL );
+#endif
+#if AIA_SAMPLE_APP_RELEASE_MICROPHONE
+    AiaMemory_SetPressureCallback( AIA_MEMORY_SUBSYSTEM_MICROPHONE, NULL, NULL );
+#endif
     AiaAtomicBool_Clear( &sampleApp->shouldPublishEvent );
 
 #ifdef AIA_ENABLE_SPEAKER
@@ -509,32 +818,34 @@ void AiaSampleApp_Destroy( AiaSampleApp_t *sampleApp )
     AiaAtomicBool_Clear( &sampleApp->shouldDeleteOfflineAlert );
 
     AiaTimer( Destroy )( &sampleApp->offlineAlertPlaybackTimer );
-    if( sampleApp->offlineAlertInProgress )
-    {
-        AiaFree( sampleApp->offlineAlertInProgress );
-        sampleApp->offlineAlertInProgress = NULL;
-    }
+    releaseOfflineAlert( sampleApp );
 #endif
 
 #ifdef AIA_DEMO_AUDIO_ENABLE
     AiaPortAudioSpeaker_Destroy( sampleApp->portAudioSpeaker );
     AiaOpusDecoder_Destroy( sampleApp->opusDecoder );
-    AiaPortAudioMicrophoneRecorder_Destroy( sampleApp->portAudioMicrophoneRecorder );
 #endif
     if( sampleApp->aiaClient )
     {
         AiaClient_Destroy( sampleApp->aiaClient );
         sampleApp->aiaClient = NULL;
     }
+    if( !AiaStorage_Flush() )
+    {
+        AiaLogWarn( "AiaStorage_Flush failed" );
+    }
 
-    AiaDataStreamWriter_Destroy( sampleApp->microphoneBufferWriter );
-    AiaDataStreamReader_Destroy( sampleApp->microphoneBufferReader );
-    AiaDataStreamBuffer_Destroy( sampleApp->microphoneBuffer );
-    AiaFree( sampleApp->rawMicrophoneBuffer );
+    /* Waits out a resize or pressure callback that may still be running. */
+    AiaMutex( Lock )( &sampleApp->microphoneMutex );
+    if( sampleApp->microphoneBuffer )
+    {
+        destroyMicrophone( sampleApp );
+    }
+    AiaMutex( Unlock )( &sampleApp->microphoneMutex );
     sampleApp->isAiaClientConnected = false;
     sampleApp->toRunDemo = false;
     sampleApp->capState = AIA_CAPABILITIES_STATE_NONE;
-    AiaFree( sampleApp );
+    releaseSampleApp( sampleApp );
 
     AiaCryptoMbedtls_Cleanup();
     AiaRandomMbedtls_Cleanup();
@@ -543,6 +854,54 @@ void AiaSampleApp_Destroy( AiaSampleApp_t *sampleApp )
     vEventGroupDelete( aia_eg );
 }
 
+/**
+ * Applies a pending @c AiaSampleApp_SetMicrophoneHistory() while @c aiaClient
+ * exists. The client holds the microphone reader, so it is disconnected and
+ * destroyed, the microphone is rebuilt, and the client is created again and
+ * reconnected if it was connected. Nothing happens while the microphone is
+ * open. The caller must hold @c microphoneMutex.
+ *
+ * @param sampleApp The sample app to act on.
+ * @return @c true on success or @c false if the client could not be restored.
+ */
+static bool applyMicrophoneHistory( AiaSampleApp_t *sampleApp )
+{
+    if( AiaAtomic_Load_u32( &sampleApp->requestedMicrophoneHistoryMs ) == sampleApp->microphoneHistoryMs )
+    {
+        return true;
+    }
+#ifdef AIA_DEMO_AUDIO_ENABLE
+    if( sampleApp->isMicrophoneOpen )
+    {
+        return true;
+    }
+#endif
+
+    bool wasConnected = sampleApp->isAiaClientConnected;
+    if( wasConnected )
+    {
+        if( !AiaStorage_Flush() )
+        {
+            AiaLogWarn( "AiaStorage_Flush failed" );
+        }
+        AiaClient_Disconnect( sampleApp->aiaClient, AIA_CONNECTION_ON_DISCONNECTED_GOING_OFFLINE, NULL );
+        AIA_DEMO_EG_WAIT( AIA_EVENT_DISCONNECTED, 5000 );
+    }
+    AiaClient_Destroy( sampleApp->aiaClient );
+    sampleApp->aiaClient = NULL;
+
+    if( !resizeMicrophone( sampleApp ) || !initAiaClient( sampleApp ) )
+    {
+        return false;
+    }
+    if( wasConnected )
+    {
+        processDemoCase( AIA_DEMO_CASE_CONNECT, sampleApp );
+        return sampleApp->toRunDemo;
+    }
+    return true;
+}
+
 void AiaSampleApp_Run( AiaSampleApp_t *sampleApp )
 {
     AiaAssert( sampleApp );
@@ -561,7 +920,7 @@ void AiaSampleApp_Run( AiaSampleApp_t *sampleApp )
                                      AIA_DEMO_CASE_SYNC_TIME, AIA_DEMO_CASE_DISCONNECT };
 #endif
 
-    if( !registerAia( sampleApp ) )
+    if( !registerAia( sampleApp ) || !sampleApp->toRunDemo )
     {
         AiaLogError( "Registration Failed" );
         sampleApp->toRunDemo = false;
@@ -569,9 +928,15 @@ void AiaSampleApp_Run( AiaSampleApp_t *sampleApp )
     }
     AiaLogInfo( "Aia Registered." );
 
+    if( !lockMicrophone( sampleApp ) )
+    {
+        sampleApp->toRunDemo = false;
+        return;
+    }
     if( !initAiaClient( sampleApp ) )
     {
         AiaLogError( "Client initialization failed" );
+        unlockMicrophone( sampleApp );
         sampleApp->toRunDemo = false;
         return;
     }
@@ -582,12 +947,24 @@ void AiaSampleApp_Run( AiaSampleApp_t *sampleApp )
         AIA_DEMO_CASES_E command = cmd[ i ];
         AiaLogInfo( "---- Current demo case = %s ----", AIA_DEMO_CASE_TO_STRING[ command ] );
         processDemoCase( command, sampleApp );
+        if( sampleApp->toRunDemo && !applyMicrophoneHistory( sampleApp ) )
+        {
+            AiaLogError( "Failed to restore the client after resizing the microphone" );
+            sampleApp->toRunDemo = false;
+        }
+#if AIA_MEMORY_STACK_PROFILE_ENABLE
+        AiaMemory_SampleStacks();
+#endif
     }
 
     if( sampleApp->aiaClient )
     {
         if( sampleApp->isAiaClientConnected )
         {
+            if( !AiaStorage_Flush() )
+            {
+                AiaLogWarn( "AiaStorage_Flush failed" );
+            }
             AiaClient_Disconnect( sampleApp->aiaClient, AIA_CONNECTION_ON_DISCONNECTED_GOING_OFFLINE, NULL );
             AIA_DEMO_EG_WAIT( AIA_EVENT_DISCONNECTED, 5000 );
             if( 0 == ( AIA_DEMO_EG_GET() & AIA_EVENT_DISCONNECTED ) )
@@ -600,6 +977,35 @@ void AiaSampleApp_Run( AiaSampleApp_t *sampleApp )
         sampleApp->toRunDemo = false;
         AiaLogInfo( "Client deinitialize." );
     }
+    unlockMicrophone( sampleApp );
+
+#if AIA_MEMORY_STACK_PROFILE_ENABLE
+    AiaMemory_LogStackUsage();
+#endif
+}
+
+bool AiaSampleApp_SetMicrophoneHistory( AiaSampleApp_t *sampleApp, AiaDurationMs_t historyMs )
+{
+    AiaAssert( sampleApp );
+    if( !sampleApp )
+    {
+        AiaLogError( "Null sampleApp" );
+        return false;
+    }
+    if( historyMs < AIA_SAMPLE_APP_MIN_MICROPHONE_HISTORY_MS || historyMs > AIA_SAMPLE_APP_MAX_MICROPHONE_HISTORY_MS )
+    {
+        AiaLogError( "Invalid microphone history, historyMs=%" PRIu32, historyMs );
+        return false;
+    }
+
+    AiaAtomic_Store_u32( &sampleApp->requestedMicrophoneHistoryMs, historyMs );
+    /* The mutex is free only while no client holds the microphone. */
+    if( AiaMutex( TryLock )( &sampleApp->microphoneMutex ) )
+    {
+        resizeMicrophone( sampleApp );
+        AiaMutex( Unlock )( &sampleApp->microphoneMutex );
+    }
+    return true;
 }
 
 static bool initAiaClient( AiaSampleApp_t *sampleApp )
@@ -641,9 +1047,20 @@ static bool registerAia( AiaSampleApp_t *sampleApp )
         return false;
     }
 
+    /* Persist the shared secret and topic root together, so that a power loss
+     * cannot leave one without the other. */
+    if( !AiaStorage_BeginTransaction() )
+    {
+        AiaLogError( "AiaStorage_BeginTransaction failed" );
+        AiaRegistrationManager_Destroy( sampleApp->registrationManager );
+        sampleApp->registrationManager = NULL;
+        return false;
+    }
+
     if( !AiaRegistrationManager_Register( sampleApp->registrationManager ) )
     {
         AiaLogError( "AiaRegistrationManager_Register Failed" );
+        AiaStorage_AbortTransaction();
         AiaRegistrationManager_Destroy( sampleApp->registrationManager );
         sampleApp->registrationManager = NULL;
         return false;
@@ -659,6 +1076,13 @@ static void onAiaRegistrationSuccess( void *userData )
         return;
     }
     AiaSampleApp_t *sampleApp = (AiaSampleApp_t *)userData;
+    /* Credentials that did not reach storage are lost on reboot, so the registration did not succeed. */
+    if( !AiaStorage_CommitTransaction() )
+    {
+        AiaLogError( "AiaStorage_CommitTransaction failed, treating registration as failed" );
+        failRegistration( sampleApp );
+        return;
+    }
     AiaLogInfo( "Registration Succeeded" );
     AiaRegistrationManager_Destroy( sampleApp->registrationManager );
     sampleApp->registrationManager = NULL;
@@ -673,8 +1097,16 @@ static void onAiaRegistrationFailed( void *userData, AiaRegistrationFailureCode_
     }
     AiaSampleApp_t *sampleApp = (AiaSampleApp_t *)userData;
     AiaLogInfo( "Registration Failed, code=%d", code );
+    failRegistration( sampleApp );
+}
+
+static void failRegistration( AiaSampleApp_t *sampleApp )
+{
+    /* A commit that failed may leave the transaction open. */
+    AiaStorage_AbortTransaction();
     AiaRegistrationManager_Destroy( sampleApp->registrationManager );
     sampleApp->registrationManager = NULL;
+    sampleApp->toRunDemo = false;
 }
 
 void processDemoCase( AIA_DEMO_CASES_E c, AiaSampleApp_t *sampleApp )
@@ -791,6 +1223,11 @@ void processDemoCase( AIA_DEMO_CASES_E c, AiaSampleApp_t *sampleApp )
                 sampleApp->toRunDemo = false;
                 return;
             }
+            /* The wait clears the bit, so its result is checked instead. */
+            if( 0 == ( AIA_DEMO_EG_WAIT( AIA_EVENT_CLOCK_SYNCHRONIZED, 5000 ) & AIA_EVENT_CLOCK_SYNCHRONIZED ) )
+            {
+                AiaLogWarn( "Clock synchronization timeout." );
+            }
             return;
 #endif
         default:
@@ -921,6 +1358,10 @@ static void onSpeakerVolumeChanged( uint8_t newVolume, void *userData )
         return;
     }
     AiaLogDebug( "Received volume change, volume=%" PRIu8, newVolume );
+    if( !AiaStoreVolume( newVolume ) )
+    {
+        AiaLogWarn( "AiaStoreVolume failed, volume=%" PRIu8, newVolume );
+    }
 #ifdef AIA_DEMO_AUDIO_ENABLE
     if( sampleApp->portAudioSpeaker )
     {
@@ -949,11 +1390,7 @@ static bool onStopOfflineAlertTone( void* userData )
     }
 
     /* Clear offline alert in progress, clear conditional flags */
-    if( sampleApp->offlineAlertInProgress )
-    {
-        AiaFree( sampleApp->offlineAlertInProgress );
-        sampleApp->offlineAlertInProgress = NULL;
-    }
+    releaseOfflineAlert( sampleApp );
     sampleApp->offlineAlertPlaybackStartTime = 0;
     AiaAtomicBool_Clear( &sampleApp->shouldDeleteOfflineAlert );
 
@@ -977,11 +1414,10 @@ static bool onStartOfflineAlertTone( const AiaAlertSlot_t* offlineAlert,
     }
 
     /* Set the offline alert to play, initialize conditional variables */
-    sampleApp->offlineAlertInProgress =
-        AiaCalloc( 1, sizeof( AiaAlertSlot_t ) );
+    releaseOfflineAlert( sampleApp );
+    sampleApp->offlineAlertInProgress = allocateOfflineAlert( sampleApp );
     if( !sampleApp->offlineAlertInProgress )
     {
-        AiaLogError( "AiaCalloc failed, bytes=%zu.", sizeof( AiaAlertSlot_t ) );
         return false;
     }
     *sampleApp->offlineAlertInProgress = *offlineAlert;
@@ -998,11 +1434,7 @@ static bool onStartOfflineAlertTone( const AiaAlertSlot_t* offlineAlert,
                           AIA_SPEAKER_FRAME_PUSH_CADENCE_MS ) )
     {
         AiaLogError( "AiaTimer( Arm ) failed" );
-        if( sampleApp->offlineAlertInProgress )
-        {
-            AiaFree( sampleApp->offlineAlertInProgress );
-            sampleApp->offlineAlertInProgress = NULL;
-        }
+        releaseOfflineAlert( sampleApp );
         sampleApp->offlineAlertPlaybackStartTime = 0;
         AiaTimer( Destroy )( &sampleApp->offlineAlertPlaybackTimer );
         return false;
@@ -1063,11 +1495,7 @@ static void onPlayOfflineAlertTone( void* userData )
             AiaLogError( "AiaTimer( Create ) failed" );
         }
 
-        if( sampleApp->offlineAlertInProgress )
-        {
-            AiaFree( sampleApp->offlineAlertInProgress );
-            sampleApp->offlineAlertInProgress = NULL;
-        }
+        releaseOfflineAlert( sampleApp );
         sampleApp->offlineAlertPlaybackStartTime = 0;
         AiaAtomicBool_Clear( &sampleApp->shouldDeleteOfflineAlert );
 
@@ -1095,11 +1523,7 @@ static void onPlayOfflineAlertTone( void* userData )
         default:
             AiaLogError( "Unknown alert type:%" PRIu32,
                          offlineAlert->alertType );
-            if( sampleApp->offlineAlertInProgress )
-            {
-                AiaFree( sampleApp->offlineAlertInProgress );
-                sampleApp->offlineAlertInProgress = NULL;
-            }
+            releaseOfflineAlert( sampleApp );
             sampleApp->offlineAlertPlaybackStartTime = 0;
             return;
     }
@@ -1121,6 +1545,27 @@ static void onPlayOfflineAlertTone( void* userData )
 }
 #endif
 
+#ifdef AIA_ENABLE_CLOCK
+static void onClockSynchronized( void *userData )
+{
+    AiaSampleApp_t *sampleApp = (AiaSampleApp_t *)userData;
+    AiaAssert( sampleApp );
+    if( !sampleApp )
+    {
+        AiaLogError( "Null sampleApp" );
+        return;
+    }
+    AiaLogInfo( "Clock synchronized" );
+    /* Alerts that expired while the device was off go in one write. This runs
+     * on every synchronization, including the first one after boot. */
+    if( !AiaDeleteExpiredAlerts() )
+    {
+        AiaLogWarn( "AiaDeleteExpiredAlerts failed" );
+    }
+    AIA_DEMO_EG_SET( AIA_EVENT_CLOCK_SYNCHRONIZED );
+}
+#endif
+
 static void onUXStateChangedSimpleUI( AiaUXState_t state, void *userData )
 {
     (void)userData;
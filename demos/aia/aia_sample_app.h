@@ -25,6 +25,71 @@
 /* The config header is always included first. */
 #include <aia_config.h>
 
+/**
+ * @name Static allocation mode.
+ *
+ * When @c AIA_SAMPLE_APP_STATIC_ALLOCATION is non-zero, @c
+ * AiaSampleApp_Create() takes the @c AiaSampleApp_t, the raw microphone buffer,
+ * the offline alert slot and the demo event group from statically reserved
+ * storage rather than the heap, so their RAM cost shows up in the link map.
+ * The offline alert timer and the microphone mutex live in the @c
+ * AiaSampleApp_t, and the FreeRTOS platform layer creates them from their
+ * embedded static control blocks. Only one @c AiaSampleApp_t may exist at a
+ * time in this mode, and FreeRTOS must be built with @c
+ * configSUPPORT_STATIC_ALLOCATION. The microphone buffer is sized at build time
+ * from @c AIA_SAMPLE_APP_MAX_MICROPHONE_HISTORY_MS, and stays reserved however
+ * short the history is.
+ *
+ * This mode does not make startup free of heap calls. The following objects
+ * are allocated by the AIA client SDK and the demo audio utilities, which take
+ * no caller-provided storage, and still come from the heap:
+ * - the microphone @c AiaDataStreamBuffer_t, its reader and its writer
+ * - the PortAudio microphone recorder, with @c AIA_DEMO_AUDIO_ENABLE
+ * - the Opus decoder and the PortAudio speaker, with @c AIA_DEMO_AUDIO_ENABLE
+ * - the Aia client and everything it creates, once the demo runs
+ */
+/** @{ */
+
+#ifndef AIA_SAMPLE_APP_STATIC_ALLOCATION
+#define AIA_SAMPLE_APP_STATIC_ALLOCATION 0
+#endif
+
+/** @} */
+
+/**
+ * @name Microphone history.
+ *
+ * The microphone buffer holds the most recent audio so that an interaction can
+ * start from a point in the past, for example to include a wake word engine's
+ * preroll. It starts out holding @c AIA_SAMPLE_APP_MICROPHONE_HISTORY_MS of
+ * audio, at 32 KB per second, and can be resized between @c
+ * AIA_SAMPLE_APP_MIN_MICROPHONE_HISTORY_MS and @c
+ * AIA_SAMPLE_APP_MAX_MICROPHONE_HISTORY_MS with @c
+ * AiaSampleApp_SetMicrophoneHistory().
+ */
+/** @{ */
+
+#ifndef AIA_SAMPLE_APP_MICROPHONE_HISTORY_MS
+#define AIA_SAMPLE_APP_MICROPHONE_HISTORY_MS 10000
+#endif
+
+#ifndef AIA_SAMPLE_APP_MIN_MICROPHONE_HISTORY_MS
+#define AIA_SAMPLE_APP_MIN_MICROPHONE_HISTORY_MS 500
+#endif
+
+#ifndef AIA_SAMPLE_APP_MAX_MICROPHONE_HISTORY_MS
+#define AIA_SAMPLE_APP_MAX_MICROPHONE_HISTORY_MS 10000
+#endif
+
+#if AIA_SAMPLE_APP_MICROPHONE_HISTORY_MS <  \
+        AIA_SAMPLE_APP_MIN_MICROPHONE_HISTORY_MS || \
+    AIA_SAMPLE_APP_MICROPHONE_HISTORY_MS >       \
+        AIA_SAMPLE_APP_MAX_MICROPHONE_HISTORY_MS
+#error "AIA_SAMPLE_APP_MICROPHONE_HISTORY_MS must be within the min and max"
+#endif
+
+/** @} */
+
 /**
  * A sample application type that creates and runs the application via keyboard
  * inputs. The returned pointer should be destroyed using @c
@@ -60,4 +125,26 @@ void AiaSampleApp_Destroy( AiaSampleApp_t* sampleApp );
  */
 void AiaSampleApp_Run( AiaSampleApp_t* sampleApp );
 
+/**
+ * Changes the amount of audio the microphone buffer holds, for example to keep
+ * a short history while idle and a longer one while a wake word engine needs
+ * preroll. May be called from any task.
+ *
+ * The Aia client keeps a reader into the buffer for as long as it exists, and
+ * the buffer cannot be resized in place, so the buffer, its reader and its
+ * writer are rebuilt at the next point where the microphone is closed. If no
+ * Aia client exists, that happens before this returns. Otherwise @c
+ * AiaSampleApp_Run() does it between two demo cases: it disconnects and
+ * destroys its client, rebuilds the buffer, then creates the client again and
+ * reconnects it if it was connected. If the new buffer cannot be allocated,
+ * the previous length is kept.
+ *
+ * @param sampleApp The @c AiaSampleApp_t to act on.
+ * @param historyMs The amount of audio data to hold.
+ * @return @c true if the request was accepted or @c false if @c historyMs is
+ * out of range.
+ */
+bool AiaSampleApp_SetMicrophoneHistory( AiaSampleApp_t* sampleApp,
+                                        AiaDurationMs_t historyMs );
+
 #endif /* ifndef AIA_SAMPLE_APP_H_ */
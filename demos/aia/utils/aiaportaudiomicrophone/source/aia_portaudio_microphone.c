@@ -38,6 +38,13 @@ static const int NUM_OUTPUT_CHANNELS = 0;
 /** Sample rate to record at. */
 static const double SAMPLE_RATE = 16000;
 
+/**
+ * Most frames read from PortAudio at once (20 ms at @c SAMPLE_RATE). This
+ * bounds the stack used by the capture task, which runs on the timer service
+ * task, regardless of how much data has accumulated.
+ */
+#define MAX_FRAMES_PER_READ 320
+
 /**
  * Called by a @c AiaPortAudioMicrophoneRecorder_t's @c captureMicrophoneTimer
  * to capture and write available microphone data to the underlying buffer.
@@ -107,7 +114,8 @@ AiaPortAudioMicrophoneRecorder_t* AiaPortAudioMicrophoneRecorder_Create(
     }
 
     AiaPortAudioMicrophoneRecorder_t* recorder =
-        AiaCalloc( 1, sizeof( AiaPortAudioMicrophoneRecorder_t ) );
+        AiaCallocFor( AIA_MEMORY_SUBSYSTEM_MICROPHONE, 1,
+                      sizeof( AiaPortAudioMicrophoneRecorder_t ) );
     if( !recorder )
     {
         AiaLogError( "AiaCalloc failed, bytes=%zu",
@@ -204,31 +212,45 @@ void AiaPortAudioMicrophoneRecorder_MicrophoneCaptureTask( void* userData )
     }
 
     /* TODO: ADSER-1692 Double copy here, optimize. */
-    int16_t buf[ numFramesAvailableToRead ];
-    PaError err =
-        Pa_ReadStream( recorder->paStream, buf, numFramesAvailableToRead );
-    AiaMutex( Unlock )( &recorder->mutex );
-    if( err != paNoError )
+    int16_t buf[ MAX_FRAMES_PER_READ ];
+    while( numFramesAvailableToRead > 0 )
     {
-        if( err != paInputOverflowed )
+        signed long numFramesToRead =
+            numFramesAvailableToRead < MAX_FRAMES_PER_READ
+                ? numFramesAvailableToRead
+                : MAX_FRAMES_PER_READ;
+        PaError err =
+            Pa_ReadStream( recorder->paStream, buf, numFramesToRead );
+        AiaMutex( Unlock )( &recorder->mutex );
+        if( err != paNoError )
         {
-            AiaLogError( "Pa_ReadStream failed, errorCode=%s",
-                         Pa_GetErrorText( err ) );
-            return;
+            if( err != paInputOverflowed )
+            {
+                AiaLogError( "Pa_ReadStream failed, errorCode=%s",
+                             Pa_GetErrorText( err ) );
+                return;
+            }
+            else
+            {
+                AiaLogWarn(
+                    "Input overflowed and discarded from previous call" );
+            }
         }
-        else
+
+        ssize_t writeReturnCode = AiaDataStreamWriter_Write(
+            recorder->bufferWriter, buf, numFramesToRead );
+        if( writeReturnCode <= 0 )
         {
-            AiaLogWarn( "Input overflowed and discarded from previous call" );
+            AiaLogError( "Failed to write to stream, error=%s",
+                         AiaDataStreamWriter_ErrorToString( writeReturnCode ) );
+            return;
         }
-    }
 
-    ssize_t writeReturnCode = AiaDataStreamWriter_Write(
-        recorder->bufferWriter, buf, numFramesAvailableToRead );
-    if( writeReturnCode <= 0 )
-    {
-        AiaLogError( "Failed to write to stream, error=%s",
-                     AiaDataStreamWriter_ErrorToString( writeReturnCode ) );
-        return;
+        numFramesAvailableToRead -= numFramesToRead;
+        if( numFramesAvailableToRead > 0 )
+        {
+            AiaMutex( Lock )( &recorder->mutex );
+        }
     }
 }
 
@@ -57,6 +57,26 @@ AiaTimepointSeconds_t AiaClock_GetTimeSinceNTPEpoch();
 void AiaClock_SetTimeSinceNTPEpoch(
     AiaTimepointSeconds_t secondsSinceNTPEpoch );
 
+/**
+ * Called after @c AiaClock_SetTimeSinceNTPEpoch() has synchronized the clock,
+ * on the task that synchronized it.
+ *
+ * @param userData Context registered with the callback.
+ */
+typedef void ( *AiaClockSynchronizedCallback_t )( void* userData );
+
+/**
+ * Registers the callback run each time the clock is synchronized with the
+ * service, replacing any previous one, so that work needing the real time,
+ * like dropping alerts that expired while the device was off, can wait for
+ * it.
+ *
+ * @param callback The callback, or @c NULL to unregister.
+ * @param userData Context passed to @c callback.
+ */
+void AiaClock_SetSynchronizedCallback( AiaClockSynchronizedCallback_t callback,
+                                       void* userData );
+
 /** @} */
 /** @} */
 
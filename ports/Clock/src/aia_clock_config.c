@@ -50,6 +50,10 @@ static AiaTimepointSeconds_t g_lastSynchronization;
  * server or not. */
 static bool g_serverSynchronized = false;
 
+/* Callback run after each synchronization, and its context. */
+static AiaClockSynchronizedCallback_t g_synchronizedCallback;
+static void* g_synchronizedUserData;
+
 /** @} */
 
 /** Simple spin lock boolean flag to guard against asynchronous reads/writes to
@@ -99,5 +103,25 @@ void AiaClock_SetTimeSinceNTPEpoch( AiaTimepointSeconds_t secondsSinceNTPEpoch )
     g_serverSynchronized = true;
     g_lastSynchronization = AiaClock( GetTimeMs )() / AIA_MS_PER_SECOND;
     g_lastRetrievedTimeSinceNTPEpoch = secondsSinceNTPEpoch;
+    AiaClockSynchronizedCallback_t callback = g_synchronizedCallback;
+    void* userData = g_synchronizedUserData;
+    AiaAtomicBool_Clear( &g_spinLock );
+
+    /* Run outside of the lock, since the callback may read the time. */
+    if( callback )
+    {
+        callback( userData );
+    }
+}
+
+void AiaClock_SetSynchronizedCallback( AiaClockSynchronizedCallback_t callback,
+                                       void* userData )
+{
+    while( !Atomic_CompareAndSwap_u32( &g_spinLock, 1, 0 ) )
+    {
+        /* spin lock, inefficient */
+    }
+    g_synchronizedCallback = callback;
+    g_synchronizedUserData = userData;
     AiaAtomicBool_Clear( &g_spinLock );
 }
@@ -50,6 +50,19 @@
 #endif /* ifndef AIA_AFR_HTTPS_TRUSTED_ROOT_CA */
 
 #define AIA_AFR_HTTPS_BUFFER_SIZE ( (int)384 )
+
+/**
+ * Buffers handed to the HTTPS client. Each request allocates its own, which
+ * keeps them off the caller's stack and lets requests overlap.
+ */
+typedef struct AiaHttpsBuffers
+{
+    uint8_t conn[ AIA_AFR_HTTPS_BUFFER_SIZE ];
+    uint8_t req[ AIA_AFR_HTTPS_BUFFER_SIZE ];
+    uint8_t resp[ AIA_AFR_HTTPS_BUFFER_SIZE ];
+    uint8_t respBody[ AIA_AFR_HTTPS_BUFFER_SIZE ];
+} AiaHttpsBuffers_t;
+
 static const IotNetworkInterface_t* _pAiaNetIf;
 static const void* _pAiaNetCredentialInfo;
 static char* _reqHeader = "Content-Type";
@@ -70,11 +83,15 @@ bool AiaHttpStoreNetworkInfo( const IotNetworkInterface_t* pNetworkInterface,
     }
 }
 
-bool AiaSendHttpsRequest( AiaHttpsRequest_t* httpsRequest,
-                          AiaHttpsConnectionResponseCallback_t responseCallback,
-                          void* responseCallbackUserData,
-                          AiaHttpsConnectionFailureCallback_t failureCallback,
-                          void* failureCallbackUserData )
+/**
+ * Performs the work of @c AiaSendHttpsRequest() using @c buffers.
+ */
+static bool AiaSendHttpsRequestUsingBuffers(
+    AiaHttpsBuffers_t* buffers, AiaHttpsRequest_t* httpsRequest,
+    AiaHttpsConnectionResponseCallback_t responseCallback,
+    void* responseCallbackUserData,
+    AiaHttpsConnectionFailureCallback_t failureCallback,
+    void* failureCallbackUserData )
 {
     IotHttpsReturnCode_t httpsClientStatus = IOT_HTTPS_OK;
     IotHttpsConnectionInfo_t connConfig = { 0 };
@@ -93,10 +110,10 @@ bool AiaSendHttpsRequest( AiaHttpsRequest_t* httpsRequest,
     uint16_t respStatus = IOT_HTTPS_STATUS_OK;
     uint32_t retryNum = 0;
     size_t rspBodyLen = 0;
-    uint8_t _pConnUserBuffer[ AIA_AFR_HTTPS_BUFFER_SIZE ] = { 0 };
-    uint8_t _pReqUserBuffer[ AIA_AFR_HTTPS_BUFFER_SIZE ] = { 0 };
-    uint8_t _pRespUserBuffer[ AIA_AFR_HTTPS_BUFFER_SIZE ] = { 0 };
-    uint8_t _pRespBodyBuffer[ AIA_AFR_HTTPS_BUFFER_SIZE ] = { 0 };
+    uint8_t* _pConnUserBuffer = buffers->conn;
+    uint8_t* _pReqUserBuffer = buffers->req;
+    uint8_t* _pRespUserBuffer = buffers->resp;
+    uint8_t* _pRespBodyBuffer = buffers->respBody;
 
     httpsClientStatus = IotHttpsClient_GetUrlPath(
         httpsRequest->url, strlen( httpsRequest->url ), &pPath, &pathLen );
@@ -140,7 +157,7 @@ bool AiaSendHttpsRequest( AiaHttpsRequest_t* httpsRequest,
     connConfig.pCaCert = AIA_AFR_HTTPS_TRUSTED_ROOT_CA;
     connConfig.caCertLen = sizeof( AIA_AFR_HTTPS_TRUSTED_ROOT_CA );
     connConfig.userBuffer.pBuffer = _pConnUserBuffer;
-    connConfig.userBuffer.bufferLen = sizeof( _pConnUserBuffer );
+    connConfig.userBuffer.bufferLen = sizeof( buffers->conn );
     connConfig.pClientCert =
         ( (IotNetworkCredentials_t*)_pAiaNetCredentialInfo )->pClientCert;
     connConfig.clientCertLen =
@@ -154,7 +171,7 @@ bool AiaSendHttpsRequest( AiaHttpsRequest_t* httpsRequest,
     reqSyncInfo.pBody = (uint8_t*)( httpsRequest->body );
     reqSyncInfo.bodyLen = strlen( httpsRequest->body );
     respSyncInfo.pBody = (uint8_t*)_pRespBodyBuffer;
-    respSyncInfo.bodyLen = sizeof( _pRespBodyBuffer );
+    respSyncInfo.bodyLen = sizeof( buffers->respBody );
 
     reqConfig.pPath = pPath;
     reqConfig.pathLen = strlen( pPath );
@@ -163,12 +180,12 @@ bool AiaSendHttpsRequest( AiaHttpsRequest_t* httpsRequest,
     reqConfig.method = IOT_HTTPS_METHOD_POST;
     reqConfig.isNonPersistent = false;
     reqConfig.userBuffer.pBuffer = _pReqUserBuffer;
-    reqConfig.userBuffer.bufferLen = sizeof( _pReqUserBuffer );
+    reqConfig.userBuffer.bufferLen = sizeof( buffers->req );
     reqConfig.isAsync = false;
     reqConfig.u.pSyncInfo = &reqSyncInfo;
 
     respConfig.userBuffer.pBuffer = _pRespUserBuffer;
-    respConfig.userBuffer.bufferLen = sizeof( _pRespUserBuffer );
+    respConfig.userBuffer.bufferLen = sizeof( buffers->resp );
     respConfig.pSyncInfo = &respSyncInfo;
 
     httpsClientStatus =
@@ -261,3 +278,24 @@ bool AiaSendHttpsRequest( AiaHttpsRequest_t* httpsRequest,
 
     return true;
 }
+
+bool AiaSendHttpsRequest( AiaHttpsRequest_t* httpsRequest,
+                          AiaHttpsConnectionResponseCallback_t responseCallback,
+                          void* responseCallbackUserData,
+                          AiaHttpsConnectionFailureCallback_t failureCallback,
+                          void* failureCallbackUserData )
+{
+    AiaHttpsBuffers_t* buffers = AiaCallocFor(
+        AIA_MEMORY_SUBSYSTEM_HTTP, 1, sizeof( AiaHttpsBuffers_t ) );
+    if( !buffers )
+    {
+        AiaLogError( "AiaCalloc failed, bytes=%zu.",
+                     sizeof( AiaHttpsBuffers_t ) );
+        return false;
+    }
+    bool success = AiaSendHttpsRequestUsingBuffers(
+        buffers, httpsRequest, responseCallback, responseCallbackUserData,
+        failureCallback, failureCallbackUserData );
+    AiaFree( buffers );
+    return success;
+}
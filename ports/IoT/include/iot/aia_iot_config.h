@@ -264,6 +264,15 @@ static inline AiaAtomicBool_t AiaAtomicBool_Load( AiaAtomicBool_t* operand )
 #define AiaSemaphore_t AiaSemaphore( t )
 /** @} */
 
+/** Macros for threads. */
+/** @{ */
+#define AiaThread( MEMBER ) AiaThread_##MEMBER
+#define AiaThread_HEADER <platform/iot_threads.h>
+#define AiaThread_CreateDetached Iot_CreateDetachedThread
+#define AiaThread_DEFAULT_PRIORITY IOT_THREAD_DEFAULT_PRIORITY
+#define AiaThread_DEFAULT_STACK_SIZE IOT_THREAD_DEFAULT_STACK_SIZE
+/** @} */
+
 /**
  * Macros for doubly-linked lists.
  *
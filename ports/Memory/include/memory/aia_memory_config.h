@@ -20,8 +20,501 @@ extern "C" {
 #endif
 #define AIA_MEMORY_CONFIG_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 
+/**
+ * @name Size-class block pools used by @c AiaCalloc() and @c AiaFree().
+ *
+ * Small allocations are served from statically reserved pools of fixed-size
+ * blocks, which keeps short-lived per-frame and per-interaction allocations
+ * from fragmenting the FreeRTOS heap and avoids the scheduler suspension done
+ * by @c pvPortMalloc() on the audio timer paths. An allocation is served by
+ * the smallest class that fits it, found in a table indexed by its size, so it
+ * is O(1). A release finds the class of a block by comparing its address with
+ * each class's storage, which is bounded by the number of classes. Requests
+ * larger than the biggest class, or made while their class is exhausted, fall
+ * back to @c pvPortMalloc().
+ *
+ * The pools take @c AIA_MEMORY_POOL_FOOTPRINT bytes of static RAM, 21 KiB
+ * with the default classes, and the table one byte per @c
+ * AIA_MEMORY_POOL_ALIGNMENT bytes of the biggest block. Define @c
+ * AIA_MEMORY_POOL_ENABLE as @c 0 to reserve nothing and route every
+ * allocation to the FreeRTOS heap. Platforms may override @c
+ * AIA_MEMORY_POOL_CLASSES to tune the classes to their workload. Classes must
+ * be listed in ascending block size order and block sizes must be multiples
+ * of @c AIA_MEMORY_POOL_ALIGNMENT.
+ */
+/** @{ */
+
+#ifndef AIA_MEMORY_POOL_ENABLE
+#define AIA_MEMORY_POOL_ENABLE 1
+#endif
+
+/** Alignment (in bytes) guaranteed for every block handed out by the pools. */
+#define AIA_MEMORY_POOL_ALIGNMENT 8
+
+#ifndef AIA_MEMORY_POOL_CLASSES
+/**
+ * X-macro listing the pool classes as @c CLASS( blockSize, blockCount ).
+ * The defaults cover alert slots and scratch records (up to 128 bytes), small
+ * protocol buffers (up to 512 bytes) and decoded 20 ms PCM speaker frames (up
+ * to 2048 bytes).
+ */
+#define AIA_MEMORY_POOL_CLASSES( CLASS ) \
+    CLASS( 32, 32 )                      \
+    CLASS( 64, 32 )                      \
+    CLASS( 128, 16 )                     \
+    CLASS( 256, 8 )                      \
+    CLASS( 512, 4 )                      \
+    CLASS( 1024, 4 )                     \
+    CLASS( 2048, 4 )
+#endif
+
+/** Adds the bytes of one class to @c AIA_MEMORY_POOL_FOOTPRINT. */
+#define AIA_MEMORY_POOL_CLASS_BYTES( SIZE, COUNT ) +( SIZE ) * ( COUNT )
+
+/** Bytes of static RAM reserved for the blocks of the pools. */
+#define AIA_MEMORY_POOL_FOOTPRINT \
+    ( 0 AIA_MEMORY_POOL_CLASSES( AIA_MEMORY_POOL_CLASS_BYTES ) )
+
+/** @} */
+
+/**
+ * @name Allocation accounting.
+ *
+ * When @c AIA_MEMORY_STATS_ENABLE is non-zero, every @c AiaCalloc(), @c
+ * AiaMalloc() and @c AiaMallocAligned() call site (file and line) is tracked
+ * with its live bytes, peak live bytes, allocation and failure counts and a
+ * power-of-two size histogram. Each allocation then
+ * carries an @c AIA_MEMORY_STATS_HEADER_SIZE byte header recording its size
+ * and call site, so that @c AiaFree() can attribute the release. Bookkeeping is
+ * a bounded hash lookup and a few counter updates per call, so this mode is
+ * cheap enough for release builds. Call sites beyond @c
+ * AIA_MEMORY_STATS_MAX_SITES are accounted together in a final overflow entry
+ * whose @c file is @c NULL.
+ */
+/** @{ */
+
+#ifndef AIA_MEMORY_STATS_ENABLE
+#if ( defined( AIA_MEMORY_TRACE_ENABLE ) && AIA_MEMORY_TRACE_ENABLE ) || \
+    ( defined( AIA_MEMORY_BUDGET_ENABLE ) && AIA_MEMORY_BUDGET_ENABLE )
+#define AIA_MEMORY_STATS_ENABLE 1
+#else
+#define AIA_MEMORY_STATS_ENABLE 0
+#endif
+#endif
+
+#ifndef AIA_MEMORY_STATS_MAX_SITES
+#define AIA_MEMORY_STATS_MAX_SITES 64
+#endif
+
+/**
+ * Number of histogram buckets. Bucket @c i counts allocations of at most
+ * @c 16 << i bytes, and the last bucket counts every larger allocation.
+ */
+#define AIA_MEMORY_STATS_HISTOGRAM_BUCKETS 12
+
+/** Per-allocation overhead (in bytes) when accounting is enabled. */
+#define AIA_MEMORY_STATS_HEADER_SIZE AIA_MEMORY_POOL_ALIGNMENT
+
+/** Accounting of a single allocation call site. */
+typedef struct AiaMemorySiteStats
+{
+    /** Source file of the call site, or @c NULL for the overflow entry. */
+    const char* file;
+
+    /** Source line of the call site. */
+    uint32_t line;
+
+    /** Bytes currently allocated from this site. */
+    size_t liveBytes;
+
+    /** Highest value @c liveBytes has reached. */
+    size_t peakBytes;
+
+    /** Number of successful allocations made from this site. */
+    uint32_t allocationCount;
+
+    /** Number of allocations from this site that could not be served. */
+    uint32_t failedAllocationCount;
+
+    /** Size histogram of the successful allocations from this site. */
+    uint32_t histogram[ AIA_MEMORY_STATS_HISTOGRAM_BUCKETS ];
+} AiaMemorySiteStats_t;
+
+/** A snapshot of the allocation accounting. */
+typedef struct AiaMemoryStats
+{
+    /** Bytes currently allocated through this port. */
+    size_t liveBytes;
+
+    /** Highest value @c liveBytes has reached. */
+    size_t peakBytes;
+
+    /** Number of successful allocations. */
+    uint32_t allocationCount;
+
+    /** Number of allocations that could not be served. */
+    uint32_t failedAllocationCount;
+
+    /** Number of valid entries in @c sites. */
+    size_t numSites;
+
+    /** The tracked call sites. */
+    AiaMemorySiteStats_t sites[ AIA_MEMORY_STATS_MAX_SITES ];
+} AiaMemoryStats_t;
+
+#if AIA_MEMORY_STATS_ENABLE
+
+/**
+ * Takes a snapshot of the allocation accounting. Each site is copied
+ * atomically, though counters of different sites may be a few allocations
+ * apart.
+ *
+ * @param[out] stats Snapshot to fill in.
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaMemory_GetStats( AiaMemoryStats_t* stats );
+
+/** Logs the allocation accounting, one line per call site. */
+void AiaMemory_LogStats();
+
+#endif
+
+/** @} */
+
+/**
+ * @name Allocation trace.
+ *
+ * When @c AIA_MEMORY_TRACE_ENABLE is non-zero, every allocation, release and
+ * failed allocation is appended to a ring buffer of the last @c
+ * AIA_MEMORY_TRACE_CAPACITY events, each stored as a 16-byte @c
+ * AiaMemoryTraceRecord_t. Call sites are recorded as indexes into the
+ * accounting table, so tracing implies @c AIA_MEMORY_STATS_ENABLE.
+ *
+ * @c AiaMemory_DumpTrace() logs the call sites and records in the text format
+ * read by tools/memory_trace_replay, which replays a session against models
+ * of heap_4, heap_5 and the block pools to size heaps and pools from measured
+ * data.
+ */
+/** @{ */
+
+#ifndef AIA_MEMORY_TRACE_ENABLE
+#define AIA_MEMORY_TRACE_ENABLE 0
+#endif
+
+#ifndef AIA_MEMORY_TRACE_CAPACITY
+#define AIA_MEMORY_TRACE_CAPACITY 1024
+#endif
+
+#if AIA_MEMORY_TRACE_ENABLE && !AIA_MEMORY_STATS_ENABLE
+#error "AIA_MEMORY_TRACE_ENABLE requires AIA_MEMORY_STATS_ENABLE"
+#endif
+
+/** Kinds of trace events. */
+typedef enum AiaMemoryTraceOp
+{
+    /** A successful allocation. */
+    AIA_MEMORY_TRACE_ALLOCATE = 'A',
+
+    /** A release. */
+    AIA_MEMORY_TRACE_FREE = 'F',
+
+    /** An allocation that could not be served. */
+    AIA_MEMORY_TRACE_FAIL = 'X'
+} AiaMemoryTraceOp_t;
+
+/** A single trace event. */
+typedef struct AiaMemoryTraceRecord
+{
+    /** FreeRTOS tick count when the event happened. */
+    uint32_t tick;
+
+    /** Low 32 bits of the address handed out or released. */
+    uint32_t address;
+
+    /** Size requested by the caller. */
+    uint32_t size;
+
+    /** Index of the call site in the accounting table. */
+    uint16_t site;
+
+    /** An @c AiaMemoryTraceOp_t. */
+    uint8_t op;
+
+    /** Reserved, always zero. */
+    uint8_t reserved;
+} AiaMemoryTraceRecord_t;
+
+#if AIA_MEMORY_TRACE_ENABLE
+
+/**
+ * Copies the oldest unread trace records out of the ring buffer.
+ *
+ * @param[out] records Where to copy the records.
+ * @param maxRecords Capacity of @c records.
+ * @param[out] dropped If not @c NULL, set to the number of records that were
+ * overwritten before they could be read.
+ * @return The number of records copied.
+ */
+size_t AiaMemory_ReadTrace( AiaMemoryTraceRecord_t* records, size_t maxRecords,
+                            uint32_t* dropped );
+
+/**
+ * Logs the call site table followed by every unread trace record, one line
+ * each, prefixed with @c AIATRACE.
+ */
+void AiaMemory_DumpTrace();
+
+#endif
+
+/** @} */
+
+/**
+ * @name Per-subsystem budgets.
+ *
+ * When @c AIA_MEMORY_BUDGET_ENABLE is non-zero, the live bytes of each
+ * subsystem are held to its budget. Subsystems listed earlier are shed first
+ * under memory pressure.
+ *
+ * Every allocation is charged to the subsystem named at its call site. @c
+ * AiaCallocFor(), @c AiaMallocFor() and @c AiaMallocAlignedFor() take it
+ * explicitly, and @c AiaCalloc(), @c AiaMalloc() and @c AiaMallocAligned() use
+ * @c AIA_MEMORY_SUBSYSTEM. That defaults to @c AIA_MEMORY_SUBSYSTEM_OTHER, and
+ * the build defines it for the sources of the SDK's speaker, alert and
+ * microphone managers and of the audio utilities, which cannot be tagged.
+ * Libraries that do not allocate through this port, such as mbedTLS, are not
+ * accounted, so crypto has no budget.
+ *
+ * An allocation that would take a subsystem over budget first gives that
+ * subsystem's pressure callback a chance to release memory, such as an idle
+ * microphone buffer. An allocation the heap cannot serve gives every
+ * subsystem's callback that chance, in order. If the allocation still cannot
+ * be made it returns @c NULL, so that the caller degrades rather than the
+ * device resetting. Budgets are checked before the allocation is made, so they
+ * are never exceeded.
+ *
+ * Attribution uses call sites, so budgets imply @c AIA_MEMORY_STATS_ENABLE.
+ */
+/** @{ */
+
+#ifndef AIA_MEMORY_BUDGET_ENABLE
+#define AIA_MEMORY_BUDGET_ENABLE 0
+#endif
+
+#if AIA_MEMORY_BUDGET_ENABLE && !AIA_MEMORY_STATS_ENABLE
+#error "AIA_MEMORY_BUDGET_ENABLE requires AIA_MEMORY_STATS_ENABLE"
+#endif
+
+/** Budgets (in bytes) of each subsystem, where @c 0 means unlimited. */
+#ifndef AIA_MEMORY_BUDGET_MICROPHONE
+#define AIA_MEMORY_BUDGET_MICROPHONE 0
+#endif
+#ifndef AIA_MEMORY_BUDGET_HTTP
+#define AIA_MEMORY_BUDGET_HTTP 0
+#endif
+#ifndef AIA_MEMORY_BUDGET_ALERTS
+#define AIA_MEMORY_BUDGET_ALERTS 0
+#endif
+#ifndef AIA_MEMORY_BUDGET_SPEAKER
+#define AIA_MEMORY_BUDGET_SPEAKER 0
+#endif
+
+#ifndef AIA_MEMORY_SUBSYSTEMS
+/**
+ * X-macro listing the subsystems as @c SUBSYSTEM( NAME, budget ), lowest
+ * priority first. Allocations not tagged with one of them belong to @c
+ * AIA_MEMORY_SUBSYSTEM_OTHER, which has no budget.
+ */
+#define AIA_MEMORY_SUBSYSTEMS( SUBSYSTEM )                \
+    SUBSYSTEM( MICROPHONE, AIA_MEMORY_BUDGET_MICROPHONE ) \
+    SUBSYSTEM( HTTP, AIA_MEMORY_BUDGET_HTTP )             \
+    SUBSYSTEM( ALERTS, AIA_MEMORY_BUDGET_ALERTS )         \
+    SUBSYSTEM( SPEAKER, AIA_MEMORY_BUDGET_SPEAKER )
+#endif
+
+#define AIA_MEMORY_SUBSYSTEM_ENUMERATOR( NAME, BUDGET ) \
+    AIA_MEMORY_SUBSYSTEM_##NAME,
+
+/** The subsystems memory is attributed to. */
+typedef enum AiaMemorySubsystem
+{
+    AIA_MEMORY_SUBSYSTEMS( AIA_MEMORY_SUBSYSTEM_ENUMERATOR )
+
+    /** Everything not tagged with one of @c AIA_MEMORY_SUBSYSTEMS. */
+    AIA_MEMORY_SUBSYSTEM_OTHER,
+
+    /** The number of subsystems. */
+    AIA_MEMORY_NUM_SUBSYSTEMS
+} AiaMemorySubsystem_t;
+
+#undef AIA_MEMORY_SUBSYSTEM_ENUMERATOR
+
+#ifndef AIA_MEMORY_SUBSYSTEM
+/** Subsystem charged for allocations that do not name one. */
+#define AIA_MEMORY_SUBSYSTEM AIA_MEMORY_SUBSYSTEM_OTHER
+#endif
+
+/** Usage of a single subsystem. */
+typedef struct AiaMemorySubsystemStats
+{
+    /** Bytes currently allocated by the subsystem. */
+    size_t liveBytes;
+
+    /** Highest value @c liveBytes has reached. */
+    size_t peakBytes;
+
+    /** The current budget, or @c 0 if unlimited. */
+    size_t budget;
+
+    /** Number of allocations refused because of the budget. */
+    uint32_t deniedCount;
+} AiaMemorySubsystemStats_t;
+
+/**
+ * Called when memory is needed on behalf of a subsystem. The callback should
+ * release what it can afford to, for example by shrinking buffers or dropping
+ * low-priority work, and must not block. It may free memory but should not
+ * allocate.
+ *
+ * @param subsystem The subsystem the callback was registered for.
+ * @param bytes Size of the allocation that is waiting.
+ * @param userData Context registered with the callback.
+ * @return @c true if memory was released and the allocation should be retried.
+ */
+typedef bool ( *AiaMemoryPressureCallback_t )( AiaMemorySubsystem_t subsystem,
+                                               size_t bytes, void* userData );
+
+#if AIA_MEMORY_BUDGET_ENABLE
+
+/**
+ * Registers the pressure callback of a subsystem, replacing any previous one.
+ *
+ * @param subsystem The subsystem.
+ * @param callback The callback, or @c NULL to unregister.
+ * @param userData Context passed to @c callback.
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaMemory_SetPressureCallback( AiaMemorySubsystem_t subsystem,
+                                    AiaMemoryPressureCallback_t callback,
+                                    void* userData );
+
+/**
+ * Changes the budget of a subsystem at runtime. Lowering a budget below the
+ * current usage does not release anything, but refuses further allocations
+ * until the usage drops.
+ *
+ * @param subsystem The subsystem.
+ * @param budget The new budget in bytes, or @c 0 for unlimited.
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaMemory_SetBudget( AiaMemorySubsystem_t subsystem, size_t budget );
+
+/**
+ * @param subsystem The subsystem.
+ * @param[out] stats Usage of the subsystem.
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaMemory_GetSubsystemStats( AiaMemorySubsystem_t subsystem,
+                                  AiaMemorySubsystemStats_t* stats );
+
+#endif
+
+/** @} */
+
+/**
+ * @name Stack profiling.
+ *
+ * When @c AIA_MEMORY_STACK_PROFILE_ENABLE is non-zero, @c
+ * AiaMemory_SampleStacks() records the lowest stack headroom (FreeRTOS high
+ * water mark) of every task, including the task pool workers and the timer
+ * service task that runs timer callbacks. Tasks sharing a name, such as task
+ * pool workers, are merged since they share a stack size. Sampling during an
+ * interaction catches tasks that are deleted before the end, and @c
+ * AiaMemory_LogStackUsage() then reports each task and flags those with less
+ * than @c AIA_MEMORY_STACK_HEADROOM_WARN_BYTES of headroom left. This
+ * requires FreeRTOS to be built with @c configUSE_TRACE_FACILITY.
+ *
+ * Variable-length arrays and other stack use that depends on input make these
+ * numbers meaningless, so code running on AIA tasks must keep stack buffers
+ * bounded.
+ */
+/** @{ */
+
+#ifndef AIA_MEMORY_STACK_PROFILE_ENABLE
+#define AIA_MEMORY_STACK_PROFILE_ENABLE 0
+#endif
+
+#ifndef AIA_MEMORY_STACK_PROFILE_MAX_TASKS
+#define AIA_MEMORY_STACK_PROFILE_MAX_TASKS 24
+#endif
+
+#ifndef AIA_MEMORY_STACK_HEADROOM_WARN_BYTES
+#define AIA_MEMORY_STACK_HEADROOM_WARN_BYTES 256
+#endif
+
+#if AIA_MEMORY_STACK_PROFILE_ENABLE
+
+/**
+ * Samples the stack high water mark of every task. This suspends the
+ * scheduler while the task list is walked, so it should be called from
+ * points where that is acceptable, for example between interactions.
+ */
+void AiaMemory_SampleStacks();
+
+/**
+ * Takes a final sample and logs the lowest headroom seen for each task. This
+ * must not be called from more than one task at a time.
+ *
+ * @return @c false if any task was below @c
+ * AIA_MEMORY_STACK_HEADROOM_WARN_BYTES, or @c true otherwise.
+ */
+bool AiaMemory_LogStackUsage();
+
+#endif
+
+/** @} */
+
+/**
+ * @name Alignments for @c AiaMallocAligned().
+ *
+ * Platforms should override these to match their data cache and DMA engines.
+ */
+/** @{ */
+
+#ifndef AIA_MEMORY_CACHE_LINE_SIZE
+#define AIA_MEMORY_CACHE_LINE_SIZE 32
+#endif
+
+#ifndef AIA_MEMORY_DMA_ALIGNMENT
+#define AIA_MEMORY_DMA_ALIGNMENT AIA_MEMORY_CACHE_LINE_SIZE
+#endif
+
+/** @} */
+
+/**
+ * Computes @c count * @c size, detecting overflow.
+ *
+ * @param count The number of elements.
+ * @param size The size (in bytes) of each element.
+ * @param[out] bytes The product, set only on success.
+ * @return @c true on success or @c false if the product does not fit in a @c
+ * size_t.
+ */
+static inline bool AiaMemory_MultiplySize( size_t count, size_t size,
+                                           size_t* bytes )
+{
+    if( size && count > SIZE_MAX / size )
+    {
+        return false;
+    }
+    *bytes = count * size;
+    return true;
+}
+
 /**
  * Allocates zero'd memory.  Memory allocated using this function should be
  * released using a call to @c AiaFree().
@@ -29,24 +522,99 @@ extern "C" {
  * @param count The number of elements to allocate.
  * @param size The size (in bytes) of each element.
  * @return A @c void pointer to the allocated memory, or @c NULL if the memory
+ * cannot be allocated or if @c count * @c size overflows.
+ */
+void* AiaCalloc( size_t count, size_t size );
+
+/**
+ * Allocates uninitialized memory, for buffers that are always written before
+ * they are read. Memory allocated using this function should be released
+ * using a call to @c AiaFree().
+ *
+ * @param count The number of elements to allocate.
+ * @param size The size (in bytes) of each element.
+ * @return A @c void pointer to the allocated memory, or @c NULL if the memory
+ * cannot be allocated or if @c count * @c size overflows.
+ */
+void* AiaMalloc( size_t count, size_t size );
+
+/**
+ * Allocates uninitialized memory whose address is a multiple of @c alignment,
+ * for example @c AIA_MEMORY_CACHE_LINE_SIZE or @c AIA_MEMORY_DMA_ALIGNMENT.
+ * Memory allocated using this function must be released using a call to @c
+ * AiaFreeAligned().
+ *
+ * @param count The number of elements to allocate.
+ * @param size The size (in bytes) of each element.
+ * @param alignment The required alignment, a power of two.
+ * @return A @c void pointer to the allocated memory, or @c NULL if the memory
+ * cannot be allocated, if @c alignment is invalid or if @c count * @c size
+ * overflows.
+ */
+void* AiaMallocAligned( size_t count, size_t size, size_t alignment );
+
+/**
+ * @name Allocation functions charging a given @c AiaMemorySubsystem_t.
+ *
+ * These behave like @c AiaCalloc(), @c AiaMalloc() and @c AiaMallocAligned(),
+ * which charge @c AIA_MEMORY_SUBSYSTEM. The subsystem only matters when @c
+ * AIA_MEMORY_BUDGET_ENABLE is non-zero.
+ */
+/** @{ */
+
+#if AIA_MEMORY_STATS_ENABLE
+
+/**
+ * Allocates memory on behalf of the given call site. This is what the
+ * allocation functions expand to when accounting is enabled; it should not be
+ * called directly.
+ *
+ * @param count The number of elements to allocate.
+ * @param size The size (in bytes) of each element.
+ * @param alignment Required alignment, or @c 0 for the default alignment.
+ * @param zero Whether to zero the memory.
+ * @param subsystem The subsystem to charge the memory to.
+ * @param file Source file of the call site.
+ * @param line Source line of the call site.
+ * @return A @c void pointer to the allocated memory, or @c NULL if the memory
  * cannot be allocated.
  */
-static inline void* AiaCalloc( size_t count, size_t size )
-{
-    void* ptr = pvPortMalloc( count * size );
+void* AiaMemory_AllocAt( size_t count, size_t size, size_t alignment,
+                         bool zero, AiaMemorySubsystem_t subsystem,
+                         const char* file, uint32_t line );
 
-    if (ptr)
-    {
-        memset(ptr, 0, count * size);
-    }
-    return ptr;
-}
+#define AiaCallocFor( subsystem, count, size )                      \
+    AiaMemory_AllocAt( ( count ), ( size ), 0, true, ( subsystem ), \
+                       __FILE__, __LINE__ )
+#define AiaMallocFor( subsystem, count, size )                       \
+    AiaMemory_AllocAt( ( count ), ( size ), 0, false, ( subsystem ), \
+                       __FILE__, __LINE__ )
+#define AiaMallocAlignedFor( subsystem, count, size, alignment ) \
+    AiaMemory_AllocAt( ( count ), ( size ), ( alignment ), false, \
+                       ( subsystem ), __FILE__, __LINE__ )
+#define AiaCalloc( count, size ) \
+    AiaCallocFor( AIA_MEMORY_SUBSYSTEM, count, size )
+#define AiaMalloc( count, size ) \
+    AiaMallocFor( AIA_MEMORY_SUBSYSTEM, count, size )
+#define AiaMallocAligned( count, size, alignment ) \
+    AiaMallocAlignedFor( AIA_MEMORY_SUBSYSTEM, count, size, alignment )
 
-/** Releases memory allocated by a call to @c AiaCalloc(). */
-static inline void AiaFree( void* ptr )
-{
-    vPortFree( ptr );
-}
+#else
+
+#define AiaCallocFor( subsystem, count, size ) AiaCalloc( count, size )
+#define AiaMallocFor( subsystem, count, size ) AiaMalloc( count, size )
+#define AiaMallocAlignedFor( subsystem, count, size, alignment ) \
+    AiaMallocAligned( count, size, alignment )
+
+#endif
+
+/** @} */
+
+/** Releases memory allocated by a call to @c AiaCalloc() or @c AiaMalloc(). */
+void AiaFree( void* ptr );
+
+/** Releases memory allocated by a call to @c AiaMallocAligned(). */
+void AiaFreeAligned( void* ptr );
 
 #ifdef __cplusplus
 }
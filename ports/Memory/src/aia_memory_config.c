@@ -0,0 +1,1211 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file aia_memory_config.c
+ * @brief Implements platform-specific Memory functions which are not inlined
+ * in
+ * @c aia_memory_config.h.
+ */
+
+#include <memory/aia_memory_config.h>
+
+#include <aia_config.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <string.h>
+
+#if AIA_MEMORY_POOL_ENABLE
+
+/** A free block stores the link to the next free block of its class. */
+typedef struct AiaMemoryPoolBlock
+{
+    struct AiaMemoryPoolBlock* next;
+} AiaMemoryPoolBlock_t;
+
+/** Bookkeeping for a single size class. */
+typedef struct AiaMemoryPoolClass
+{
+    /** First byte of the class's reserved storage. */
+    uint8_t* const storage;
+
+    /** Size of each block in bytes. */
+    const size_t blockSize;
+
+    /** Number of blocks reserved for this class. */
+    const size_t blockCount;
+
+    /** Head of the singly-linked list of free blocks. */
+    AiaMemoryPoolBlock_t* freeList;
+} AiaMemoryPoolClass_t;
+
+/**
+ * Reserves the storage for a class. The union forces the alignment promised by
+ * @c AIA_MEMORY_POOL_ALIGNMENT, and the array typedef fails to compile if the
+ * block size would break that alignment for the blocks that follow.
+ */
+#define AIA_MEMORY_POOL_DEFINE_STORAGE( SIZE, COUNT )                       \
+    typedef char AiaMemoryPoolBlockSizeCheck_##SIZE                         \
+        [ ( SIZE ) % AIA_MEMORY_POOL_ALIGNMENT == 0 ? 1 : -1 ];             \
+    static union                                                            \
+    {                                                                       \
+        uint8_t bytes[ ( SIZE ) * ( COUNT ) ];                              \
+        uint64_t alignment;                                                 \
+        void* pointerAlignment;                                             \
+    } g_aiaMemoryPoolStorage_##SIZE;
+
+AIA_MEMORY_POOL_CLASSES( AIA_MEMORY_POOL_DEFINE_STORAGE )
+
+#define AIA_MEMORY_POOL_CLASS_ENTRY( SIZE, COUNT ) \
+    { g_aiaMemoryPoolStorage_##SIZE.bytes, ( SIZE ), ( COUNT ), NULL },
+
+/** A member as large as a block, so a union of them has the biggest's size. */
+#define AIA_MEMORY_POOL_BLOCK_MEMBER( SIZE, COUNT ) uint8_t block##SIZE[ SIZE ];
+
+/** Size of the biggest block. */
+#define AIA_MEMORY_POOL_LARGEST_BLOCK_SIZE \
+    sizeof( union { AIA_MEMORY_POOL_CLASSES( AIA_MEMORY_POOL_BLOCK_MEMBER ) } )
+
+/** Number of entries in @c g_aiaMemoryPoolClassOfSize. */
+#define AIA_MEMORY_POOL_NUM_SIZES \
+    ( AIA_MEMORY_POOL_LARGEST_BLOCK_SIZE / AIA_MEMORY_POOL_ALIGNMENT )
+
+/** @name Variables synchronized by FreeRTOS critical sections. */
+/** @{ */
+
+/** The pool classes, in ascending block size order. */
+static AiaMemoryPoolClass_t g_aiaMemoryPoolClasses[] = {
+    AIA_MEMORY_POOL_CLASSES( AIA_MEMORY_POOL_CLASS_ENTRY )
+};
+
+/**
+ * Index in @c g_aiaMemoryPoolClasses of the smallest class that fits a
+ * request, for requests of @c ( i * AIA_MEMORY_POOL_ALIGNMENT, ( i + 1 ) *
+ * AIA_MEMORY_POOL_ALIGNMENT ] bytes.
+ */
+static uint8_t g_aiaMemoryPoolClassOfSize[ AIA_MEMORY_POOL_NUM_SIZES ];
+
+/** Whether the free lists have been threaded through the storage yet. */
+static bool g_aiaMemoryPoolInitialized = false;
+
+/** @} */
+
+/** Number of entries in @c g_aiaMemoryPoolClasses. */
+#define AIA_MEMORY_POOL_NUM_CLASSES                \
+    ( sizeof( g_aiaMemoryPoolClasses ) /           \
+      sizeof( g_aiaMemoryPoolClasses[ 0 ] ) )
+
+/* Class indices are stored in a byte. */
+typedef char AiaMemoryPoolNumClassesCheck
+    [ AIA_MEMORY_POOL_NUM_CLASSES <= UINT8_MAX + 1 ? 1 : -1 ];
+
+/**
+ * Threads the free list of every class through its storage and fills @c
+ * g_aiaMemoryPoolClassOfSize. Must be called from within a critical section.
+ */
+static void AiaMemory_PoolInitialize()
+{
+    size_t sizeIndex = 0;
+    for( size_t i = 0; i < AIA_MEMORY_POOL_NUM_CLASSES; ++i )
+    {
+        AiaMemoryPoolClass_t* poolClass = &g_aiaMemoryPoolClasses[ i ];
+        AiaAssert( i == 0 || g_aiaMemoryPoolClasses[ i - 1 ].blockSize <
+                                 poolClass->blockSize );
+        poolClass->freeList = NULL;
+        for( size_t block = poolClass->blockCount; block > 0; --block )
+        {
+            AiaMemoryPoolBlock_t* freeBlock =
+                (AiaMemoryPoolBlock_t*)( poolClass->storage +
+                                         ( block - 1 ) * poolClass->blockSize );
+            freeBlock->next = poolClass->freeList;
+            poolClass->freeList = freeBlock;
+        }
+        for( ; sizeIndex < poolClass->blockSize / AIA_MEMORY_POOL_ALIGNMENT;
+             ++sizeIndex )
+        {
+            g_aiaMemoryPoolClassOfSize[ sizeIndex ] = (uint8_t)i;
+        }
+    }
+    g_aiaMemoryPoolInitialized = true;
+}
+
+/**
+ * Takes a block from the smallest class that fits @c size.
+ *
+ * @param size Number of bytes requested, at least one.
+ * @return A block of at least @c size bytes, or @c NULL if @c size is larger
+ * than every class or its class has no free block.
+ */
+static void* AiaMemory_PoolAllocate( size_t size )
+{
+    AiaMemoryPoolBlock_t* block;
+
+    if( size > AIA_MEMORY_POOL_LARGEST_BLOCK_SIZE )
+    {
+        return NULL;
+    }
+
+    taskENTER_CRITICAL();
+    if( !g_aiaMemoryPoolInitialized )
+    {
+        AiaMemory_PoolInitialize();
+    }
+    size_t sizeIndex = ( size - 1 ) / AIA_MEMORY_POOL_ALIGNMENT;
+    AiaMemoryPoolClass_t* poolClass =
+        &g_aiaMemoryPoolClasses[ g_aiaMemoryPoolClassOfSize[ sizeIndex ] ];
+    block = poolClass->freeList;
+    if( block )
+    {
+        poolClass->freeList = block->next;
+    }
+    taskEXIT_CRITICAL();
+
+    return block;
+}
+
+/**
+ * Returns @c ptr to its class if it was handed out by the pools.
+ *
+ * @param ptr The memory to release.
+ * @return @c true if @c ptr belonged to a pool class, or @c false if it was
+ * allocated from the heap.
+ */
+static bool AiaMemory_PoolRelease( void* ptr )
+{
+    uintptr_t address = (uintptr_t)ptr;
+
+    for( size_t i = 0; i < AIA_MEMORY_POOL_NUM_CLASSES; ++i )
+    {
+        AiaMemoryPoolClass_t* poolClass = &g_aiaMemoryPoolClasses[ i ];
+        uintptr_t begin = (uintptr_t)poolClass->storage;
+        uintptr_t end = begin + poolClass->blockSize * poolClass->blockCount;
+        if( address >= begin && address < end )
+        {
+            AiaAssert( ( address - begin ) % poolClass->blockSize == 0 );
+            AiaMemoryPoolBlock_t* block = (AiaMemoryPoolBlock_t*)ptr;
+            taskENTER_CRITICAL();
+            block->next = poolClass->freeList;
+            poolClass->freeList = block;
+            taskEXIT_CRITICAL();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#endif /* AIA_MEMORY_POOL_ENABLE */
+
+/**
+ * Takes @c bytes from the pools, falling back to the FreeRTOS heap.
+ *
+ * @param bytes Number of bytes requested.
+ * @return The uninitialized memory, or @c NULL on failure.
+ */
+static void* AiaMemory_Allocate( size_t bytes )
+{
+    void* ptr = NULL;
+
+#if AIA_MEMORY_POOL_ENABLE
+    if( bytes )
+    {
+        ptr = AiaMemory_PoolAllocate( bytes );
+    }
+#endif
+    if( !ptr )
+    {
+        ptr = pvPortMalloc( bytes );
+    }
+    return ptr;
+}
+
+/**
+ * Returns memory obtained from @c AiaMemory_Allocate() to where it came from.
+ *
+ * @param ptr The memory to release.
+ */
+static void AiaMemory_Release( void* ptr )
+{
+#if AIA_MEMORY_POOL_ENABLE
+    if( AiaMemory_PoolRelease( ptr ) )
+    {
+        return;
+    }
+#endif
+    vPortFree( ptr );
+}
+
+#if AIA_MEMORY_STATS_ENABLE
+
+typedef char AiaMemoryStatsSitesCheck[ AIA_MEMORY_STATS_MAX_SITES >= 2 &&
+                                               AIA_MEMORY_STATS_MAX_SITES <=
+                                                   UINT16_MAX
+                                           ? 1
+                                           : -1 ];
+
+/** Value stamped into every header to catch mismatched or corrupted frees. */
+#define AIA_MEMORY_HEADER_MAGIC 0xA5
+
+/** Header prepended to every allocation while accounting is enabled. */
+typedef struct AiaMemoryHeader
+{
+    /** Size requested by the caller. */
+    uint32_t size;
+
+    /** Index of the call site in @c g_aiaMemorySites. */
+    uint16_t site;
+
+    /** The @c AiaMemorySubsystem_t charged for the allocation. */
+    uint8_t subsystem;
+
+    /** Always @c AIA_MEMORY_HEADER_MAGIC. */
+    uint8_t magic;
+} AiaMemoryHeader_t;
+
+typedef char AiaMemoryHeaderSizeCheck[ sizeof( AiaMemoryHeader_t ) <=
+                                               AIA_MEMORY_STATS_HEADER_SIZE
+                                           ? 1
+                                           : -1 ];
+
+/** Index of the entry shared by every call site that did not fit. */
+#define AIA_MEMORY_STATS_OVERFLOW_SITE ( AIA_MEMORY_STATS_MAX_SITES - 1 )
+
+/** Call site reported for direct calls to the allocation functions. */
+static const char AIA_MEMORY_UNTRACKED_SITE[] = "<untracked>";
+
+/** @name Variables synchronized by FreeRTOS critical sections. */
+/** @{ */
+
+/**
+ * Open-addressed table of call sites, keyed by file and line. The last entry
+ * is reserved for @c AIA_MEMORY_STATS_OVERFLOW_SITE.
+ */
+static AiaMemorySiteStats_t g_aiaMemorySites[ AIA_MEMORY_STATS_MAX_SITES ];
+
+/** Totals across all call sites. */
+static size_t g_aiaMemoryLiveBytes;
+static size_t g_aiaMemoryPeakBytes;
+static uint32_t g_aiaMemoryAllocationCount;
+static uint32_t g_aiaMemoryFailedAllocationCount;
+
+/** @} */
+
+#if AIA_MEMORY_TRACE_ENABLE
+
+typedef char AiaMemoryTraceRecordSizeCheck[
+    sizeof( AiaMemoryTraceRecord_t ) == 16 ? 1 : -1 ];
+
+/** @name Variables synchronized by FreeRTOS critical sections. */
+/** @{ */
+
+/** Ring buffer of the most recent trace records. */
+static AiaMemoryTraceRecord_t g_aiaMemoryTrace[ AIA_MEMORY_TRACE_CAPACITY ];
+
+/** Total number of records ever appended. */
+static uint32_t g_aiaMemoryTraceWritten;
+
+/** Total number of records ever read or overwritten. */
+static uint32_t g_aiaMemoryTraceRead;
+
+/** Number of records overwritten before they could be read. */
+static uint32_t g_aiaMemoryTraceDropped;
+
+/** @} */
+
+/**
+ * Appends a record to the trace, overwriting the oldest one if the ring buffer
+ * is full. Must be called from within a critical section.
+ *
+ * @param op The kind of event.
+ * @param ptr The address handed out or released, if any.
+ * @param size Size requested by the caller.
+ * @param site Index of the call site.
+ */
+static void AiaMemoryTrace_Append( AiaMemoryTraceOp_t op, const void* ptr,
+                                   size_t size, uint16_t site )
+{
+    if( g_aiaMemoryTraceWritten - g_aiaMemoryTraceRead ==
+        AIA_MEMORY_TRACE_CAPACITY )
+    {
+        ++g_aiaMemoryTraceRead;
+        ++g_aiaMemoryTraceDropped;
+    }
+
+    AiaMemoryTraceRecord_t* record =
+        &g_aiaMemoryTrace[ g_aiaMemoryTraceWritten % AIA_MEMORY_TRACE_CAPACITY ];
+    record->tick = (uint32_t)xTaskGetTickCount();
+    record->address = (uint32_t)(uintptr_t)ptr;
+    record->size = size > UINT32_MAX ? UINT32_MAX : (uint32_t)size;
+    record->site = site;
+    record->op = (uint8_t)op;
+    record->reserved = 0;
+    ++g_aiaMemoryTraceWritten;
+}
+
+#define AIA_MEMORY_TRACE( op, ptr, size, site ) \
+    AiaMemoryTrace_Append( op, ptr, size, site )
+
+#else
+
+#define AIA_MEMORY_TRACE( op, ptr, size, site )
+
+#endif /* AIA_MEMORY_TRACE_ENABLE */
+
+typedef char AiaMemorySubsystemCountCheck[
+    AIA_MEMORY_NUM_SUBSYSTEMS <= UINT8_MAX ? 1 : -1 ];
+
+#if AIA_MEMORY_BUDGET_ENABLE
+
+#define AIA_MEMORY_SUBSYSTEM_NAME( NAME, BUDGET ) #NAME,
+#define AIA_MEMORY_SUBSYSTEM_INITIALIZER( NAME, BUDGET ) { 0, 0, BUDGET, 0 },
+
+/** Names of the subsystems, for logging. */
+static const char* const AIA_MEMORY_SUBSYSTEM_NAMES[] = {
+    AIA_MEMORY_SUBSYSTEMS( AIA_MEMORY_SUBSYSTEM_NAME ) "OTHER"
+};
+
+/** @name Variables synchronized by FreeRTOS critical sections. */
+/** @{ */
+
+/** Usage and budget of each subsystem. */
+static AiaMemorySubsystemStats_t
+    g_aiaMemorySubsystems[ AIA_MEMORY_NUM_SUBSYSTEMS ] = {
+        AIA_MEMORY_SUBSYSTEMS( AIA_MEMORY_SUBSYSTEM_INITIALIZER ){ 0, 0, 0, 0 }
+    };
+
+/** Pressure callbacks of each subsystem, and their contexts. */
+static AiaMemoryPressureCallback_t
+    g_aiaMemoryPressureCallbacks[ AIA_MEMORY_NUM_SUBSYSTEMS ];
+static void* g_aiaMemoryPressureUserData[ AIA_MEMORY_NUM_SUBSYSTEMS ];
+
+/** Whether a pressure callback is running, to keep them from nesting. */
+static bool g_aiaMemoryRelieving;
+
+/** @} */
+
+#undef AIA_MEMORY_SUBSYSTEM_NAME
+#undef AIA_MEMORY_SUBSYSTEM_INITIALIZER
+
+/**
+ * Charges @c bytes to a subsystem if its budget allows it.
+ *
+ * @param subsystem The subsystem.
+ * @param bytes Number of bytes to charge.
+ * @return @c true if the bytes were charged or @c false if that would exceed
+ * the budget.
+ */
+static bool AiaMemoryBudget_Reserve( AiaMemorySubsystem_t subsystem,
+                                     size_t bytes )
+{
+    bool reserved = false;
+    taskENTER_CRITICAL();
+    AiaMemorySubsystemStats_t* stats = &g_aiaMemorySubsystems[ subsystem ];
+    if( !stats->budget ||
+        ( bytes <= stats->budget && stats->liveBytes <= stats->budget - bytes ) )
+    {
+        stats->liveBytes += bytes;
+        if( stats->liveBytes > stats->peakBytes )
+        {
+            stats->peakBytes = stats->liveBytes;
+        }
+        reserved = true;
+    }
+    taskEXIT_CRITICAL();
+    return reserved;
+}
+
+/**
+ * Returns bytes charged by @c AiaMemoryBudget_Reserve().
+ *
+ * @param subsystem The subsystem.
+ * @param bytes Number of bytes to return.
+ */
+static void AiaMemoryBudget_Unreserve( AiaMemorySubsystem_t subsystem,
+                                       size_t bytes )
+{
+    taskENTER_CRITICAL();
+    g_aiaMemorySubsystems[ subsystem ].liveBytes -= bytes;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * Runs the pressure callback of a subsystem, unless another one is already
+ * running.
+ *
+ * @param subsystem The subsystem to ask for memory.
+ * @param bytes Size of the allocation that is waiting.
+ * @return @c true if the callback released memory.
+ */
+static bool AiaMemoryBudget_Relieve( AiaMemorySubsystem_t subsystem,
+                                     size_t bytes )
+{
+    taskENTER_CRITICAL();
+    AiaMemoryPressureCallback_t callback =
+        g_aiaMemoryPressureCallbacks[ subsystem ];
+    void* userData = g_aiaMemoryPressureUserData[ subsystem ];
+    bool run = callback && !g_aiaMemoryRelieving;
+    if( run )
+    {
+        g_aiaMemoryRelieving = true;
+    }
+    taskEXIT_CRITICAL();
+
+    if( !run )
+    {
+        return false;
+    }
+
+    AiaLogInfo( "Memory pressure, subsystem=%s, bytes=%zu",
+                AIA_MEMORY_SUBSYSTEM_NAMES[ subsystem ], bytes );
+    bool relieved = callback( subsystem, bytes, userData );
+
+    taskENTER_CRITICAL();
+    g_aiaMemoryRelieving = false;
+    taskEXIT_CRITICAL();
+
+    return relieved;
+}
+
+/**
+ * Charges @c bytes to a subsystem, asking it to shed memory if it is at its
+ * budget.
+ *
+ * @param subsystem The subsystem.
+ * @param bytes Number of bytes to charge.
+ * @return @c true if the bytes were charged or @c false if the allocation
+ * must be refused.
+ */
+static bool AiaMemoryBudget_Admit( AiaMemorySubsystem_t subsystem,
+                                   size_t bytes )
+{
+    if( AiaMemoryBudget_Reserve( subsystem, bytes ) ||
+        ( AiaMemoryBudget_Relieve( subsystem, bytes ) &&
+          AiaMemoryBudget_Reserve( subsystem, bytes ) ) )
+    {
+        return true;
+    }
+
+    taskENTER_CRITICAL();
+    ++g_aiaMemorySubsystems[ subsystem ].deniedCount;
+    size_t liveBytes = g_aiaMemorySubsystems[ subsystem ].liveBytes;
+    size_t budget = g_aiaMemorySubsystems[ subsystem ].budget;
+    taskEXIT_CRITICAL();
+
+    AiaLogWarn( "Memory budget exceeded, subsystem=%s, bytes=%zu, live=%zu, "
+                "budget=%zu",
+                AIA_MEMORY_SUBSYSTEM_NAMES[ subsystem ], bytes, liveBytes,
+                budget );
+    return false;
+}
+
+/**
+ * Allocates from the heap, asking subsystems to shed memory in priority order
+ * while it is exhausted.
+ *
+ * @param bytes Number of bytes to allocate.
+ * @return The memory, or @c NULL on failure.
+ */
+static void* AiaMemoryBudget_Allocate( size_t bytes )
+{
+    void* ptr = AiaMemory_Allocate( bytes );
+    for( size_t i = 0; !ptr && i < AIA_MEMORY_NUM_SUBSYSTEMS; ++i )
+    {
+        if( AiaMemoryBudget_Relieve( (AiaMemorySubsystem_t)i, bytes ) )
+        {
+            ptr = AiaMemory_Allocate( bytes );
+        }
+    }
+    return ptr;
+}
+
+#endif /* AIA_MEMORY_BUDGET_ENABLE */
+
+/**
+ * Finds or claims the entry for a call site. Must be called from within a
+ * critical section.
+ *
+ * @param file Source file of the call site.
+ * @param line Source line of the call site.
+ * @return Index of the entry in @c g_aiaMemorySites.
+ */
+static uint16_t AiaMemoryStats_FindSite( const char* file, uint32_t line )
+{
+    static const size_t NUM_SLOTS = AIA_MEMORY_STATS_MAX_SITES - 1;
+    size_t slot =
+        ( ( (uintptr_t)file >> 2 ) ^ ( line * UINT32_C( 2654435761 ) ) ) %
+        NUM_SLOTS;
+
+    for( size_t probe = 0; probe < NUM_SLOTS; ++probe )
+    {
+        AiaMemorySiteStats_t* site = &g_aiaMemorySites[ slot ];
+        if( !site->file )
+        {
+            site->file = file;
+            site->line = line;
+            return (uint16_t)slot;
+        }
+        /* __FILE__ literals are usually merged, so the pointer comparison
+         * almost always settles it. */
+        if( site->line == line &&
+            ( site->file == file || !strcmp( site->file, file ) ) )
+        {
+            return (uint16_t)slot;
+        }
+        slot = ( slot + 1 ) % NUM_SLOTS;
+    }
+    return AIA_MEMORY_STATS_OVERFLOW_SITE;
+}
+
+/**
+ * @param bytes An allocation size.
+ * @return The histogram bucket @c bytes falls in.
+ */
+static size_t AiaMemoryStats_Bucket( size_t bytes )
+{
+    size_t bucket = 0;
+    size_t limit = 16;
+    while( bytes > limit && bucket < AIA_MEMORY_STATS_HISTOGRAM_BUCKETS - 1 )
+    {
+        limit <<= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+/**
+ * Allocates @c bytes behind an @c AiaMemoryHeader_t and accounts for them
+ * against the call site.
+ *
+ * @param bytes Number of bytes requested.
+ * @param subsystem The subsystem to charge the bytes to.
+ * @param file Source file of the call site, or @c NULL if unknown.
+ * @param line Source line of the call site.
+ * @return The uninitialized memory, or @c NULL on failure.
+ */
+static void* AiaMemory_AllocateTracked( size_t bytes,
+                                        AiaMemorySubsystem_t subsystem,
+                                        const char* file, uint32_t line )
+{
+    if( !file )
+    {
+        file = AIA_MEMORY_UNTRACKED_SITE;
+    }
+    if( (size_t)subsystem >= AIA_MEMORY_NUM_SUBSYSTEMS )
+    {
+        AiaLogWarn( "Invalid subsystem, subsystem=%d, site=%s:%" PRIu32,
+                    (int)subsystem, file, line );
+        subsystem = AIA_MEMORY_SUBSYSTEM_OTHER;
+    }
+
+    taskENTER_CRITICAL();
+    uint16_t siteIndex = AiaMemoryStats_FindSite( file, line );
+    taskEXIT_CRITICAL();
+
+    AiaMemoryHeader_t* header = NULL;
+    if( bytes <= UINT32_MAX - AIA_MEMORY_STATS_HEADER_SIZE )
+    {
+#if AIA_MEMORY_BUDGET_ENABLE
+        if( AiaMemoryBudget_Admit( subsystem, bytes ) )
+        {
+            header = (AiaMemoryHeader_t*)AiaMemoryBudget_Allocate(
+                bytes + AIA_MEMORY_STATS_HEADER_SIZE );
+            if( !header )
+            {
+                AiaMemoryBudget_Unreserve( subsystem, bytes );
+            }
+        }
+#else
+        header = (AiaMemoryHeader_t*)AiaMemory_Allocate(
+            bytes + AIA_MEMORY_STATS_HEADER_SIZE );
+#endif
+    }
+
+    taskENTER_CRITICAL();
+    AiaMemorySiteStats_t* site = &g_aiaMemorySites[ siteIndex ];
+    if( header )
+    {
+        site->liveBytes += bytes;
+        if( site->liveBytes > site->peakBytes )
+        {
+            site->peakBytes = site->liveBytes;
+        }
+        ++site->allocationCount;
+        ++site->histogram[ AiaMemoryStats_Bucket( bytes ) ];
+
+        g_aiaMemoryLiveBytes += bytes;
+        if( g_aiaMemoryLiveBytes > g_aiaMemoryPeakBytes )
+        {
+            g_aiaMemoryPeakBytes = g_aiaMemoryLiveBytes;
+        }
+        ++g_aiaMemoryAllocationCount;
+        AIA_MEMORY_TRACE( AIA_MEMORY_TRACE_ALLOCATE,
+                          (uint8_t*)header + AIA_MEMORY_STATS_HEADER_SIZE,
+                          bytes, siteIndex );
+    }
+    else
+    {
+        ++site->failedAllocationCount;
+        ++g_aiaMemoryFailedAllocationCount;
+        AIA_MEMORY_TRACE( AIA_MEMORY_TRACE_FAIL, NULL, bytes, siteIndex );
+    }
+    taskEXIT_CRITICAL();
+
+    if( !header )
+    {
+        AiaLogError( "Allocation failed, bytes=%zu, site=%s:%" PRIu32, bytes,
+                     file, line );
+        return NULL;
+    }
+
+    header->size = (uint32_t)bytes;
+    header->site = siteIndex;
+    header->subsystem = (uint8_t)subsystem;
+    header->magic = AIA_MEMORY_HEADER_MAGIC;
+
+    return (uint8_t*)header + AIA_MEMORY_STATS_HEADER_SIZE;
+}
+
+/**
+ * Releases memory obtained from @c AiaMemory_AllocateTracked().
+ *
+ * @param ptr The memory to release.
+ */
+static void AiaMemory_ReleaseTracked( void* ptr )
+{
+    AiaMemoryHeader_t* header =
+        (AiaMemoryHeader_t*)( (uint8_t*)ptr - AIA_MEMORY_STATS_HEADER_SIZE );
+    AiaAssert( header->magic == AIA_MEMORY_HEADER_MAGIC );
+    header->magic = 0;
+
+    taskENTER_CRITICAL();
+    g_aiaMemorySites[ header->site ].liveBytes -= header->size;
+    g_aiaMemoryLiveBytes -= header->size;
+#if AIA_MEMORY_BUDGET_ENABLE
+    g_aiaMemorySubsystems[ header->subsystem ].liveBytes -= header->size;
+#endif
+    AIA_MEMORY_TRACE( AIA_MEMORY_TRACE_FREE, ptr, header->size, header->site );
+    taskEXIT_CRITICAL();
+
+    AiaMemory_Release( header );
+}
+
+#else
+
+static void* AiaMemory_AllocateTracked( size_t bytes,
+                                        AiaMemorySubsystem_t subsystem,
+                                        const char* file, uint32_t line )
+{
+    (void)subsystem;
+    (void)file;
+    (void)line;
+
+    void* ptr = AiaMemory_Allocate( bytes );
+    if( !ptr )
+    {
+        AiaLogError( "Allocation failed, bytes=%zu", bytes );
+    }
+    return ptr;
+}
+
+static void AiaMemory_ReleaseTracked( void* ptr )
+{
+    AiaMemory_Release( ptr );
+}
+
+#endif /* AIA_MEMORY_STATS_ENABLE */
+
+/**
+ * Common implementation of every allocation mode.
+ *
+ * @param count The number of elements to allocate.
+ * @param size The size (in bytes) of each element.
+ * @param alignment Required alignment of the returned pointer, or @c 0 for the
+ * default alignment. Non-zero values must be powers of two, and the memory
+ * must then be released with @c AiaFreeAligned().
+ * @param zero Whether to zero the memory.
+ * @param subsystem The subsystem to charge the memory to.
+ * @param file Source file of the call site, or @c NULL if unknown.
+ * @param line Source line of the call site.
+ * @return The memory, or @c NULL on failure.
+ */
+static void* AiaMemory_AllocateInternal( size_t count, size_t size,
+                                         size_t alignment, bool zero,
+                                         AiaMemorySubsystem_t subsystem,
+                                         const char* file, uint32_t line )
+{
+    size_t bytes = 0;
+    if( !AiaMemory_MultiplySize( count, size, &bytes ) )
+    {
+        AiaLogError( "Allocation size overflow, count=%zu, size=%zu", count,
+                     size );
+        return NULL;
+    }
+
+    uint8_t* ptr = NULL;
+    if( alignment )
+    {
+        if( alignment & ( alignment - 1 ) )
+        {
+            AiaLogError( "Invalid alignment, alignment=%zu", alignment );
+            return NULL;
+        }
+
+        /* Room to slide up to the next aligned address while keeping the
+         * original pointer just below it for AiaFreeAligned(). */
+        size_t padding = alignment - 1 + sizeof( void* );
+        if( bytes > SIZE_MAX - padding )
+        {
+            AiaLogError( "Allocation size overflow, bytes=%zu, alignment=%zu",
+                         bytes, alignment );
+            return NULL;
+        }
+        uint8_t* base = AiaMemory_AllocateTracked( bytes + padding, subsystem,
+                                                   file, line );
+        if( !base )
+        {
+            return NULL;
+        }
+        ptr = (uint8_t*)( ( (uintptr_t)base + sizeof( void* ) + alignment - 1 ) &
+                          ~(uintptr_t)( alignment - 1 ) );
+        memcpy( ptr - sizeof( void* ), &base, sizeof( void* ) );
+    }
+    else
+    {
+        ptr = AiaMemory_AllocateTracked( bytes, subsystem, file, line );
+        if( !ptr )
+        {
+            return NULL;
+        }
+    }
+
+    if( zero )
+    {
+        memset( ptr, 0, bytes );
+    }
+    return ptr;
+}
+
+#if AIA_MEMORY_STATS_ENABLE
+
+void* AiaMemory_AllocAt( size_t count, size_t size, size_t alignment,
+                         bool zero, AiaMemorySubsystem_t subsystem,
+                         const char* file, uint32_t line )
+{
+    return AiaMemory_AllocateInternal( count, size, alignment, zero,
+                                       subsystem, file, line );
+}
+
+bool AiaMemory_GetStats( AiaMemoryStats_t* stats )
+{
+    if( !stats )
+    {
+        AiaLogError( "Null stats" );
+        return false;
+    }
+
+    stats->numSites = 0;
+    for( size_t i = 0; i < AIA_MEMORY_STATS_MAX_SITES; ++i )
+    {
+        AiaMemorySiteStats_t* out = &stats->sites[ stats->numSites ];
+        taskENTER_CRITICAL();
+        *out = g_aiaMemorySites[ i ];
+        taskEXIT_CRITICAL();
+        if( out->allocationCount || out->failedAllocationCount )
+        {
+            ++stats->numSites;
+        }
+    }
+
+    taskENTER_CRITICAL();
+    stats->liveBytes = g_aiaMemoryLiveBytes;
+    stats->peakBytes = g_aiaMemoryPeakBytes;
+    stats->allocationCount = g_aiaMemoryAllocationCount;
+    stats->failedAllocationCount = g_aiaMemoryFailedAllocationCount;
+    taskEXIT_CRITICAL();
+
+    return true;
+}
+
+void AiaMemory_LogStats()
+{
+    AiaMemorySiteStats_t site;
+
+    taskENTER_CRITICAL();
+    size_t liveBytes = g_aiaMemoryLiveBytes;
+    size_t peakBytes = g_aiaMemoryPeakBytes;
+    uint32_t allocationCount = g_aiaMemoryAllocationCount;
+    uint32_t failedAllocationCount = g_aiaMemoryFailedAllocationCount;
+    taskEXIT_CRITICAL();
+
+    AiaLogInfo( "Memory: live=%zu, peak=%zu, allocations=%" PRIu32
+                ", failed=%" PRIu32,
+                liveBytes, peakBytes, allocationCount, failedAllocationCount );
+
+#if AIA_MEMORY_BUDGET_ENABLE
+    for( size_t i = 0; i < AIA_MEMORY_NUM_SUBSYSTEMS; ++i )
+    {
+        AiaMemorySubsystemStats_t subsystem;
+        taskENTER_CRITICAL();
+        subsystem = g_aiaMemorySubsystems[ i ];
+        taskEXIT_CRITICAL();
+        AiaLogInfo( "%s: live=%zu, peak=%zu, budget=%zu, denied=%" PRIu32,
+                    AIA_MEMORY_SUBSYSTEM_NAMES[ i ], subsystem.liveBytes,
+                    subsystem.peakBytes, subsystem.budget,
+                    subsystem.deniedCount );
+    }
+#endif
+
+    for( size_t i = 0; i < AIA_MEMORY_STATS_MAX_SITES; ++i )
+    {
+        taskENTER_CRITICAL();
+        site = g_aiaMemorySites[ i ];
+        taskEXIT_CRITICAL();
+        if( !site.allocationCount && !site.failedAllocationCount )
+        {
+            continue;
+        }
+        AiaLogInfo(
+            "%s:%" PRIu32 " live=%zu, peak=%zu, allocations=%" PRIu32
+            ", failed=%" PRIu32 ", histogram=%" PRIu32 "/%" PRIu32 "/%" PRIu32
+            "/%" PRIu32 "/%" PRIu32 "/%" PRIu32 "/%" PRIu32 "/%" PRIu32
+            "/%" PRIu32 "/%" PRIu32 "/%" PRIu32 "/%" PRIu32,
+            site.file ? site.file : "<overflow>", site.line, site.liveBytes,
+            site.peakBytes, site.allocationCount, site.failedAllocationCount,
+            site.histogram[ 0 ], site.histogram[ 1 ], site.histogram[ 2 ],
+            site.histogram[ 3 ], site.histogram[ 4 ], site.histogram[ 5 ],
+            site.histogram[ 6 ], site.histogram[ 7 ], site.histogram[ 8 ],
+            site.histogram[ 9 ], site.histogram[ 10 ], site.histogram[ 11 ] );
+    }
+}
+
+#if AIA_MEMORY_BUDGET_ENABLE
+
+bool AiaMemory_SetPressureCallback( AiaMemorySubsystem_t subsystem,
+                                    AiaMemoryPressureCallback_t callback,
+                                    void* userData )
+{
+    if( (size_t)subsystem >= AIA_MEMORY_NUM_SUBSYSTEMS )
+    {
+        AiaLogError( "Invalid subsystem, subsystem=%d", (int)subsystem );
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+    g_aiaMemoryPressureCallbacks[ subsystem ] = callback;
+    g_aiaMemoryPressureUserData[ subsystem ] = userData;
+    taskEXIT_CRITICAL();
+    return true;
+}
+
+bool AiaMemory_SetBudget( AiaMemorySubsystem_t subsystem, size_t budget )
+{
+    if( (size_t)subsystem >= AIA_MEMORY_NUM_SUBSYSTEMS )
+    {
+        AiaLogError( "Invalid subsystem, subsystem=%d", (int)subsystem );
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+    g_aiaMemorySubsystems[ subsystem ].budget = budget;
+    taskEXIT_CRITICAL();
+    return true;
+}
+
+bool AiaMemory_GetSubsystemStats( AiaMemorySubsystem_t subsystem,
+                                  AiaMemorySubsystemStats_t* stats )
+{
+    if( (size_t)subsystem >= AIA_MEMORY_NUM_SUBSYSTEMS )
+    {
+        AiaLogError( "Invalid subsystem, subsystem=%d", (int)subsystem );
+        return false;
+    }
+    if( !stats )
+    {
+        AiaLogError( "Null stats" );
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+    *stats = g_aiaMemorySubsystems[ subsystem ];
+    taskEXIT_CRITICAL();
+    return true;
+}
+
+#endif /* AIA_MEMORY_BUDGET_ENABLE */
+
+#if AIA_MEMORY_TRACE_ENABLE
+
+size_t AiaMemory_ReadTrace( AiaMemoryTraceRecord_t* records, size_t maxRecords,
+                            uint32_t* dropped )
+{
+    if( !records && maxRecords )
+    {
+        AiaLogError( "Null records" );
+        return 0;
+    }
+
+    size_t numRecords = 0;
+    taskENTER_CRITICAL();
+    while( numRecords < maxRecords &&
+           g_aiaMemoryTraceRead != g_aiaMemoryTraceWritten )
+    {
+        records[ numRecords++ ] =
+            g_aiaMemoryTrace[ g_aiaMemoryTraceRead % AIA_MEMORY_TRACE_CAPACITY ];
+        ++g_aiaMemoryTraceRead;
+    }
+    if( dropped )
+    {
+        *dropped = g_aiaMemoryTraceDropped;
+    }
+    taskEXIT_CRITICAL();
+
+    return numRecords;
+}
+
+void AiaMemory_DumpTrace()
+{
+    AiaMemorySiteStats_t site;
+    for( size_t i = 0; i < AIA_MEMORY_STATS_MAX_SITES; ++i )
+    {
+        taskENTER_CRITICAL();
+        site = g_aiaMemorySites[ i ];
+        taskEXIT_CRITICAL();
+        if( site.file )
+        {
+            AiaLogInfo( "AIATRACE S %zu %s:%" PRIu32, i, site.file,
+                        site.line );
+        }
+    }
+
+    /* Drain in small batches to keep critical sections short. */
+    AiaMemoryTraceRecord_t records[ 8 ];
+    uint32_t dropped = 0;
+    size_t numRecords;
+    while( ( numRecords = AiaMemory_ReadTrace(
+                 records, sizeof( records ) / sizeof( records[ 0 ] ),
+                 &dropped ) ) > 0 )
+    {
+        for( size_t i = 0; i < numRecords; ++i )
+        {
+            AiaLogInfo( "AIATRACE %c %" PRIu32 " %" PRIx32 " %" PRIu32
+                        " %" PRIu16,
+                        records[ i ].op, records[ i ].tick,
+                        records[ i ].address, records[ i ].size,
+                        records[ i ].site );
+        }
+    }
+    AiaLogInfo( "AIATRACE D %" PRIu32, dropped );
+}
+
+#endif /* AIA_MEMORY_TRACE_ENABLE */
+
+#endif /* AIA_MEMORY_STATS_ENABLE */
+
+/* The function names are parenthesized so that the accounting macros do not
+ * expand here. */
+
+void* ( AiaCalloc )( size_t count, size_t size )
+{
+    return AiaMemory_AllocateInternal( count, size, 0, true,
+                                       AIA_MEMORY_SUBSYSTEM_OTHER, NULL, 0 );
+}
+
+void* ( AiaMalloc )( size_t count, size_t size )
+{
+    return AiaMemory_AllocateInternal( count, size, 0, false,
+                                       AIA_MEMORY_SUBSYSTEM_OTHER, NULL, 0 );
+}
+
+void* ( AiaMallocAligned )( size_t count, size_t size, size_t alignment )
+{
+    if( !alignment )
+    {
+        AiaLogError( "Invalid alignment, alignment=%zu", alignment );
+        return NULL;
+    }
+    return AiaMemory_AllocateInternal( count, size, alignment, false,
+                                       AIA_MEMORY_SUBSYSTEM_OTHER, NULL, 0 );
+}
+
+void AiaFree( void* ptr )
+{
+    if( !ptr )
+    {
+        return;
+    }
+    AiaMemory_ReleaseTracked( ptr );
+}
+
+void AiaFreeAligned( void* ptr )
+{
+    if( !ptr )
+    {
+        return;
+    }
+
+    void* base = NULL;
+    memcpy( &base, (uint8_t*)ptr - sizeof( void* ), sizeof( void* ) );
+    AiaFree( base );
+}
+
+#if AIA_MEMORY_STACK_PROFILE_ENABLE
+
+/** Lowest stack headroom seen for tasks of a given name. */
+typedef struct AiaMemoryStackProfile
+{
+    /** Name of the task(s). */
+    char name[ configMAX_TASK_NAME_LEN ];
+
+    /** Lowest headroom seen, in bytes. */
+    size_t minHeadroomBytes;
+
+    /** Most tasks with this name seen alive at once. */
+    UBaseType_t instances;
+} AiaMemoryStackProfile_t;
+
+/** @name Variables synchronized by suspending the scheduler. */
+/** @{ */
+static AiaMemoryStackProfile_t
+    g_aiaMemoryStackProfiles[ AIA_MEMORY_STACK_PROFILE_MAX_TASKS ];
+static size_t g_aiaMemoryNumStackProfiles;
+static bool g_aiaMemoryStackProfilesTruncated;
+static TaskStatus_t g_aiaMemoryTaskStatus[ AIA_MEMORY_STACK_PROFILE_MAX_TASKS ];
+/** @} */
+
+/**
+ * Finds or claims the profile for a task name. Must be called with the
+ * scheduler suspended.
+ *
+ * @param name Name of a task.
+ * @return The profile, or @c NULL if the table is full.
+ */
+static AiaMemoryStackProfile_t* AiaMemoryStack_FindProfile( const char* name )
+{
+    for( size_t p = 0; p < g_aiaMemoryNumStackProfiles; ++p )
+    {
+        if( !strncmp( g_aiaMemoryStackProfiles[ p ].name, name,
+                      configMAX_TASK_NAME_LEN - 1 ) )
+        {
+            return &g_aiaMemoryStackProfiles[ p ];
+        }
+    }
+    if( g_aiaMemoryNumStackProfiles == AIA_MEMORY_STACK_PROFILE_MAX_TASKS )
+    {
+        return NULL;
+    }
+
+    AiaMemoryStackProfile_t* profile =
+        &g_aiaMemoryStackProfiles[ g_aiaMemoryNumStackProfiles++ ];
+    strncpy( profile->name, name, configMAX_TASK_NAME_LEN - 1 );
+    profile->name[ configMAX_TASK_NAME_LEN - 1 ] = '\0';
+    profile->minHeadroomBytes = SIZE_MAX;
+    profile->instances = 0;
+    return profile;
+}
+
+void AiaMemory_SampleStacks()
+{
+    vTaskSuspendAll();
+    UBaseType_t numTasks = uxTaskGetSystemState(
+        g_aiaMemoryTaskStatus, AIA_MEMORY_STACK_PROFILE_MAX_TASKS, NULL );
+    if( !numTasks )
+    {
+        /* uxTaskGetSystemState() reports nothing if the array is too small. */
+        g_aiaMemoryStackProfilesTruncated = true;
+    }
+
+    for( UBaseType_t i = 0; i < numTasks; ++i )
+    {
+        const TaskStatus_t* status = &g_aiaMemoryTaskStatus[ i ];
+        AiaMemoryStackProfile_t* profile =
+            AiaMemoryStack_FindProfile( status->pcTaskName );
+        if( !profile )
+        {
+            g_aiaMemoryStackProfilesTruncated = true;
+            continue;
+        }
+
+        size_t headroom =
+            (size_t)status->usStackHighWaterMark * sizeof( StackType_t );
+        if( headroom < profile->minHeadroomBytes )
+        {
+            profile->minHeadroomBytes = headroom;
+        }
+
+        UBaseType_t instances = 0;
+        for( UBaseType_t j = 0; j < numTasks; ++j )
+        {
+            if( !strncmp( profile->name, g_aiaMemoryTaskStatus[ j ].pcTaskName,
+                          configMAX_TASK_NAME_LEN - 1 ) )
+            {
+                ++instances;
+            }
+        }
+        if( instances > profile->instances )
+        {
+            profile->instances = instances;
+        }
+    }
+    xTaskResumeAll();
+}
+
+bool AiaMemory_LogStackUsage()
+{
+    AiaMemory_SampleStacks();
+
+    /* Snapshot the table so that nothing is logged with the scheduler
+     * suspended. */
+    static AiaMemoryStackProfile_t
+        profiles[ AIA_MEMORY_STACK_PROFILE_MAX_TASKS ];
+    vTaskSuspendAll();
+    size_t numProfiles = g_aiaMemoryNumStackProfiles;
+    bool truncated = g_aiaMemoryStackProfilesTruncated;
+    memcpy( profiles, g_aiaMemoryStackProfiles,
+            numProfiles * sizeof( profiles[ 0 ] ) );
+    xTaskResumeAll();
+
+    bool healthy = true;
+    for( size_t p = 0; p < numProfiles; ++p )
+    {
+        if( profiles[ p ].minHeadroomBytes <
+            AIA_MEMORY_STACK_HEADROOM_WARN_BYTES )
+        {
+            AiaLogWarn( "Stack %s: headroom=%zu bytes, instances=%lu, LOW",
+                        profiles[ p ].name, profiles[ p ].minHeadroomBytes,
+                        (unsigned long)profiles[ p ].instances );
+            healthy = false;
+        }
+        else
+        {
+            AiaLogInfo( "Stack %s: headroom=%zu bytes, instances=%lu",
+                        profiles[ p ].name, profiles[ p ].minHeadroomBytes,
+                        (unsigned long)profiles[ p ].instances );
+        }
+    }
+
+    if( truncated )
+    {
+        AiaLogWarn( "Some tasks were not profiled, increase "
+                    "AIA_MEMORY_STACK_PROFILE_MAX_TASKS" );
+    }
+    return healthy;
+}
+
+#endif /* AIA_MEMORY_STACK_PROFILE_ENABLE */
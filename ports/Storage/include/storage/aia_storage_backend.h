@@ -0,0 +1,253 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file aia_storage_backend.h
+ * @brief Media the blob functions of @c aia_storage_config.h are stored on.
+ *
+ * @c aia_storage_config.c validates blob identifiers, buffers and capacities
+ * and then hands each request to the backend selected by @c
+ * AIA_STORAGE_BACKEND through @c AiaStorageBackend( MEMBER ). A backend is a
+ * set of functions named @c <Prefix>_StoreBlob, @c <Prefix>_LoadBlob, @c
+ * <Prefix>_GetBlobSize, @c <Prefix>_BlobExists, @c <Prefix>_CommitBlobs, @c
+ * <Prefix>_BorrowBlob and @c <Prefix>_Compact with the signatures declared
+ * below, which may assume valid arguments: @c id is below @c
+ * AIA_STORAGE_BACKEND_NUM_BLOBS, @c size never exceeds the blob's capacity
+ * when storing and is the blob's current size when loading, and @c CommitBlobs
+ * gets at most @c AIA_STORAGE_TRANSACTION_MAX_BLOBS distinct blobs, which it
+ * must write atomically. @c LoadBlob returns @c
+ * AIA_STORAGE_ERROR_CORRUPTED if a persistent backend finds the blob fails its
+ * checksum. @c BlobExists returns whether the latest write of the blob holds
+ * data, so a blob deleted by storing it empty no longer exists. @c BorrowBlob
+ * returns the address of a blob's bytes if they can be read in place and pass
+ * their checksum, and @c false otherwise. @c Compact
+ * reclaims a bounded amount of space taken by superseded data and returns
+ * whether it did. Like the functions they back, they are not required to be
+ * thread-safe.
+ */
+
+#ifndef AIA_STORAGE_BACKEND_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define AIA_STORAGE_BACKEND_H_
+
+#include <storage/aia_storage_config.h>
+
+/** @name Available backends. */
+/** @{ */
+
+/** Blobs are kept in static RAM and lost on reboot. */
+#define AIA_STORAGE_BACKEND_RAM 0
+
+/**
+ * Blobs are appended to a log on the flash device of @c aia_storage_flash.h,
+ * so they survive a reboot or a power loss.
+ */
+#define AIA_STORAGE_BACKEND_LOG 1
+
+/**
+ * Blobs are kept in a memory-mapped file, for host builds on a POSIX system
+ * such as simulators and load tests.
+ */
+#define AIA_STORAGE_BACKEND_MMAP 2
+
+/** @} */
+
+#ifndef AIA_STORAGE_BACKEND
+#define AIA_STORAGE_BACKEND AIA_STORAGE_BACKEND_RAM
+#endif
+
+#if AIA_STORAGE_BACKEND == AIA_STORAGE_BACKEND_RAM
+#define AiaStorageBackend( MEMBER ) AiaStorageRam_##MEMBER
+#elif AIA_STORAGE_BACKEND == AIA_STORAGE_BACKEND_LOG
+#define AiaStorageBackend( MEMBER ) AiaStorageLog_##MEMBER
+#elif AIA_STORAGE_BACKEND == AIA_STORAGE_BACKEND_MMAP
+#define AiaStorageBackend( MEMBER ) AiaStorageMmap_##MEMBER
+#else
+#error "Unknown AIA_STORAGE_BACKEND"
+#endif
+
+/**
+ * Number of blob identifiers a backend is handed. Blob @c id of namespace @c n
+ * is @c n * @c AIA_STORAGE_NUM_BLOBS + @c id, so the first namespace keeps the
+ * identifiers of @c aia_storage_config.h. When there are several namespaces,
+ * one more blob per namespace follows them, holding the identifier of the
+ * client that claimed it.
+ */
+#define AIA_STORAGE_BACKEND_NUM_BLOBS                    \
+    ( AIA_STORAGE_NAMESPACES * AIA_STORAGE_NUM_BLOBS + \
+      ( AIA_STORAGE_NAMESPACES > 1 ? AIA_STORAGE_NAMESPACES : 0 ) )
+
+/**
+ * @param id A blob identifier as handed to backends.
+ * @return The most bytes the blob can hold, or @c 0 if @c id is invalid.
+ */
+static inline size_t AiaStorage_GetBackendBlobCapacity( AiaStorageBlobId_t id )
+{
+    if( (size_t)id < AIA_STORAGE_NAMESPACES * AIA_STORAGE_NUM_BLOBS )
+    {
+        return AiaStorage_GetBlobCapacity(
+            (AiaStorageBlobId_t)( (size_t)id % AIA_STORAGE_NUM_BLOBS ) );
+    }
+    return (size_t)id < AIA_STORAGE_BACKEND_NUM_BLOBS
+               ? AIA_STORAGE_CLIENT_ID_CAPACITY
+               : 0;
+}
+
+/**
+ * @param id A blob identifier as handed to backends.
+ * @return Whether @c id is the alert slot of some namespace.
+ */
+static inline bool AiaStorage_IsAlertSlot( AiaStorageBlobId_t id )
+{
+    return (size_t)id < AIA_STORAGE_NAMESPACES * AIA_STORAGE_NUM_BLOBS &&
+           (size_t)id % AIA_STORAGE_NUM_BLOBS >= AIA_STORAGE_BLOB_ALERT_SLOT_0;
+}
+
+/** One blob write of a transaction. */
+typedef struct AiaStorageBlobWrite
+{
+    /** The blob to store. */
+    AiaStorageBlobId_t id;
+
+    /** The data to store. */
+    const uint8_t* blob;
+
+    /** Size of @c blob. */
+    size_t size;
+} AiaStorageBlobWrite_t;
+
+/** @name RAM backend, implemented in @c aia_storage_ram.c. */
+/** @{ */
+
+bool AiaStorageRam_StoreBlob( AiaStorageBlobId_t id, const uint8_t* blob,
+                              size_t size );
+AiaStorageError_t AiaStorageRam_LoadBlob( AiaStorageBlobId_t id,
+                                          uint8_t* blob, size_t size );
+size_t AiaStorageRam_GetBlobSize( AiaStorageBlobId_t id );
+bool AiaStorageRam_BlobExists( AiaStorageBlobId_t id );
+bool AiaStorageRam_CommitBlobs( const AiaStorageBlobWrite_t* writes,
+                                size_t count );
+bool AiaStorageRam_BorrowBlob( AiaStorageBlobId_t id, const uint8_t** data );
+bool AiaStorageRam_Compact();
+
+/** @} */
+
+/**
+ * @name Log-structured backend, implemented in @c aia_storage_log.c.
+ *
+ * Every store appends a record carrying the blob identifier, its length and a
+ * CRC-32C to the active flash block, and an index in RAM points at the latest
+ * record of each blob. A record is programmed header first, so a write torn by
+ * a power loss fails its checksum and the previous record of that blob stays
+ * current. A record damaged after it was written also fails its checksum, but
+ * is followed by valid records in its block, so replay indexes it anyway, and
+ * loading or borrowing it reports it as corrupted rather than returning it or
+ * an older record. Blocks are stamped with an increasing sequence number when
+ * they are opened, which orders records across blocks when the log is replayed
+ * on the first access after boot. The records of a transaction are marked
+ * pending and sealed by a commit record, and replay drops them if that record
+ * is missing. Blobs can be borrowed in place when @c
+ * AIA_STORAGE_FLASH_MAPPED_ADDRESS is defined.
+ *
+ * Free blocks are taken in turn, starting after the active block, so erases
+ * spread evenly over the device, and a block erased when it was reclaimed is
+ * not erased again when it is opened. One erased block is always held in
+ * reserve. When the log runs out of space, the live records of the block with
+ * the least live data are moved into the reserve and that block is erased to
+ * become the new reserve. With no other block in use, the active block itself
+ * is moved. If the power is lost while records are moved into the reserve,
+ * the next mount erases the copies and the move is redone. @c
+ * AiaStorageLog_Compact() moves records ahead of time once only the reserve is
+ * left, and the write-behind flush task calls it whenever its queue drains, to
+ * keep writes from paying for it.
+ *
+ * Deleting a blob appends an empty record, a tombstone, so a delete costs the
+ * same small write whatever the blob held. The tombstone of an alert slot is
+ * dropped once the block it is in is the oldest one and gets reclaimed, since
+ * no earlier record of the slot is left to hide.
+ */
+/** @{ */
+
+bool AiaStorageLog_StoreBlob( AiaStorageBlobId_t id, const uint8_t* blob,
+                              size_t size );
+AiaStorageError_t AiaStorageLog_LoadBlob( AiaStorageBlobId_t id,
+                                          uint8_t* blob, size_t size );
+size_t AiaStorageLog_GetBlobSize( AiaStorageBlobId_t id );
+bool AiaStorageLog_BlobExists( AiaStorageBlobId_t id );
+bool AiaStorageLog_CommitBlobs( const AiaStorageBlobWrite_t* writes,
+                                size_t count );
+bool AiaStorageLog_BorrowBlob( AiaStorageBlobId_t id, const uint8_t** data );
+
+/**
+ * Reclaims the block holding the most superseded records, once the reserve is
+ * the only free block left, by moving its live records to the head of the log
+ * and erasing it. Must not be
+ * called while blob views are borrowed, which it may move, nor from outside
+ * the Storage port when @c AIA_STORAGE_WRITE_BEHIND is enabled.
+ *
+ * @return @c true if a block was reclaimed or @c false otherwise.
+ */
+bool AiaStorageLog_Compact();
+
+/** @} */
+
+/**
+ * @name Memory-mapped file backend, implemented in @c aia_storage_mmap.c.
+ *
+ * Every blob has a slot at a fixed offset in @c AIA_STORAGE_MMAP_FILE_NAME,
+ * which is mapped into memory on first access, so loads copy straight out of
+ * the mapping and borrows read it in place. A slot holds the blob's length and
+ * a CRC-32C, which is verified on every load and borrow. Stores and commits
+ * are first written to a journal at the start of the file and then to the
+ * slots, and the journal is replayed on the next mount, so a write cut short
+ * by the process stopping is either completed or not found at all.
+ */
+/** @{ */
+
+/** Name of the file, under @c g_aiaStorageFolder when that is set. */
+#ifndef AIA_STORAGE_MMAP_FILE_NAME
+#define AIA_STORAGE_MMAP_FILE_NAME "aia_storage.mmap"
+#endif
+
+/**
+ * Whether every write calls @c msync() between the steps of updating the
+ * journal and after the slots, so that it survives the host crashing.
+ * Without it, writes still survive the process being killed, since the
+ * mapping is shared with the page cache, and cost no disk access.
+ */
+#ifndef AIA_STORAGE_MMAP_SYNC
+#define AIA_STORAGE_MMAP_SYNC 1
+#endif
+
+bool AiaStorageMmap_StoreBlob( AiaStorageBlobId_t id, const uint8_t* blob,
+                               size_t size );
+AiaStorageError_t AiaStorageMmap_LoadBlob( AiaStorageBlobId_t id,
+                                           uint8_t* blob, size_t size );
+size_t AiaStorageMmap_GetBlobSize( AiaStorageBlobId_t id );
+bool AiaStorageMmap_BlobExists( AiaStorageBlobId_t id );
+bool AiaStorageMmap_CommitBlobs( const AiaStorageBlobWrite_t* writes,
+                                 size_t count );
+bool AiaStorageMmap_BorrowBlob( AiaStorageBlobId_t id, const uint8_t** data );
+bool AiaStorageMmap_Compact();
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* ifndef AIA_STORAGE_BACKEND_H_ */
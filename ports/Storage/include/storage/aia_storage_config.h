@@ -20,10 +20,446 @@ extern "C" {
 #endif
 #define AIA_STORAGE_CONFIG_H_
 
+#include <aia_capabilities_config.h>
 #include <clock/aia_clock_config.h>
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @name Blob identifiers.
+ *
+ * Every key the SDK stores a blob under is listed in @c AIA_STORAGE_BLOBS as
+ * ( NAME, KEY ) and resolved to a dense @c AiaStorageBlobId_t, so that callers
+ * that know which blob they want can skip the key lookup entirely through the
+ * @c ById functions below. Each blob can hold up to @c
+ * AIA_STORAGE_<NAME>_CAPACITY bytes.
+ *
+ * Alerts are kept one per blob in @c AIA_STORAGE_ALERT_SLOTS slots following
+ * the keyed blobs, so that storing or deleting an alert writes a single
+ * record. The slots have no key and are only reachable by identifier. There is
+ * one slot for every alert advertised in @c AIA_ALERTS_MAX_ALERT_COUNT.
+ */
+/** @{ */
+
+#ifndef AIA_STORAGE_ALERT_SLOTS
+#ifdef AIA_ALERTS_MAX_ALERT_SLOTS
+#define AIA_STORAGE_ALERT_SLOTS AIA_ALERTS_MAX_ALERT_SLOTS
+#else
+/* Alerts are not supported; one slot keeps the slot tables well-formed. */
+#define AIA_STORAGE_ALERT_SLOTS 1
+#endif
+#endif
+
+/** Characters in an alert token, which must match @c AIA_ALERT_TOKEN_CHARS. */
+#define AIA_STORAGE_ALERT_TOKEN_CHARS 64
+
+/**
+ * Size of one alert in the format exchanged with the SDK through @c
+ * AiaLoadAlerts(), which must match @c AIA_SIZE_OF_ALERT_IN_BYTES: the token,
+ * then the scheduled time, duration and type in little endian. Earlier
+ * versions of this port also stored alerts in this format.
+ */
+#define AIA_STORAGE_ALERT_V0_SIZE                                     \
+    ( AIA_STORAGE_ALERT_TOKEN_CHARS + sizeof( AiaTimepointSeconds_t ) + \
+      sizeof( AiaDurationMs_t ) + sizeof( uint8_t ) )
+
+/** Version of the alert records written to the slots. */
+#define AIA_STORAGE_ALERT_RECORD_VERSION 1
+
+/**
+ * Size of one alert record in a slot. Records have a fixed little-endian
+ * layout with every field naturally aligned: the version and the type in one
+ * byte each, two zero bytes, the duration in 32 bits, the scheduled time in 64
+ * bits, the token, and a CRC-32C of all the preceding bytes.
+ */
+#define AIA_STORAGE_ALERT_RECORD_SIZE ( 16 + AIA_STORAGE_ALERT_TOKEN_CHARS + 4 )
+
+#ifndef AIA_STORAGE_SHARED_SECRET_CAPACITY
+#define AIA_STORAGE_SHARED_SECRET_CAPACITY 32
+#endif
+
+#ifndef AIA_STORAGE_ALL_ALERTS_V0_CAPACITY
+#define AIA_STORAGE_ALL_ALERTS_V0_CAPACITY 64
+#endif
+
+#ifndef AIA_STORAGE_TOPIC_ROOT_CAPACITY
+#define AIA_STORAGE_TOPIC_ROOT_CAPACITY 16
+#endif
+
+#define AIA_STORAGE_VOLUME_CAPACITY 1
+
+/**
+ * The keyed blobs as ( NAME, KEY, HASH ), where @c HASH is the 32-bit FNV-1a
+ * hash of the characters of @c KEY, as printed by:
+ *
+ * @code
+ * python3 -c 'import sys;h=2166136261
+ * for c in sys.argv[1].encode():h=(h^c)*16777619%2**32
+ * print(hex(h))' KEY
+ * @endcode
+ *
+ * @c AiaStorage_GetBlobId() switches on the hashes, so two keys with the same
+ * hash fail the build with a duplicate case; rename one of them. A wrong hash
+ * leaves its key unreachable, since every match is confirmed against @c KEY.
+ */
+#define AIA_STORAGE_BLOBS( BLOB )                                   \
+    BLOB( SHARED_SECRET, "AiaSharedSecretStorageKey", 0x9e92ca4bu ) \
+    BLOB( ALL_ALERTS_V0, "AiaAllAlertsStorageKey", 0xeb81bc1eu )    \
+    BLOB( TOPIC_ROOT, "AiaTopicRootKey", 0xd95d0644u )              \
+    BLOB( VOLUME, "AiaVolumeKey", 0xe67ec81bu )
+
+#define AIA_STORAGE_BLOB_ENUMERATOR( NAME, KEY, HASH ) AIA_STORAGE_BLOB_##NAME,
+
+/** Identifies one of the blobs in @c AIA_STORAGE_BLOBS or an alert slot. */
+typedef enum AiaStorageBlobId
+{
+    AIA_STORAGE_BLOBS( AIA_STORAGE_BLOB_ENUMERATOR )
+
+    /** The first alert slot. */
+    AIA_STORAGE_BLOB_ALERT_SLOT_0,
+
+    /** The number of blobs, also returned for unknown keys. */
+    AIA_STORAGE_NUM_BLOBS =
+        AIA_STORAGE_BLOB_ALERT_SLOT_0 + AIA_STORAGE_ALERT_SLOTS
+} AiaStorageBlobId_t;
+
+#undef AIA_STORAGE_BLOB_ENUMERATOR
+
+/**
+ * @param id The blob to query.
+ * @return The most bytes the blob can hold, or @c 0 if @c id is invalid.
+ */
+static inline size_t AiaStorage_GetBlobCapacity( AiaStorageBlobId_t id )
+{
+    switch( id )
+    {
+#define AIA_STORAGE_BLOB_CAPACITY_CASE( NAME, KEY, HASH ) \
+    case AIA_STORAGE_BLOB_##NAME:                         \
+        return AIA_STORAGE_##NAME##_CAPACITY;
+        AIA_STORAGE_BLOBS( AIA_STORAGE_BLOB_CAPACITY_CASE )
+#undef AIA_STORAGE_BLOB_CAPACITY_CASE
+        default:
+            return id < AIA_STORAGE_NUM_BLOBS ? AIA_STORAGE_ALERT_RECORD_SIZE
+                                              : 0;
+    }
+}
+
+/**
+ * Resolves a key to its blob identifier.
+ *
+ * @param key Null-terminated key of the blob.
+ * @return The identifier, or @c AIA_STORAGE_NUM_BLOBS if @c key is unknown.
+ */
+AiaStorageBlobId_t AiaStorage_GetBlobId( const char* key );
+
+/**
+ * Same as @c AiaStoreBlob() for a blob identified by @c id.
+ *
+ * @param id The blob to store.
+ * @param blob The buffer to persist.
+ * @param size Size of @c blob.
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaStoreBlobById( AiaStorageBlobId_t id, const uint8_t* blob,
+                       size_t size );
+
+/**
+ * Same as @c AiaLoadBlob() for a blob identified by @c id.
+ *
+ * @param id The blob to load.
+ * @param[out] blob The buffer to load.
+ * @param size Size of @c blob.
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaLoadBlobById( AiaStorageBlobId_t id, uint8_t* const blob,
+                      size_t size );
+
+/** Why a blob could not be loaded. */
+typedef enum AiaStorageError
+{
+    /** The last load succeeded. */
+    AIA_STORAGE_ERROR_NONE,
+
+    /**
+     * The blob's bytes failed their checksum. Reloading will not help: the
+     * blob must be stored again, which for the shared secret and topic root
+     * means registering again.
+     */
+    AIA_STORAGE_ERROR_CORRUPTED,
+
+    /** The blob could not be read, or did not fit the buffer. */
+    AIA_STORAGE_ERROR_FAILED
+} AiaStorageError_t;
+
+/**
+ * Tells why the last call to @c AiaLoadBlob(), @c AiaLoadBlobById(), @c
+ * AiaLoadSecret() or @c AiaStorage_BorrowBlobById() failed, so that a client
+ * finding its shared secret corrupted can register again instead of first
+ * failing to connect with it. The result is kept per namespace, so each
+ * client sees its own; two tasks loading in the same namespace overwrite each
+ * other's result.
+ *
+ * @return The error of the last load, or @c AIA_STORAGE_ERROR_NONE if it
+ * succeeded.
+ */
+AiaStorageError_t AiaStorage_GetLastError();
+
+/**
+ * Same as @c AiaGetBlobSize() for a blob identified by @c id.
+ *
+ * @param id The blob to query.
+ * @return the length of data in bytes. @c 0 will be returned on failures.
+ */
+size_t AiaGetBlobSizeById( AiaStorageBlobId_t id );
+
+/**
+ * Same as @c AiaBlobExists() for a blob identified by @c id. A blob exists
+ * while its latest write, pending or stored, holds data, so a blob is gone
+ * once @c AiaDeleteBlobById() has stored it empty.
+ *
+ * @param id The blob to query.
+ * @return @c true if the blob exists of @c false otherwise.
+ */
+bool AiaBlobExistsById( AiaStorageBlobId_t id );
+
+/**
+ * Empties a blob, after which @c AiaGetBlobSizeById() returns @c 0.
+ *
+ * @param id The blob to delete.
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaDeleteBlobById( AiaStorageBlobId_t id );
+
+/** A read-only view of a blob, borrowed from the storage. */
+typedef struct AiaStorageBlobView
+{
+    /** The blob's bytes, or @c NULL if nothing is borrowed. */
+    const uint8_t* data;
+
+    /** Size of @c data. */
+    size_t size;
+
+    /** Namespace of the blob, for @c AiaStorage_ReleaseBlob(). */
+    size_t ns;
+
+    /** Whether @c data points into the backend, for the same. */
+    bool lent;
+} AiaStorageBlobView_t;
+
+/**
+ * Borrows a view of a blob without copying it when the backend keeps it in
+ * addressable memory, as the RAM backend and memory-mapped flash do.
+ * Otherwise the blob is copied into an internal buffer, which only one view of
+ * each namespace can hold at a time. Views must be released before any blob
+ * of their namespace is stored or deleted, since a store may move or
+ * overwrite the viewed bytes; such stores fail while a view is outstanding.
+ *
+ * @param id The blob to borrow.
+ * @param[out] view The view, to be released with @c AiaStorage_ReleaseBlob().
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaStorage_BorrowBlobById( AiaStorageBlobId_t id,
+                                AiaStorageBlobView_t* view );
+
+/**
+ * Releases a view returned by @c AiaStorage_BorrowBlobById(). Releasing a view
+ * that holds nothing does nothing.
+ *
+ * @param view The view to release, which is emptied.
+ */
+void AiaStorage_ReleaseBlob( AiaStorageBlobView_t* view );
+
+/** @} */
+
+/**
+ * @name Transactions.
+ *
+ * Between @c AiaStorage_BeginTransaction() and @c
+ * AiaStorage_CommitTransaction(), blob stores and deletes, including those made
+ * by the key, secret and alert functions below, are staged in RAM and then
+ * written together in a single append to the media, so that after a power loss
+ * either all or none of them are found. Loads see the staged blobs. A
+ * transaction holds up to @c AIA_STORAGE_TRANSACTION_MAX_BLOBS blobs of @c
+ * AIA_STORAGE_TRANSACTION_SIZE bytes in total; stores beyond that fail. Both
+ * must cover every alert slot, since the bulk alert functions below rewrite
+ * them in a single transaction, and by default leave room for four blobs of
+ * up to 256 bytes besides.
+ */
+/** @{ */
+
+#ifndef AIA_STORAGE_TRANSACTION_MAX_BLOBS
+#define AIA_STORAGE_TRANSACTION_MAX_BLOBS ( AIA_STORAGE_ALERT_SLOTS + 4 )
+#endif
+
+#ifndef AIA_STORAGE_TRANSACTION_SIZE
+#define AIA_STORAGE_TRANSACTION_SIZE \
+    ( AIA_STORAGE_ALERT_SLOTS * AIA_STORAGE_ALERT_RECORD_SIZE + 256 )
+#endif
+
+/**
+ * Starts staging blob writes.
+ *
+ * @return @c true on success, or @c false if a transaction is already open.
+ */
+bool AiaStorage_BeginTransaction();
+
+/**
+ * Writes the staged blobs atomically and closes the transaction. Blobs queued
+ * by write-behind are flushed first, so that none lands after the commit.
+ *
+ * @return @c true on success or @c false otherwise, in which case none of the
+ * staged blobs were written.
+ */
+bool AiaStorage_CommitTransaction();
+
+/** Drops the staged blobs and closes the transaction, if one is open. */
+void AiaStorage_AbortTransaction();
+
+/** @} */
+
+/**
+ * @name Namespaces.
+ *
+ * With @c AIA_STORAGE_NAMESPACES above one, the storage holds that many
+ * independent sets of the blobs above, each with its own secret, topic root,
+ * volume, alerts and last error, so that several clients can share one
+ * process. Every blob, key, secret, volume, alert and transaction
+ * function acts on the namespace the calling task selected last with @c
+ * AiaStorage_SelectNamespace(), or on the first one if it selected none.
+ * Tasks of different clients may use the storage at the same time, while each
+ * client still serializes its own calls. A task acting for several clients,
+ * such as a task pool worker, selects the namespace of each before using the
+ * storage on its behalf. Writes already queued keep the namespace they were
+ * made in. The first selection must be made before clients use the storage
+ * concurrently, and with several namespaces views are always copies, so that
+ * no client waits on another's views.
+ *
+ * A namespace is claimed by the first client identifier that selects it, and
+ * the claim is stored with the blobs, so the same client finds its namespace
+ * after a reboot. With the log-structured backend, the blobs stored before
+ * namespaces were enabled are found in the first namespace, so the first
+ * client to select one adopts them.
+ *
+ * Transactions and the buffers views are copied into are shared by the
+ * namespaces: @c AIA_STORAGE_CONCURRENT_NAMESPACES of each are kept, an open
+ * transaction holds one of the first and a copied view one of the second.
+ * Beginning a transaction or borrowing a view fails while none is free, so
+ * raise it to the number of clients that may hold either at the same time.
+ *
+ * The log-structured backend stores blob identifiers in one byte, which
+ * limits @c AIA_STORAGE_NAMESPACES * ( @c AIA_STORAGE_NUM_BLOBS + 1 ) to 253:
+ * ten namespaces with the default 20 alert slots. The build fails beyond that.
+ */
+/** @{ */
+
+#ifndef AIA_STORAGE_NAMESPACES
+#define AIA_STORAGE_NAMESPACES 1
+#endif
+
+#ifndef AIA_STORAGE_CONCURRENT_NAMESPACES
+#define AIA_STORAGE_CONCURRENT_NAMESPACES 1
+#endif
+
+/** Longest client identifier that can claim a namespace. */
+#ifndef AIA_STORAGE_CLIENT_ID_CAPACITY
+#define AIA_STORAGE_CLIENT_ID_CAPACITY 128
+#endif
+
+/**
+ * Index of the FreeRTOS thread local storage pointer that holds the namespace
+ * each task selected, which @c configNUM_THREAD_LOCAL_STORAGE_POINTERS must
+ * leave room for.
+ */
+#ifndef AIA_STORAGE_NAMESPACE_TLS_INDEX
+#define AIA_STORAGE_NAMESPACE_TLS_INDEX 0
+#endif
+
+/**
+ * Non-zero to hold the namespace each thread selected in a POSIX thread key
+ * instead, for host builds without FreeRTOS.
+ */
+#ifndef AIA_STORAGE_NAMESPACE_PTHREAD
+#define AIA_STORAGE_NAMESPACE_PTHREAD 0
+#endif
+
+/**
+ * Selects the namespace of a client for the calling task, claiming a free one
+ * for it if it has none yet. Does nothing when @c AIA_STORAGE_NAMESPACES is
+ * one.
+ *
+ * @param clientId Null-terminated identifier of the client, such as its IoT
+ * thing name.
+ * @return @c true on success, or @c false if the client has no namespace and
+ * none is free.
+ */
+bool AiaStorage_SelectNamespace( const char* clientId );
+
+/** @} */
+
+/**
+ * @name Write-behind.
+ *
+ * When @c AIA_STORAGE_WRITE_BEHIND is non-zero, blob stores made outside a
+ * transaction, including those made by the key, secret, volume and alert
+ * functions below, are copied into a RAM queue and return without waiting for
+ * the media. A flush task started on the first store writes them to the
+ * backend, oldest first. Loads, sizes and views see queued blobs, so callers
+ * always read their own writes. A blob stored again while queued is written
+ * once, so after a power loss any subset of the queued blobs may be missing;
+ * blobs that must change together belong in a transaction.
+ *
+ * The queue holds up to @c AIA_STORAGE_WRITE_BEHIND_MAX_BLOBS blobs of @c
+ * AIA_STORAGE_WRITE_BEHIND_SIZE bytes in total. A store that finds it full
+ * waits for the flush task, and fails if it makes no progress for @c
+ * AIA_STORAGE_WRITE_BEHIND_TIMEOUT_MS. A write that fails stays queued and is
+ * retried every @c AIA_STORAGE_FLUSH_RETRY_MS. If the flush task cannot be
+ * started, stores are written through.
+ */
+/** @{ */
+
+#ifndef AIA_STORAGE_WRITE_BEHIND
+#define AIA_STORAGE_WRITE_BEHIND 1
+#endif
+
+#ifndef AIA_STORAGE_WRITE_BEHIND_MAX_BLOBS
+#define AIA_STORAGE_WRITE_BEHIND_MAX_BLOBS 8
+#endif
+
+#ifndef AIA_STORAGE_WRITE_BEHIND_SIZE
+#define AIA_STORAGE_WRITE_BEHIND_SIZE 512
+#endif
+
+#ifndef AIA_STORAGE_WRITE_BEHIND_TIMEOUT_MS
+#define AIA_STORAGE_WRITE_BEHIND_TIMEOUT_MS 5000
+#endif
+
+#ifndef AIA_STORAGE_FLUSH_RETRY_MS
+#define AIA_STORAGE_FLUSH_RETRY_MS 1000
+#endif
+
+#ifndef AIA_STORAGE_FLUSH_TASK_PRIORITY
+#define AIA_STORAGE_FLUSH_TASK_PRIORITY AiaThread( DEFAULT_PRIORITY )
+#endif
+
+#ifndef AIA_STORAGE_FLUSH_TASK_STACK_SIZE
+#define AIA_STORAGE_FLUSH_TASK_STACK_SIZE AiaThread( DEFAULT_STACK_SIZE )
+#endif
+
+/**
+ * Waits until every queued blob, and a volume still waiting out @c
+ * AIA_STORAGE_VOLUME_DEBOUNCE_MS, is written to the media. Call it before
+ * disconnecting or shutting down. @c AiaStorage_CommitTransaction() calls it
+ * first.
+ *
+ * @return @c true on success, or @c false if a write failed, the flush task
+ * made no progress for @c AIA_STORAGE_WRITE_BEHIND_TIMEOUT_MS or blob views
+ * are borrowed.
+ */
+bool AiaStorage_Flush();
+
+/** @} */
 
 /**
  * @name Retrieval and persistent storage of generic blobs as key-value pairs.
@@ -49,7 +485,8 @@ bool AiaStoreBlob( const char* key, const uint8_t* blob, size_t size );
  * @param key Null-terminated string representing the key for the blob to load.
  * @param[out] blob The buffer to load.
  * @param size Size of @c blob.
- * @return @c true on success or @c false otherwise.
+ * @return @c true on success or @c false otherwise, in which case @c
+ * AiaStorage_GetLastError() tells why.
  */
 bool AiaLoadBlob( const char* key, uint8_t* const blob, size_t size );
 
@@ -96,7 +533,9 @@ bool AiaStoreSecret( const uint8_t* sharedSecret, size_t size );
  *
  * @param[out] sharedSecret The buffer to load into.
  * @param size Size of the @c sharedSecret buffer.
- * @return @c true on success or @c false otherwise.
+ * @return @c true on success or @c false otherwise, in which case @c
+ * AiaStorage_GetLastError() returns @c AIA_STORAGE_ERROR_CORRUPTED if the
+ * stored secret is damaged and registration must be redone.
  */
 bool AiaLoadSecret( uint8_t* sharedSecret, size_t size );
 
@@ -111,9 +550,18 @@ bool AiaLoadSecret( uint8_t* sharedSecret, size_t size );
  */
 /** @{ */
 
+/**
+ * Milliseconds a volume passed to @c AiaStoreVolume() must stay unchanged
+ * before it is written to storage.
+ */
+#ifndef AIA_STORAGE_VOLUME_DEBOUNCE_MS
+#define AIA_STORAGE_VOLUME_DEBOUNCE_MS 2000
+#endif
+
 /**
  * This function is used to load persisted volume for use during
- * synchronizing of device state upon a fresh AIA connection.
+ * synchronizing of device state upon a fresh AIA connection. The volume is
+ * read from storage once and then served from memory.
  *
  * @return @c The loaded volume. Any failure shall return @c AIA_DEFAULT_VOLUME.
  */
@@ -121,6 +569,19 @@ uint8_t AiaLoadVolume();
 
 #define AIA_LOAD_VOLUME AiaLoadVolume
 
+/**
+ * Persists the device volume. The volume is returned by @c AiaLoadVolume()
+ * right away, but only written to storage once it has stayed unchanged for @c
+ * AIA_STORAGE_VOLUME_DEBOUNCE_MS, so that a quick series of changes costs a
+ * single write. A timer then queues the volume for the flush task of @c
+ * AIA_STORAGE_WRITE_BEHIND, which writes it. Without a flush task, the volume
+ * is written on the caller's task right away.
+ *
+ * @param volume The volume, between @c AIA_MIN_VOLUME and @c AIA_MAX_VOLUME.
+ * @return @c true if the volume was accepted or @c false otherwise.
+ */
+bool AiaStoreVolume( uint8_t volume );
+
 /** @} */
 
 /**
@@ -222,6 +683,97 @@ size_t AiaGetAlertsSize();
  */
 bool AiaAlertsBlobExists();
 
+/** An alert as held in persistent storage. */
+typedef struct AiaStorageAlert
+{
+    /** The alert token, not null-terminated. */
+    char token[ AIA_STORAGE_ALERT_TOKEN_CHARS ];
+
+    /** The alert scheduled time. */
+    AiaTimepointSeconds_t scheduledTime;
+
+    /** The alert duration. */
+    AiaDurationMs_t duration;
+
+    /** The alert type. */
+    uint8_t type;
+} AiaStorageAlert_t;
+
+/**
+ * Stores several alerts at once, updating those whose token is already stored.
+ * Nothing is written unless there are enough free slots for all the new
+ * tokens. The alerts are written in a single transaction, so after a power
+ * loss either all or none of them are found. Called with a transaction open,
+ * they are staged in it instead, and a failure leaves it to the caller to
+ * abort.
+ *
+ * @param alerts The alerts to persist.
+ * @param count Number of entries in @c alerts.
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaStoreAlerts( const AiaStorageAlert_t* alerts, size_t count );
+
+/**
+ * Removes several alerts at once, in a single transaction as @c
+ * AiaStoreAlerts() writes them. Tokens that are not stored are ignored.
+ *
+ * @param alertTokens Tokens of @c AIA_ALERT_TOKEN_CHARS characters to remove.
+ * @param count Number of entries in @c alertTokens.
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaDeleteAlerts( const char* const* alertTokens, size_t count );
+
+/**
+ * Replaces the stored alerts with the given set: alerts that are not in @c
+ * alerts are removed and the others are stored. Alerts that are unchanged are
+ * not rewritten. The removals and stores are made in a single transaction as
+ * @c AiaStoreAlerts() makes its writes, so a failure or power loss leaves the
+ * previous set in place.
+ *
+ * @param alerts The complete set of alerts to persist.
+ * @param count Number of entries in @c alerts, at most @c
+ * AIA_STORAGE_ALERT_SLOTS.
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaReplaceAlerts( const AiaStorageAlert_t* alerts, size_t count );
+
+/**
+ * Loads all the stored alerts. A record failing its checksum is dropped and
+ * the load fails, so that retrying loads the remaining alerts.
+ *
+ * @param[out] alerts Array to hold the loaded alerts.
+ * @param capacity Number of entries in @c alerts.
+ * @param[out] count Number of alerts loaded.
+ * @return @c true on success or @c false otherwise, including if there are
+ * more than @c capacity alerts.
+ */
+bool AiaLoadAllAlerts( AiaStorageAlert_t* alerts, size_t capacity,
+                       size_t* count );
+
+/**
+ * Loads the stored alert with the earliest scheduled time. The alerts are kept
+ * ordered as they are stored and deleted, so this reads a single record.
+ *
+ * @param[out] alert The next alert.
+ * @return @c true if an alert was loaded, or @c false if there are no alerts or
+ * on failure.
+ */
+bool AiaLoadNextAlert( AiaStorageAlert_t* alert );
+
+/**
+ * Deletes every stored alert that finished playing before @c
+ * AiaClock_GetTimeSinceNTPEpoch(), going by its scheduled time and duration.
+ * The alerts are found without reading a record beyond those read once to
+ * build the alert index, and are deleted in a single transaction as @c
+ * AiaStoreAlerts() makes its writes, so a failure or power loss leaves every
+ * one of them stored. Call it at boot once the clock is set, before the alerts
+ * are loaded, so that alerts that expired while the device was off are not
+ * played or deleted one by one.
+ *
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaDeleteExpiredAlerts();
+
 #ifdef __cplusplus
 }
 #endif
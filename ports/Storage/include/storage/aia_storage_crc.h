@@ -0,0 +1,55 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file aia_storage_crc.h
+ * @brief Checksum used to detect corrupted records in persistent storage.
+ */
+
+#ifndef AIA_STORAGE_CRC_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define AIA_STORAGE_CRC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Whether the checksum processes 8 bytes per step with 8 KiB of lookup tables
+ * instead of one byte per step with 1 KiB. Every blob load is verified against
+ * its checksum, so this is on by default; set it to @c 0 on targets where
+ * read-only data is scarcer than cycles.
+ */
+#ifndef AIA_STORAGE_CRC_SLICE_BY_8
+#define AIA_STORAGE_CRC_SLICE_BY_8 1
+#endif
+
+/**
+ * Computes the CRC-32C (Castagnoli) of a buffer. A checksum over several
+ * buffers can be built up by passing the result for one as @c crc of the next.
+ *
+ * @param crc The checksum of the preceding data, or @c 0 to start a new one.
+ * @param data The data to checksum.
+ * @param size Size of @c data.
+ * @return The checksum of the preceding data followed by @c data.
+ */
+uint32_t AiaStorage_Crc32c( uint32_t crc, const void* data, size_t size );
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* ifndef AIA_STORAGE_CRC_H_ */
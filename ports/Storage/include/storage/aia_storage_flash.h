@@ -0,0 +1,108 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file aia_storage_flash.h
+ * @brief Flash device used by the log-structured storage backend.
+ *
+ * The device is an array of @c AIA_STORAGE_FLASH_NUM_BLOCKS erase blocks of
+ * @c AIA_STORAGE_FLASH_BLOCK_SIZE bytes. Erasing a block sets all its bytes to
+ * @c 0xFF and programming can only clear bits, in units of @c
+ * AIA_STORAGE_FLASH_PROGRAM_SIZE bytes at aligned offsets. These functions must
+ * be implemented for the target's flash when @c AIA_STORAGE_BACKEND is @c
+ * AIA_STORAGE_BACKEND_LOG. For host builds, @c aia_storage_flash_file.c
+ * implements them over an image file when @c AIA_STORAGE_FLASH_FILE is
+ * non-zero.
+ */
+
+#ifndef AIA_STORAGE_FLASH_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define AIA_STORAGE_FLASH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef AIA_STORAGE_FLASH_BLOCK_SIZE
+#define AIA_STORAGE_FLASH_BLOCK_SIZE 4096
+#endif
+
+/** At least two, since one block is kept erased for compaction. */
+#ifndef AIA_STORAGE_FLASH_NUM_BLOCKS
+#define AIA_STORAGE_FLASH_NUM_BLOCKS 4
+#endif
+
+/** A power of two no larger than 8. */
+#ifndef AIA_STORAGE_FLASH_PROGRAM_SIZE
+#define AIA_STORAGE_FLASH_PROGRAM_SIZE 4
+#endif
+
+#ifndef AIA_STORAGE_FLASH_FILE
+#define AIA_STORAGE_FLASH_FILE 0
+#endif
+
+/**
+ * Define as the address the device is mapped at, for flash that the CPU can
+ * read directly such as execute-in-place flash, to let blobs be borrowed
+ * without a copy. Left undefined, the device is only read through @c
+ * AiaStorageFlash_Read().
+ */
+#ifdef AIA_STORAGE_FLASH_MAPPED_ADDRESS
+#define AIA_STORAGE_FLASH_MAPPED( offset ) \
+    ( (const uint8_t*)( AIA_STORAGE_FLASH_MAPPED_ADDRESS ) + ( offset ) )
+#endif
+
+/** Name of the image file, under @c g_aiaStorageFolder when that is set. */
+#ifndef AIA_STORAGE_FLASH_FILE_NAME
+#define AIA_STORAGE_FLASH_FILE_NAME "aia_storage_flash.bin"
+#endif
+
+/**
+ * Reads from the device.
+ *
+ * @param offset Offset from the start of the device to read from.
+ * @param[out] data Buffer to read into.
+ * @param size Number of bytes to read.
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaStorageFlash_Read( size_t offset, void* data, size_t size );
+
+/**
+ * Programs previously erased bytes of the device.
+ *
+ * @param offset Offset from the start of the device, a multiple of @c
+ * AIA_STORAGE_FLASH_PROGRAM_SIZE.
+ * @param data The bytes to program.
+ * @param size Number of bytes to program, a multiple of @c
+ * AIA_STORAGE_FLASH_PROGRAM_SIZE.
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaStorageFlash_Program( size_t offset, const void* data, size_t size );
+
+/**
+ * Erases one block of the device.
+ *
+ * @param block Index of the block to erase.
+ * @return @c true on success or @c false otherwise.
+ */
+bool AiaStorageFlash_Erase( size_t block );
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* ifndef AIA_STORAGE_FLASH_H_ */
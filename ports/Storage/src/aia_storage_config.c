@@ -22,10 +22,29 @@
  */
 
 #include <storage/aia_storage_config.h>
+#include <storage/aia_storage_backend.h>
+#include <storage/aia_storage_crc.h>
 
 #include <aia_config.h>
 
+#include AiaMutex( HEADER )
+#include AiaTimer( HEADER )
+#if AIA_STORAGE_WRITE_BEHIND
+#include AiaSemaphore( HEADER )
+#include AiaThread( HEADER )
+#endif
+
+#if AIA_STORAGE_NAMESPACES > 1
+#if AIA_STORAGE_NAMESPACE_PTHREAD
+#include <pthread.h>
+#else
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
+#endif
+
 #include <aiaalertmanager/aia_alert_constants.h>
+#include <aiacore/aia_utils.h>
 #include <aiacore/aia_volume_constants.h>
 
 #include <errno.h>
@@ -35,447 +54,2769 @@ const char* g_aiaClientId;
 const char* g_aiaAwsAccountId;
 const char* g_aiaStorageFolder;
 
-#ifdef AIA_LOAD_VOLUME
+bool AiaStoreSecret( const uint8_t* sharedSecret, size_t size )
+{
+    return AiaStoreBlobById( AIA_STORAGE_BLOB_SHARED_SECRET, sharedSecret,
+                             size );
+}
 
-uint8_t AiaLoadVolume()
+bool AiaLoadSecret( uint8_t* sharedSecret, size_t size )
 {
-    /* TODO: ADSER-1741 Provide an actual reference implementation of persisting
-     * device volume. */
-    return AIA_DEFAULT_VOLUME;
+    return AiaLoadBlobById( AIA_STORAGE_BLOB_SHARED_SECRET, sharedSecret,
+                            size );
 }
 
+#define BLOBSTORAGE_KEY( NAME, KEY, HASH ) KEY,
+
+/** Keys of the blobs, indexed by @c AiaStorageBlobId_t. */
+static const char* const g_aiaStorageBlobKeys[] = { AIA_STORAGE_BLOBS(
+    BLOBSTORAGE_KEY ) };
+
+#undef BLOBSTORAGE_KEY
+
+/* AiaLoadAlerts() hands out alerts in the layout AiaLoadAlert() parses. */
+typedef char blobstorage_alert_v0_size_matches
+    [ AIA_STORAGE_ALERT_V0_SIZE == AIA_SIZE_OF_ALERT_IN_BYTES &&
+              AIA_STORAGE_ALERT_TOKEN_CHARS == AIA_ALERT_TOKEN_CHARS
+          ? 1
+          : -1 ];
+
+/** Offsets of the fields of an alert record. */
+#define AIA_STORAGE_ALERT_RECORD_VERSION_OFFSET 0
+#define AIA_STORAGE_ALERT_RECORD_TYPE_OFFSET 1
+#define AIA_STORAGE_ALERT_RECORD_DURATION_OFFSET 4
+#define AIA_STORAGE_ALERT_RECORD_SCHEDULED_TIME_OFFSET 8
+#define AIA_STORAGE_ALERT_RECORD_TOKEN_OFFSET 16
+#define AIA_STORAGE_ALERT_RECORD_CRC_OFFSET \
+    ( AIA_STORAGE_ALERT_RECORD_TOKEN_OFFSET + AIA_STORAGE_ALERT_TOKEN_CHARS )
+
+/* Alert fields are encoded with fixed widths. */
+typedef char blobstorage_alert_record_layout_matches
+    [ AIA_STORAGE_ALERT_RECORD_CRC_OFFSET + 4 ==
+                  AIA_STORAGE_ALERT_RECORD_SIZE &&
+              sizeof( AiaTimepointSeconds_t ) == 8 &&
+              sizeof( AiaDurationMs_t ) == 4
+          ? 1
+          : -1 ];
+
+/* The bulk alert functions rewrite every slot in a single transaction. */
+typedef char blobstorage_transaction_fits_alert_slots
+    [ AIA_STORAGE_TRANSACTION_MAX_BLOBS >= AIA_STORAGE_ALERT_SLOTS &&
+              AIA_STORAGE_TRANSACTION_SIZE >=
+                  AIA_STORAGE_ALERT_SLOTS * AIA_STORAGE_ALERT_RECORD_SIZE
+          ? 1
+          : -1 ];
+
+#if defined( AIA_ALERTS_MAX_ALERT_SLOTS ) && \
+    AIA_STORAGE_ALERT_SLOTS < AIA_ALERTS_MAX_ALERT_SLOTS
+#error "AIA_STORAGE_ALERT_SLOTS cannot hold AIA_ALERTS_MAX_ALERT_COUNT alerts"
 #endif
 
-#define AIA_SHARED_SECRET_STORAGE_KEY "AiaSharedSecretStorageKey"
-#define AIA_ALL_ALERTS_STORAGE_KEY_V0 "AiaAllAlertsStorageKey"
+/** A blob held in a @c AiaStorageStagingArea_t. */
+typedef struct AiaStorageStagedBlob
+{
+    /** The blob. */
+    AiaStorageBlobId_t id;
+
+    /** Offset of the staged data in the area's @c data. */
+    size_t offset;
 
-bool AiaStoreSecret( const uint8_t* sharedSecret, size_t size )
+    /** Size of the staged data. */
+    size_t size;
+
+    /** Bytes reserved at @c offset. */
+    size_t reserved;
+} AiaStorageStagedBlob_t;
+
+/**
+ * Blobs held in RAM on their way to the backend, in the order they were first
+ * staged. The data of the blobs is packed at the start of @c data.
+ */
+typedef struct AiaStorageStagingArea
+{
+    /** The staged blobs. */
+    AiaStorageStagedBlob_t* blobs;
+
+    /** Capacity of @c blobs. */
+    size_t maxBlobs;
+
+    /** Data of the staged blobs. */
+    uint8_t* data;
+
+    /** Size of @c data. */
+    size_t size;
+
+    /** Number of entries in @c blobs. */
+    size_t count;
+
+    /** Bytes of @c data in use. */
+    size_t used;
+} AiaStorageStagingArea_t;
+
+/**
+ * @param area The area to search.
+ * @param id The blob to look up.
+ * @return The staged copy of @c id, or @c NULL if there is none.
+ */
+static AiaStorageStagedBlob_t* AiaStorage_FindStagedBlob(
+    AiaStorageStagingArea_t* area, AiaStorageBlobId_t id )
 {
-    return AiaStoreBlob( AIA_SHARED_SECRET_STORAGE_KEY, sharedSecret, size );
+    for( size_t i = 0; i < area->count; ++i )
+    {
+        if( area->blobs[ i ].id == id )
+        {
+            return &area->blobs[ i ];
+        }
+    }
+    return NULL;
 }
 
-bool AiaLoadSecret( uint8_t* sharedSecret, size_t size )
+/**
+ * Removes a staged blob and packs the data of the remaining ones.
+ *
+ * @param area The area holding @c staged.
+ * @param staged The blob to remove.
+ */
+static void AiaStorage_RemoveStagedBlob( AiaStorageStagingArea_t* area,
+                                         AiaStorageStagedBlob_t* staged )
+{
+    size_t offset = staged->offset;
+    size_t reserved = staged->reserved;
+    memmove( area->data + offset, area->data + offset + reserved,
+             area->used - offset - reserved );
+    area->used -= reserved;
+
+    for( size_t i = (size_t)( staged - area->blobs ) + 1; i < area->count;
+         ++i )
+    {
+        area->blobs[ i - 1 ] = area->blobs[ i ];
+    }
+    --area->count;
+    for( size_t i = 0; i < area->count; ++i )
+    {
+        if( area->blobs[ i ].offset > offset )
+        {
+            area->blobs[ i ].offset -= reserved;
+        }
+    }
+}
+
+/**
+ * Stages a blob, replacing an earlier staged copy. A copy that outgrows the
+ * bytes reserved for it is moved to the end of the area.
+ *
+ * @param area The area to stage the blob in.
+ * @param id The blob.
+ * @param blob Data of the blob.
+ * @param size Size of @c blob.
+ * @return @c true on success or @c false if the area is full, in which case an
+ * earlier staged copy is left as it was.
+ */
+static bool AiaStorage_StageBlob( AiaStorageStagingArea_t* area,
+                                  AiaStorageBlobId_t id, const uint8_t* blob,
+                                  size_t size )
+{
+    AiaStorageStagedBlob_t* staged = AiaStorage_FindStagedBlob( area, id );
+    if( !staged || staged->reserved < size )
+    {
+        size_t reclaimed = staged ? staged->reserved : 0;
+        if( !staged && area->count == area->maxBlobs )
+        {
+            return false;
+        }
+        if( area->size - area->used + reclaimed < size )
+        {
+            return false;
+        }
+        if( staged )
+        {
+            AiaStorage_RemoveStagedBlob( area, staged );
+        }
+        staged = &area->blobs[ area->count++ ];
+        staged->id = id;
+        staged->offset = area->used;
+        staged->reserved = size;
+        area->used += size;
+    }
+
+    memcpy( area->data + staged->offset, blob, size );
+    staged->size = size;
+    return true;
+}
+
+/**
+ * Copies a staged blob.
+ *
+ * @param area The area holding @c staged.
+ * @param staged The blob to copy.
+ * @param[out] blob Receives the blob, unless it is @c NULL or too small.
+ * @param capacity Size of @c blob.
+ * @param[out] size Receives the size of the blob.
+ */
+static void AiaStorage_CopyStagedBlob( const AiaStorageStagingArea_t* area,
+                                       const AiaStorageStagedBlob_t* staged,
+                                       uint8_t* blob, size_t capacity,
+                                       size_t* size )
+{
+    if( blob && staged->size <= capacity )
+    {
+        memcpy( blob, area->data + staged->offset, staged->size );
+    }
+    *size = staged->size;
+}
+
+#if AIA_STORAGE_NAMESPACES > 1
+
+#if !AIA_STORAGE_NAMESPACE_PTHREAD && \
+    AIA_STORAGE_NAMESPACE_TLS_INDEX >= configNUM_THREAD_LOCAL_STORAGE_POINTERS
+#error "configNUM_THREAD_LOCAL_STORAGE_POINTERS has no room for the namespace"
+#endif
+
+/**
+ * The namespaces and the client identifiers they are claimed by, each stored
+ * without its terminator in a blob after those of all the namespaces. Each
+ * claimed namespace keeps a hash of its identifier; a matching hash is
+ * confirmed against the stored one. The namespace each task selected is held
+ * in task-local storage as one more than its index, so that tasks which
+ * selected none find the first.
+ */
+static struct
+{
+    /** Whether @c mutex and the task-local storage have been set up. */
+    bool created;
+
+    /** Guards the members below. */
+    AiaMutex_t mutex;
+
+#if AIA_STORAGE_NAMESPACE_PTHREAD
+    /** Holds the namespace each thread selected. */
+    pthread_key_t key;
+#endif
+
+    /** Whether the members below reflect the claims in storage. */
+    bool loaded;
+
+    /** Whether each namespace is claimed. */
+    bool claimed[ AIA_STORAGE_NAMESPACES ];
+
+    /** Hash of the client identifier of each claimed namespace. */
+    uint32_t clientIdHash[ AIA_STORAGE_NAMESPACES ];
+} g_aiaStorageNamespaces;
+
+/** @return The namespace the calling task selected. */
+static size_t AiaStorage_GetNamespace()
+{
+    void* selected;
+    if( !g_aiaStorageNamespaces.created )
+    {
+        return 0;
+    }
+#if AIA_STORAGE_NAMESPACE_PTHREAD
+    selected = pthread_getspecific( g_aiaStorageNamespaces.key );
+#else
+    selected = pvTaskGetThreadLocalStoragePointer(
+        NULL, AIA_STORAGE_NAMESPACE_TLS_INDEX );
+#endif
+    return selected ? (size_t)(uintptr_t)selected - 1 : 0;
+}
+
+#else
+
+/** @return The namespace the calling task selected. */
+static size_t AiaStorage_GetNamespace()
 {
-    return AiaLoadBlob( AIA_SHARED_SECRET_STORAGE_KEY, sharedSecret, size );
+    return 0;
 }
 
-/** If using the provided sample storage implementation, this is the memory
- * spaces that the SDK will read/write from/to. 
- * Vendors should store/load blob to/from NVRAM/persistant storage by their platform
+#endif /* AIA_STORAGE_NAMESPACES > 1 */
+
+/**
+ * @param id A blob identifier as handed to backends.
+ * @return The namespace @c id belongs to, or @c AIA_STORAGE_NAMESPACES for
+ * the claims of the namespaces.
  */
+static size_t AiaStorage_GetBlobNamespace( AiaStorageBlobId_t id )
+{
+    size_t ns = (size_t)id / AIA_STORAGE_NUM_BLOBS;
+    return ns < AIA_STORAGE_NAMESPACES ? ns : AIA_STORAGE_NAMESPACES;
+}
+
+/* Every namespace that may be active at once can get a transaction. */
+typedef char blobstorage_concurrent_namespaces_are_valid
+    [ AIA_STORAGE_CONCURRENT_NAMESPACES >= 1 &&
+              AIA_STORAGE_CONCURRENT_NAMESPACES <= AIA_STORAGE_NAMESPACES
+          ? 1
+          : -1 ];
+
+/** A transaction, claimed by one namespace at a time. */
+typedef struct AiaStorageTransaction
+{
+    /** Whether a namespace has the transaction open. */
+    bool claimed;
+
+    /** Storage of @c area. */
+    AiaStorageStagedBlob_t blobs[ AIA_STORAGE_TRANSACTION_MAX_BLOBS ];
+    uint8_t data[ AIA_STORAGE_TRANSACTION_SIZE ];
+
+    /** The staged blobs. */
+    AiaStorageStagingArea_t area;
+} AiaStorageTransaction_t;
 
 /**
- * blob storage key
+ * The transactions the namespaces claim from, under @c g_aiaStorageLock, and
+ * the one each namespace has open. Like the blob storage itself, the open
+ * transaction of a namespace relies on its client serializing calls into this
+ * port.
  */
-typedef enum _blobstorage_key_e
+static struct
 {
-    AIA_BLOB_STORAGE_KEY_START = 0,
-    AIA_BLOB_SHARED_SECRET_STORAGE_KEY = AIA_BLOB_STORAGE_KEY_START,
-    AIA_BLOB_ALL_ALERTS_STORAGE_KEY_V0,
-    AIA_BLOB_TOPIC_ROOT_KEY,
-    AIA_BLOB_STORAGE_KEY_MAX,
-} blobstorage_key_e;
+    /** The shared transactions. */
+    AiaStorageTransaction_t pool[ AIA_STORAGE_CONCURRENT_NAMESPACES ];
 
-#define BLOBSTORAGE_SHAREDKEY_SIZE 32
-#define BLOBSTORAGE_ALERTKEY_SIZE 64
-#define BLOBSTORAGE_TOPICROOT_SIZE 16
+    /** The transaction each namespace has open, or @c NULL. */
+    AiaStorageTransaction_t* open[ AIA_STORAGE_NAMESPACES ];
+} g_aiaStorageTransactions;
 
-typedef struct _blobstorage_t {
-    const char* key;
-    void* const storage;
-    const size_t capacity;
-    size_t used_len;
-} blobstorage_t;
+/**
+ * @param ns A namespace, or @c AIA_STORAGE_NAMESPACES.
+ * @return The open transaction of @c ns, or @c NULL if there is none.
+ */
+static AiaStorageTransaction_t* AiaStorage_GetOpenTransaction( size_t ns )
+{
+    return ns < AIA_STORAGE_NAMESPACES ? g_aiaStorageTransactions.open[ ns ]
+                                       : NULL;
+}
 
-uint8_t blobstorage_sharedkey[ BLOBSTORAGE_SHAREDKEY_SIZE ];
-uint8_t blobstorage_alertkey[ BLOBSTORAGE_ALERTKEY_SIZE ];
-uint8_t blobstorage_topicroot[ BLOBSTORAGE_TOPICROOT_SIZE ];
-blobstorage_t blobstorage[] = {
-    { AIA_SHARED_SECRET_STORAGE_KEY, blobstorage_sharedkey, sizeof(blobstorage_sharedkey), 0 }, // AIA_BLOB_SHARED_SECRET_STORAGE_KEY
-    { AIA_ALL_ALERTS_STORAGE_KEY_V0, blobstorage_alertkey, sizeof(blobstorage_alertkey), 1 },   // AIA_BLOB_ALL_ALERTS_STORAGE_KEY_V0
-    { "AiaTopicRootKey", blobstorage_topicroot, sizeof(blobstorage_topicroot), 0 },             // AIA_BLOB_TOPIC_ROOT_KEY
-};
+/**
+ * @param id A blob identifier as handed to backends.
+ * @return The copy of @c id staged in the open transaction of its namespace,
+ * or @c NULL if there is none.
+ */
+static AiaStorageStagedBlob_t* AiaStorage_FindTransactionBlob(
+    AiaStorageBlobId_t id )
+{
+    AiaStorageTransaction_t* transaction =
+        AiaStorage_GetOpenTransaction( AiaStorage_GetBlobNamespace( id ) );
+    return transaction ? AiaStorage_FindStagedBlob( &transaction->area, id )
+                       : NULL;
+}
 
-bool AiaStoreBlob( const char* key, const uint8_t* blob, size_t size )
+#define BLOBSTORAGE_BOUNCE_MEMBER( NAME, KEY, HASH ) \
+    uint8_t NAME[ AIA_STORAGE_##NAME##_CAPACITY ];
+
+/** Large enough for any blob. */
+typedef union AiaStorageBounceBuffer
+{
+    AIA_STORAGE_BLOBS( BLOBSTORAGE_BOUNCE_MEMBER )
+    uint8_t alert[ AIA_STORAGE_ALERT_RECORD_SIZE ];
+#if AIA_STORAGE_NAMESPACES > 1
+    uint8_t clientId[ AIA_STORAGE_CLIENT_ID_CAPACITY ];
+#endif
+} AiaStorageBounceBuffer_t;
+
+#undef BLOBSTORAGE_BOUNCE_MEMBER
+
+/**
+ * Views handed out by @c AiaStorage_BorrowBlobById(), which are counted under
+ * @c g_aiaStorageLock so that the flush task can hold off its writes.
+ */
+static struct
+{
+    /** Number of views not yet released that point into the backend. */
+    size_t lent;
+
+    /** Number of views of each namespace not yet released. */
+    size_t outstanding[ AIA_STORAGE_NAMESPACES ];
+
+    /** Whether a view holds each of the @c bounce buffers. */
+    bool bounceInUse[ AIA_STORAGE_CONCURRENT_NAMESPACES ];
+
+    /** Copies of blobs that are not lent in place, shared by the namespaces. */
+    AiaStorageBounceBuffer_t bounce[ AIA_STORAGE_CONCURRENT_NAMESPACES ];
+} g_aiaStorageViews;
+
+/**
+ * Serializes access to the backend and to @c g_aiaStorageViews between the
+ * clients, the write-behind flush task and the timer that queues the
+ * volumes @c AiaStoreVolume() defers. Until the flush task is started or a
+ * namespace is selected, the SDK serializing calls into this port is enough
+ * and the lock is not taken.
+ */
+static struct
+{
+    /** Whether @c mutex has been created. */
+    bool created;
+
+    /** The lock. */
+    AiaMutex_t mutex;
+} g_aiaStorageLock;
+
+static void AiaStorage_Lock()
+{
+    if( g_aiaStorageLock.created )
+    {
+        AiaMutex( Lock )( &g_aiaStorageLock.mutex );
+    }
+}
+
+static void AiaStorage_Unlock()
 {
-    bool process = false;
-    blobstorage_key_e k = AIA_BLOB_STORAGE_KEY_MAX;
+    if( g_aiaStorageLock.created )
+    {
+        AiaMutex( Unlock )( &g_aiaStorageLock.mutex );
+    }
+}
 
-    for( k = AIA_BLOB_STORAGE_KEY_START; blob && k < AIA_BLOB_STORAGE_KEY_MAX; ++k )
+#if AIA_STORAGE_WRITE_BEHIND || AIA_STORAGE_NAMESPACES > 1
+/**
+ * Creates @c g_aiaStorageLock, if it does not exist yet.
+ *
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorage_CreateLock()
+{
+    if( !g_aiaStorageLock.created )
     {
-        if( strncmp(key, blobstorage[ k ].key, strlen(key)) == 0 )
+        if( !AiaMutex( Create )( &g_aiaStorageLock.mutex, false ) )
         {
-            if( blobstorage[ k ].capacity >= size )
-            {
-                memcpy( blobstorage[ k ].storage, blob, size );
-                blobstorage[ k ].used_len = size;
-                process = true;
-            }
-            else
-            {
-                AiaLogError( "blob Store size error: key(%s), capacity(%u), size(%u)", key, blobstorage[k].capacity, size );
-            }
+            AiaLogError( "AiaMutex( Create ) failed" );
+            return false;
+        }
+        g_aiaStorageLock.created = true;
+    }
+    return true;
+}
+#endif
 
-            break;
+/**
+ * @param id A blob identifier as handed to backends.
+ * @return A name for @c id to use in logs.
+ */
+static const char* AiaStorage_GetBlobName( AiaStorageBlobId_t id )
+{
+    size_t local = (size_t)id % AIA_STORAGE_NUM_BLOBS;
+    if( (size_t)id >= AIA_STORAGE_NAMESPACES * AIA_STORAGE_NUM_BLOBS )
+    {
+        return "client id";
+    }
+    return local < AIA_STORAGE_BLOB_ALERT_SLOT_0 ? g_aiaStorageBlobKeys[ local ]
+                                                 : "alert slot";
+}
+
+/**
+ * @param ns A namespace.
+ * @param id A blob identifier below @c AIA_STORAGE_NUM_BLOBS.
+ * @return The identifier of @c id in @c ns, as handed to backends.
+ */
+static AiaStorageBlobId_t AiaStorage_GetNamespaceBlobId( size_t ns,
+                                                         AiaStorageBlobId_t id )
+{
+    return (AiaStorageBlobId_t)( ns * AIA_STORAGE_NUM_BLOBS + (size_t)id );
+}
+
+/**
+ * @param id A blob identifier below @c AIA_STORAGE_NUM_BLOBS.
+ * @return The identifier of @c id in the namespace the calling task selected.
+ */
+static AiaStorageBlobId_t AiaStorage_InNamespace( AiaStorageBlobId_t id )
+{
+    return AiaStorage_GetNamespaceBlobId( AiaStorage_GetNamespace(), id );
+}
+
+#if AIA_STORAGE_WRITE_BEHIND
+
+/* Any blob must fit in the queue on its own. */
+typedef char blobstorage_write_behind_fits_blobs
+    [ sizeof( AiaStorageBounceBuffer_t ) <= AIA_STORAGE_WRITE_BEHIND_SIZE &&
+              AIA_STORAGE_WRITE_BEHIND_MAX_BLOBS > 0
+          ? 1
+          : -1 ];
+
+/**
+ * Blobs stored but not yet written to the backend, and the task that writes
+ * them. The queue has its own lock, which is only held to copy blobs in and
+ * out; @c g_aiaStorageLock is never taken while it is held.
+ */
+static struct
+{
+    /** Whether the flush task runs. */
+    bool started;
+
+    /** Whether the flush task could not be started. */
+    bool startFailed;
+
+    /** Guards the members below. */
+    AiaMutex_t mutex;
+
+    /** Posted to have the flush task look at the queue. */
+    AiaSemaphore_t wake;
+
+    /**
+     * Posted by the flush task after each write it attempts. Tasks of several
+     * clients may wait for it, so each posts it again once it stops waiting.
+     */
+    AiaSemaphore_t progress;
+
+    /** Whether the flush task is writing @c flushingId. */
+    bool flushing;
+
+    /** The blob being written. */
+    AiaStorageBlobId_t flushingId;
+
+    /** Whether @c flushingId was stored again while being written. */
+    bool rewritten;
+
+    /** Number of writes that failed. */
+    size_t failures;
+
+    /** Storage of @c area. */
+    AiaStorageStagedBlob_t blobs[ AIA_STORAGE_WRITE_BEHIND_MAX_BLOBS ];
+    uint8_t data[ AIA_STORAGE_WRITE_BEHIND_SIZE ];
+
+    /** The queued blobs, oldest first. */
+    AiaStorageStagingArea_t area;
+} g_aiaStorageQueue = {
+    .area = { g_aiaStorageQueue.blobs, AIA_STORAGE_WRITE_BEHIND_MAX_BLOBS,
+              g_aiaStorageQueue.data, AIA_STORAGE_WRITE_BEHIND_SIZE, 0, 0 }
+};
+
+/**
+ * Writes the oldest queued blobs to the backend until the queue is empty or a
+ * write cannot be made. Writes wait while views are borrowed, since they may
+ * move the viewed bytes.
+ *
+ * @return @c true if blobs are left in the queue or @c false otherwise.
+ */
+static bool AiaStorage_FlushQueue()
+{
+    static AiaStorageBounceBuffer_t buffer;
+    for( ;; )
+    {
+        AiaMutex( Lock )( &g_aiaStorageQueue.mutex );
+        if( !g_aiaStorageQueue.area.count )
+        {
+            AiaMutex( Unlock )( &g_aiaStorageQueue.mutex );
+            return false;
+        }
+        const AiaStorageStagedBlob_t* oldest =
+            &g_aiaStorageQueue.area.blobs[ 0 ];
+        AiaStorageBlobId_t id = oldest->id;
+        size_t size;
+        AiaStorage_CopyStagedBlob( &g_aiaStorageQueue.area, oldest,
+                                   (uint8_t*)&buffer, sizeof( buffer ), &size );
+        g_aiaStorageQueue.flushing = true;
+        g_aiaStorageQueue.flushingId = id;
+        g_aiaStorageQueue.rewritten = false;
+        AiaMutex( Unlock )( &g_aiaStorageQueue.mutex );
+
+        AiaStorage_Lock();
+        bool deferred = g_aiaStorageViews.lent != 0;
+        bool written = !deferred && AiaStorageBackend( StoreBlob )(
+                                        id, (const uint8_t*)&buffer, size );
+        AiaStorage_Unlock();
+
+        AiaMutex( Lock )( &g_aiaStorageQueue.mutex );
+        g_aiaStorageQueue.flushing = false;
+        if( written && !g_aiaStorageQueue.rewritten )
+        {
+            AiaStorage_RemoveStagedBlob(
+                &g_aiaStorageQueue.area,
+                AiaStorage_FindStagedBlob( &g_aiaStorageQueue.area, id ) );
+        }
+        else if( !written && !deferred )
+        {
+            ++g_aiaStorageQueue.failures;
+            AiaLogError( "Failed to flush blob: key(%s), size(%zu)",
+                         AiaStorage_GetBlobName( id ), size );
+        }
+        AiaMutex( Unlock )( &g_aiaStorageQueue.mutex );
+        AiaSemaphore( Post )( &g_aiaStorageQueue.progress );
+
+        if( !written )
+        {
+            return true;
+        }
+    }
+}
+
+/**
+ * Lets the backend reclaim superseded records, unless views are borrowed.
+ */
+static void AiaStorage_CompactBackend()
+{
+    AiaStorage_Lock();
+    if( !g_aiaStorageViews.lent && AiaStorageBackend( Compact )() )
+    {
+        AiaLogDebug( "Storage compacted" );
+    }
+    AiaStorage_Unlock();
+}
+
+/**
+ * Writes queued blobs whenever woken, and retries blobs it could not write
+ * every @c AIA_STORAGE_FLUSH_RETRY_MS. Once the queue drains, the backend is
+ * compacted so that later stores do not have to.
+ *
+ * @param context Unused.
+ */
+static void AiaStorage_FlushTask( void* context )
+{
+    (void)context;
+    for( ;; )
+    {
+        if( AiaStorage_FlushQueue() )
+        {
+            AiaSemaphore( TimedWait )( &g_aiaStorageQueue.wake,
+                                       AIA_STORAGE_FLUSH_RETRY_MS );
+        }
+        else
+        {
+            AiaStorage_CompactBackend();
+            AiaSemaphore( Wait )( &g_aiaStorageQueue.wake );
         }
     }
+}
+
+/**
+ * Creates the queue's lock and semaphores and the flush task.
+ *
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorage_CreateFlushTask()
+{
+    if( !AiaMutex( Create )( &g_aiaStorageQueue.mutex, false ) )
+    {
+        AiaLogError( "AiaMutex( Create ) failed" );
+        return false;
+    }
+    if( !AiaSemaphore( Create )( &g_aiaStorageQueue.wake, 0, 1 ) )
+    {
+        AiaLogError( "AiaSemaphore( Create ) failed" );
+        AiaMutex( Destroy )( &g_aiaStorageQueue.mutex );
+        return false;
+    }
+    if( !AiaSemaphore( Create )( &g_aiaStorageQueue.progress, 0, 1 ) )
+    {
+        AiaLogError( "AiaSemaphore( Create ) failed" );
+        AiaSemaphore( Destroy )( &g_aiaStorageQueue.wake );
+        AiaMutex( Destroy )( &g_aiaStorageQueue.mutex );
+        return false;
+    }
+    if( !AiaThread( CreateDetached )( AiaStorage_FlushTask, NULL,
+                                      AIA_STORAGE_FLUSH_TASK_PRIORITY,
+                                      AIA_STORAGE_FLUSH_TASK_STACK_SIZE ) )
+    {
+        AiaLogError( "AiaThread( CreateDetached ) failed" );
+        AiaSemaphore( Destroy )( &g_aiaStorageQueue.progress );
+        AiaSemaphore( Destroy )( &g_aiaStorageQueue.wake );
+        AiaMutex( Destroy )( &g_aiaStorageQueue.mutex );
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Starts the flush task, unless an earlier attempt failed. The first attempt
+ * is made by the SDK, before the volume timer can make one.
+ *
+ * @return @c true if the flush task runs or @c false otherwise.
+ */
+static bool AiaStorage_StartFlushTask()
+{
+    if( g_aiaStorageQueue.started )
+    {
+        return true;
+    }
+    if( g_aiaStorageQueue.startFailed )
+    {
+        return false;
+    }
+    if( !AiaStorage_CreateLock() || !AiaStorage_CreateFlushTask() )
+    {
+        AiaLogWarn( "Writing blobs through without the flush task" );
+        g_aiaStorageQueue.startFailed = true;
+        return false;
+    }
+    g_aiaStorageQueue.started = true;
+    return true;
+}
+
+/**
+ * Queues a blob for the flush task.
+ *
+ * @param wait Whether to wait for room if the queue is full.
+ * @return @c true on success or @c false if the queue stayed full.
+ */
+static bool AiaStorage_QueueBlob( AiaStorageBlobId_t id, const uint8_t* blob,
+                                  size_t size, bool wait )
+{
+    size_t failures = 0;
+    for( bool first = true;; first = false )
+    {
+        AiaMutex( Lock )( &g_aiaStorageQueue.mutex );
+        if( first )
+        {
+            failures = g_aiaStorageQueue.failures;
+        }
+        bool queued =
+            AiaStorage_StageBlob( &g_aiaStorageQueue.area, id, blob, size );
+        if( queued && g_aiaStorageQueue.flushing &&
+            g_aiaStorageQueue.flushingId == id )
+        {
+            g_aiaStorageQueue.rewritten = true;
+        }
+        bool failing = g_aiaStorageQueue.failures != failures;
+        AiaMutex( Unlock )( &g_aiaStorageQueue.mutex );
+
+        AiaSemaphore( Post )( &g_aiaStorageQueue.wake );
+        if( queued )
+        {
+            if( !first )
+            {
+                AiaSemaphore( Post )( &g_aiaStorageQueue.progress );
+            }
+            return true;
+        }
+        if( !wait )
+        {
+            return false;
+        }
+        if( failing && !first )
+        {
+            AiaSemaphore( Post )( &g_aiaStorageQueue.progress );
+        }
+        if( failing || !AiaSemaphore( TimedWait )(
+                           &g_aiaStorageQueue.progress,
+                           AIA_STORAGE_WRITE_BEHIND_TIMEOUT_MS ) )
+        {
+            AiaLogError( "Write-behind queue full: key(%s), size(%zu)",
+                         AiaStorage_GetBlobName( id ), size );
+            return false;
+        }
+    }
+}
+
+#endif /* AIA_STORAGE_WRITE_BEHIND */
+
+/**
+ * Writes a blob to the backend: through the write-behind queue once the flush
+ * task runs, and directly otherwise.
+ *
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorage_WriteBlob( AiaStorageBlobId_t id, const uint8_t* blob,
+                                  size_t size )
+{
+#if AIA_STORAGE_WRITE_BEHIND
+    if( AiaStorage_StartFlushTask() )
+    {
+        return AiaStorage_QueueBlob( id, blob, size, true );
+    }
+#endif
+
+    bool stored = false;
+    AiaStorage_Lock();
+    if( g_aiaStorageViews.lent )
+    {
+        AiaLogError( "Cannot store while blob views are borrowed, views=%zu",
+                     g_aiaStorageViews.lent );
+    }
+    else
+    {
+        stored = AiaStorageBackend( StoreBlob )( id, blob, size );
+    }
+    AiaStorage_Unlock();
+    return stored;
+}
+
+/**
+ * Hands a blob to the flush task without waiting, for tasks that must not
+ * block on the media or on room in the queue, like the timer service task
+ * that every timer shares.
+ *
+ * @return @c true if the blob was queued, or @c false if no flush task runs
+ * or the queue is full.
+ */
+static bool AiaStorage_PostBlob( AiaStorageBlobId_t id, const uint8_t* blob,
+                                 size_t size )
+{
+#if AIA_STORAGE_WRITE_BEHIND
+    return g_aiaStorageQueue.started &&
+           AiaStorage_QueueBlob( id, blob, size, false );
+#else
+    (void)id;
+    (void)blob;
+    (void)size;
+    return false;
+#endif
+}
+
+/**
+ * Looks a blob up among the writes that have not reached the backend yet:
+ * those staged in the open transaction, then those queued for the flush task.
+ *
+ * @param id The blob to look up.
+ * @param[out] blob Receives the blob, unless it is @c NULL or too small.
+ * @param capacity Size of @c blob.
+ * @param[out] size Receives the size of the blob.
+ * @return @c true if @c id has such a write, or @c false if the backend holds
+ * the blob.
+ */
+static bool AiaStorage_LoadPendingBlob( AiaStorageBlobId_t id, uint8_t* blob,
+                                        size_t capacity, size_t* size )
+{
+    const AiaStorageTransaction_t* transaction =
+        AiaStorage_GetOpenTransaction( AiaStorage_GetBlobNamespace( id ) );
+    const AiaStorageStagedBlob_t* staged = AiaStorage_FindTransactionBlob( id );
+    if( staged )
+    {
+        AiaStorage_CopyStagedBlob( &transaction->area, staged, blob, capacity,
+                                   size );
+        return true;
+    }
+
+#if AIA_STORAGE_WRITE_BEHIND
+    if( g_aiaStorageQueue.started )
+    {
+        AiaMutex( Lock )( &g_aiaStorageQueue.mutex );
+        staged = AiaStorage_FindStagedBlob( &g_aiaStorageQueue.area, id );
+        if( staged )
+        {
+            AiaStorage_CopyStagedBlob( &g_aiaStorageQueue.area, staged, blob,
+                                       capacity, size );
+        }
+        AiaMutex( Unlock )( &g_aiaStorageQueue.mutex );
+        return staged != NULL;
+    }
+#endif
+    return false;
+}
+
+AiaStorageBlobId_t AiaStorage_GetBlobId( const char* key )
+{
+    AiaStorageBlobId_t id;
+    uint32_t hash = 2166136261u;
+    const char* c;
+    if( !key )
+    {
+        return AIA_STORAGE_NUM_BLOBS;
+    }
+
+    /* 32-bit FNV-1a, matching the hashes in AIA_STORAGE_BLOBS. */
+    for( c = key; *c; ++c )
+    {
+        hash = ( hash ^ (uint8_t)*c ) * 16777619u;
+    }
+    switch( hash )
+    {
+#define BLOBSTORAGE_KEY_CASE( NAME, KEY, HASH ) \
+    case HASH:                                  \
+        id = AIA_STORAGE_BLOB_##NAME;           \
+        break;
+        AIA_STORAGE_BLOBS( BLOBSTORAGE_KEY_CASE )
+#undef BLOBSTORAGE_KEY_CASE
+        default:
+            return AIA_STORAGE_NUM_BLOBS;
+    }
+
+    return strcmp( key, g_aiaStorageBlobKeys[ id ] ) == 0
+               ? id
+               : AIA_STORAGE_NUM_BLOBS;
+}
+
+bool AiaStoreBlobById( AiaStorageBlobId_t id, const uint8_t* blob,
+                       size_t size )
+{
+    if( id >= AIA_STORAGE_NUM_BLOBS || !blob )
+    {
+        AiaLogError( "Invalid input: blob(%p) id(%d)", (const void*)blob, id );
+        return false;
+    }
+    if( AiaStorage_GetBlobCapacity( id ) < size )
+    {
+        AiaLogError( "blob Store size error: key(%s), capacity(%zu), size(%zu)",
+                     AiaStorage_GetBlobName( id ),
+                     AiaStorage_GetBlobCapacity( id ), size );
+        return false;
+    }
+    size_t ns = AiaStorage_GetNamespace();
+    id = AiaStorage_GetNamespaceBlobId( ns, id );
+
+    AiaStorage_Lock();
+    size_t views = g_aiaStorageViews.outstanding[ ns ];
+    AiaStorage_Unlock();
+    if( views )
+    {
+        AiaLogError( "Cannot store while blob views are borrowed, views=%zu",
+                     views );
+        return false;
+    }
+    AiaStorageTransaction_t* transaction = AiaStorage_GetOpenTransaction( ns );
+    if( transaction )
+    {
+        if( !AiaStorage_StageBlob( &transaction->area, id, blob, size ) )
+        {
+            AiaLogError( "Transaction full: key(%s), size(%zu)",
+                         AiaStorage_GetBlobName( id ), size );
+            return false;
+        }
+        return true;
+    }
+    return AiaStorage_WriteBlob( id, blob, size );
+}
+
+/**
+ * Why the last load of each namespace failed, for @c
+ * AiaStorage_GetLastError().
+ */
+static AiaStorageError_t g_aiaStorageLastError[ AIA_STORAGE_NAMESPACES ];
+
+AiaStorageError_t AiaStorage_GetLastError()
+{
+    return g_aiaStorageLastError[ AiaStorage_GetNamespace() ];
+}
+
+/**
+ * Loads a blob, whether it has reached the backend or not.
+ *
+ * @param id A blob identifier as handed to backends.
+ * @param[out] blob Receives the blob.
+ * @param size Size of @c blob.
+ * @param[out] used Receives the size of the blob.
+ * @return Why the load failed, if it did.
+ */
+static AiaStorageError_t AiaStorage_LoadBlob( AiaStorageBlobId_t id,
+                                              uint8_t* blob, size_t size,
+                                              size_t* used )
+{
+    AiaStorageError_t error = AIA_STORAGE_ERROR_FAILED;
+    if( AiaStorage_LoadPendingBlob( id, blob, size, used ) )
+    {
+        if( *used <= size )
+        {
+            error = AIA_STORAGE_ERROR_NONE;
+        }
+    }
+    else
+    {
+        AiaStorage_Lock();
+        *used = AiaStorageBackend( GetBlobSize )( id );
+        if( *used <= size )
+        {
+            error = AiaStorageBackend( LoadBlob )( id, blob, *used );
+        }
+        AiaStorage_Unlock();
+    }
+    if( *used > size )
+    {
+        AiaLogError( "blob load size error: key(%s), used(%zu), size(%zu)",
+                     AiaStorage_GetBlobName( id ), *used, size );
+    }
+    return error;
+}
+
+bool AiaLoadBlobById( AiaStorageBlobId_t id, uint8_t* const blob,
+                      size_t size )
+{
+    size_t used;
+    AiaStorageError_t* lastError =
+        &g_aiaStorageLastError[ AiaStorage_GetNamespace() ];
+    if( id >= AIA_STORAGE_NUM_BLOBS || !blob )
+    {
+        AiaLogError( "Invalid input: blob(%p) id(%d)", (void*)blob, id );
+        *lastError = AIA_STORAGE_ERROR_FAILED;
+        return false;
+    }
+
+    *lastError =
+        AiaStorage_LoadBlob( AiaStorage_InNamespace( id ), blob, size, &used );
+    return *lastError == AIA_STORAGE_ERROR_NONE;
+}
+
+bool AiaBlobExistsById( AiaStorageBlobId_t id )
+{
+    size_t size;
+    if( id >= AIA_STORAGE_NUM_BLOBS )
+    {
+        return false;
+    }
+    id = AiaStorage_InNamespace( id );
+    if( AiaStorage_LoadPendingBlob( id, NULL, 0, &size ) )
+    {
+        return size > 0;
+    }
+    AiaStorage_Lock();
+    bool exists = AiaStorageBackend( BlobExists )( id );
+    AiaStorage_Unlock();
+    return exists;
+}
+
+bool AiaDeleteBlobById( AiaStorageBlobId_t id )
+{
+    static const uint8_t empty[ 1 ];
+    return AiaStoreBlobById( id, empty, 0 );
+}
+
+/**
+ * Copies a blob that is not lent in place into a free buffer of @c
+ * g_aiaStorageViews.bounce. Called with @c g_aiaStorageLock held.
+ *
+ * @param id The blob to copy.
+ * @param[out] size Receives the size of the blob.
+ * @param[out] error Receives why the copy failed.
+ * @return The copy, or @c NULL on failure.
+ */
+static const uint8_t* AiaStorage_LoadBounce( AiaStorageBlobId_t id,
+                                             size_t* size,
+                                             AiaStorageError_t* error )
+{
+    size_t buffer = 0;
+    while( buffer < AIA_STORAGE_CONCURRENT_NAMESPACES &&
+           g_aiaStorageViews.bounceInUse[ buffer ] )
+    {
+        ++buffer;
+    }
+    if( buffer == AIA_STORAGE_CONCURRENT_NAMESPACES )
+    {
+        AiaLogError( "blob view buffer in use: key(%s)",
+                     AiaStorage_GetBlobName( id ) );
+        *error = AIA_STORAGE_ERROR_FAILED;
+        return NULL;
+    }
+
+    uint8_t* bounce = (uint8_t*)&g_aiaStorageViews.bounce[ buffer ];
+    *error = AIA_STORAGE_ERROR_NONE;
+    if( !AiaStorage_LoadPendingBlob(
+            id, bounce, sizeof( AiaStorageBounceBuffer_t ), size ) )
+    {
+        *size = AiaStorageBackend( GetBlobSize )( id );
+        *error = AiaStorageBackend( LoadBlob )( id, bounce, *size );
+    }
+    if( *error != AIA_STORAGE_ERROR_NONE )
+    {
+        AiaLogError( "blob view load failed: key(%s)",
+                     AiaStorage_GetBlobName( id ) );
+        return NULL;
+    }
+    g_aiaStorageViews.bounceInUse[ buffer ] = true;
+    return bounce;
+}
+
+bool AiaStorage_BorrowBlobById( AiaStorageBlobId_t id,
+                                AiaStorageBlobView_t* view )
+{
+    const uint8_t* data = NULL;
+    AiaStorageError_t error = AIA_STORAGE_ERROR_NONE;
+    size_t ns = AiaStorage_GetNamespace();
+    bool lent = false;
+    size_t size;
+    if( id >= AIA_STORAGE_NUM_BLOBS || !view )
+    {
+        AiaLogError( "Invalid input: view(%p) id(%d)", (void*)view, id );
+        g_aiaStorageLastError[ ns ] = AIA_STORAGE_ERROR_FAILED;
+        return false;
+    }
+    view->data = NULL;
+    view->size = 0;
+    id = AiaStorage_GetNamespaceBlobId( ns, id );
+
+    AiaStorage_Lock();
+    AiaStorageStagedBlob_t* staged = AiaStorage_FindTransactionBlob( id );
+    if( staged )
+    {
+        data = AiaStorage_GetOpenTransaction( ns )->data + staged->offset;
+        size = staged->size;
+    }
+    else if( AiaStorage_LoadPendingBlob( id, NULL, 0, &size ) )
+    {
+        /* Queued blobs move as the queue drains. */
+        data = AiaStorage_LoadBounce( id, &size, &error );
+    }
+    else
+    {
+        /* A lent view would hold off the writes of every namespace. */
+        size = AiaStorageBackend( GetBlobSize )( id );
+        lent = AIA_STORAGE_NAMESPACES == 1 &&
+               AiaStorageBackend( BorrowBlob )( id, &data );
+        if( !lent )
+        {
+            data = AiaStorage_LoadBounce( id, &size, &error );
+        }
+    }
+
+    if( data )
+    {
+        view->data = data;
+        view->size = size;
+        view->ns = ns;
+        view->lent = lent;
+        ++g_aiaStorageViews.outstanding[ ns ];
+        g_aiaStorageViews.lent += lent ? 1 : 0;
+    }
+    g_aiaStorageLastError[ ns ] = error;
+    AiaStorage_Unlock();
+    return data != NULL;
+}
+
+void AiaStorage_ReleaseBlob( AiaStorageBlobView_t* view )
+{
+    if( !view || !view->data )
+    {
+        return;
+    }
+    AiaStorage_Lock();
+    for( size_t buffer = 0; buffer < AIA_STORAGE_CONCURRENT_NAMESPACES;
+         ++buffer )
+    {
+        if( view->data == (const uint8_t*)&g_aiaStorageViews.bounce[ buffer ] )
+        {
+            g_aiaStorageViews.bounceInUse[ buffer ] = false;
+        }
+    }
+    --g_aiaStorageViews.outstanding[ view->ns ];
+    bool released = view->lent && --g_aiaStorageViews.lent == 0;
+    AiaStorage_Unlock();
+    view->data = NULL;
+    view->size = 0;
+
+#if AIA_STORAGE_WRITE_BEHIND
+    if( released && g_aiaStorageQueue.started )
+    {
+        /* The flush task holds off its writes while views are lent. */
+        AiaSemaphore( Post )( &g_aiaStorageQueue.wake );
+    }
+#else
+    (void)released;
+#endif
+}
+
+size_t AiaGetBlobSizeById( AiaStorageBlobId_t id )
+{
+    size_t size;
+    if( id >= AIA_STORAGE_NUM_BLOBS )
+    {
+        AiaLogError( "blob id error: %d", id );
+        return 0;
+    }
+    id = AiaStorage_InNamespace( id );
+    if( AiaStorage_LoadPendingBlob( id, NULL, 0, &size ) )
+    {
+        return size;
+    }
+    AiaStorage_Lock();
+    size = AiaStorageBackend( GetBlobSize )( id );
+    AiaStorage_Unlock();
+    return size;
+}
+
+bool AiaStoreBlob( const char* key, const uint8_t* blob, size_t size )
+{
+    AiaStorageBlobId_t id = AiaStorage_GetBlobId( key );
+    if( id >= AIA_STORAGE_NUM_BLOBS )
+    {
+        AiaLogError( "blob key error: %s", key ? key : "(null)" );
+        return false;
+    }
+    return AiaStoreBlobById( id, blob, size );
+}
+
+bool AiaLoadBlob( const char* key, uint8_t* const blob, size_t size )
+{
+    AiaStorageBlobId_t id = AiaStorage_GetBlobId( key );
+    if( id >= AIA_STORAGE_NUM_BLOBS )
+    {
+        AiaLogError( "blob key error: %s", key ? key : "(null)" );
+        return false;
+    }
+    return AiaLoadBlobById( id, blob, size );
+}
+
+bool AiaBlobExists( const char* key )
+{
+    return AiaBlobExistsById( AiaStorage_GetBlobId( key ) );
+}
+
+size_t AiaGetBlobSize( const char* key )
+{
+    AiaStorageBlobId_t id = AiaStorage_GetBlobId( key );
+    if( id >= AIA_STORAGE_NUM_BLOBS )
+    {
+        AiaLogError( "blob key error: %s", key ? key : "(null)" );
+        return 0;
+    }
+    return AiaGetBlobSizeById( id );
+}
+
+/** The volume of one namespace. */
+typedef struct AiaStorageVolume
+{
+    /** Whether @c volume has been read from storage. */
+    bool loaded;
+
+    /** The current volume. */
+    uint8_t volume;
+
+    /** Whether @c persisted holds the volume in storage. */
+    bool hasPersisted;
+
+    /** The volume in storage. */
+    uint8_t persisted;
+} AiaStorageVolume_t;
+
+/**
+ * The volumes served by @c AiaLoadVolume(). The timer that queues them for the
+ * flush task only exists once the flush task runs, so never writes to the
+ * media itself, and reads @c volume and @c persisted under @c
+ * g_aiaStorageLock.
+ */
+static struct
+{
+    /** The volume of each namespace. */
+    AiaStorageVolume_t namespaces[ AIA_STORAGE_NAMESPACES ];
+
+    /** Whether @c timer has been created. */
+    bool timerCreated;
+
+    /** Writes the volumes once they have settled. */
+    AiaTimer_t timer;
+} g_aiaStorageVolume;
+
+uint8_t AiaLoadVolume()
+{
+    AiaStorageVolume_t* current =
+        &g_aiaStorageVolume.namespaces[ AiaStorage_GetNamespace() ];
+    uint8_t volume;
+    if( current->loaded )
+    {
+        return current->volume;
+    }
+
+    current->volume = AIA_DEFAULT_VOLUME;
+    if( AiaGetBlobSizeById( AIA_STORAGE_BLOB_VOLUME ) == sizeof( volume ) &&
+        AiaLoadBlobById( AIA_STORAGE_BLOB_VOLUME, &volume,
+                         sizeof( volume ) ) &&
+        volume <= AIA_MAX_VOLUME )
+    {
+        current->volume = volume;
+        current->persisted = volume;
+        current->hasPersisted = true;
+    }
+    current->loaded = true;
+    return current->volume;
+}
+
+/**
+ * Writes the volumes that differ from the ones in storage, which is retried
+ * on @c g_aiaStorageVolume.timer if it fails.
+ *
+ * @param wait Whether to wait for the write like @c AiaStorage_WriteBlob(),
+ * or only hand it to the flush task like @c AiaStorage_PostBlob().
+ */
+static void AiaStorage_FlushVolume( bool wait )
+{
+    bool failed = false;
+
+    for( size_t ns = 0; ns < AIA_STORAGE_NAMESPACES; ++ns )
+    {
+        AiaStorageVolume_t* state = &g_aiaStorageVolume.namespaces[ ns ];
+        AiaStorage_Lock();
+        uint8_t volume = state->volume;
+        bool changed = state->loaded &&
+                       ( !state->hasPersisted || state->persisted != volume );
+        AiaStorage_Unlock();
+        if( !changed )
+        {
+            continue;
+        }
+
+        AiaStorageBlobId_t id =
+            AiaStorage_GetNamespaceBlobId( ns, AIA_STORAGE_BLOB_VOLUME );
+        if( wait ? AiaStorage_WriteBlob( id, &volume, sizeof( volume ) )
+                 : AiaStorage_PostBlob( id, &volume, sizeof( volume ) ) )
+        {
+            AiaStorage_Lock();
+            state->persisted = volume;
+            state->hasPersisted = true;
+            AiaStorage_Unlock();
+            continue;
+        }
+
+        AiaLogError( "Failed to store volume, volume=%u", (unsigned)volume );
+        failed = true;
+    }
+
+    if( failed && !AiaTimer( Arm )( &g_aiaStorageVolume.timer,
+                                    AIA_STORAGE_VOLUME_DEBOUNCE_MS, 0 ) )
+    {
+        AiaLogError( "AiaTimer( Arm ) failed" );
+    }
+}
+
+#if AIA_STORAGE_WRITE_BEHIND
+/**
+ * Queues the volumes that have settled for the flush task, which writes them.
+ * Runs on @c g_aiaStorageVolume.timer.
+ *
+ * @param context Unused.
+ */
+static void AiaStorage_OnVolumeSettled( void* context )
+{
+    (void)context;
+    AiaStorage_FlushVolume( false );
+}
+#endif
+
+/**
+ * Creates @c g_aiaStorageVolume.timer once the flush task runs, so that the
+ * timer only ever queues volumes for it.
+ *
+ * @return @c true on success, or @c false if there is no flush task or the
+ * timer could not be created.
+ */
+static bool AiaStorage_CreateVolumeTimer()
+{
+#if AIA_STORAGE_WRITE_BEHIND
+    if( !AiaStorage_StartFlushTask() )
+    {
+        return false;
+    }
+    if( !AiaTimer( Create )( &g_aiaStorageVolume.timer,
+                             AiaStorage_OnVolumeSettled, NULL ) )
+    {
+        AiaLogError( "AiaTimer( Create ) failed" );
+        return false;
+    }
+    g_aiaStorageVolume.timerCreated = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool AiaStoreVolume( uint8_t volume )
+{
+    if( volume > AIA_MAX_VOLUME )
+    {
+        AiaLogError( "Invalid volume, volume=%u", (unsigned)volume );
+        return false;
+    }
+    AiaLoadVolume();
+    AiaStorageVolume_t* current =
+        &g_aiaStorageVolume.namespaces[ AiaStorage_GetNamespace() ];
+
+    if( !g_aiaStorageVolume.timerCreated && !AiaStorage_CreateVolumeTimer() )
+    {
+        /* Without the flush task, write through on the caller. */
+        if( !AiaStoreBlobById( AIA_STORAGE_BLOB_VOLUME, &volume,
+                               sizeof( volume ) ) )
+        {
+            return false;
+        }
+        current->volume = volume;
+        current->persisted = volume;
+        current->hasPersisted = true;
+        return true;
+    }
+
+    AiaStorage_Lock();
+    current->volume = volume;
+    AiaStorage_Unlock();
+
+    /* Re-arming an armed timer pushes its expiration back. */
+    if( !AiaTimer( Arm )( &g_aiaStorageVolume.timer,
+                          AIA_STORAGE_VOLUME_DEBOUNCE_MS, 0 ) )
+    {
+        AiaLogError( "AiaTimer( Arm ) failed" );
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Index of the alert slots, so that finding an alert by token does not read
+ * every slot. Each used slot keeps a hash of its token; a matching hash is
+ * confirmed against the stored record. The used slots also form a binary
+ * min-heap on their scheduled time, so the next alert is always at its root.
+ */
+typedef struct AiaStorageAlertIndex
+{
+    /** Whether the index reflects the slots in storage. */
+    bool built;
+
+    /** Number of used slots. */
+    size_t count;
+
+    /** Whether each slot holds an alert. */
+    bool used[ AIA_STORAGE_ALERT_SLOTS ];
+
+    /** Hash of the token of each used slot. */
+    uint32_t tokenHash[ AIA_STORAGE_ALERT_SLOTS ];
+
+    /** Scheduled time of each used slot. */
+    AiaTimepointSeconds_t scheduledTime[ AIA_STORAGE_ALERT_SLOTS ];
+
+    /** Duration of each used slot. */
+    AiaDurationMs_t duration[ AIA_STORAGE_ALERT_SLOTS ];
+
+    /** The used slots, the first @c count of which form the heap. */
+    size_t heap[ AIA_STORAGE_ALERT_SLOTS ];
+
+    /** Position of each used slot in @c heap. */
+    size_t heapPosition[ AIA_STORAGE_ALERT_SLOTS ];
+} AiaStorageAlertIndex_t;
+
+/**
+ * The alert index of each namespace. Like the blob storage itself, each relies
+ * on its client serializing calls into this port.
+ */
+static AiaStorageAlertIndex_t
+    g_aiaStorageAlertIndexes[ AIA_STORAGE_NAMESPACES ];
+
+/** @return The alert index of the namespace the calling task selected. */
+static AiaStorageAlertIndex_t* AiaStorage_GetAlertIndex()
+{
+    return &g_aiaStorageAlertIndexes[ AiaStorage_GetNamespace() ];
+}
+
+/** @return The blob identifier of alert slot @c slot. */
+static AiaStorageBlobId_t AiaStorage_GetAlertSlotId( size_t slot )
+{
+    return (AiaStorageBlobId_t)( AIA_STORAGE_BLOB_ALERT_SLOT_0 + slot );
+}
+
+/** @return The hash of a token of @c AIA_ALERT_TOKEN_CHARS characters. */
+static uint32_t AiaStorage_HashAlertToken( const char* alertToken )
+{
+    return AiaStorage_Crc32c( 0, alertToken, AIA_ALERT_TOKEN_CHARS );
+}
+
+/*
+ * The little-endian accessors below are written as single expressions, which
+ * compilers turn into plain word loads and stores where the target allows.
+ */
+
+static uint32_t AiaStorage_GetU32( const uint8_t* bytes )
+{
+    return (uint32_t)bytes[ 0 ] | ( (uint32_t)bytes[ 1 ] << 8 ) |
+           ( (uint32_t)bytes[ 2 ] << 16 ) | ( (uint32_t)bytes[ 3 ] << 24 );
+}
+
+static uint64_t AiaStorage_GetU64( const uint8_t* bytes )
+{
+    return (uint64_t)AiaStorage_GetU32( bytes ) |
+           ( (uint64_t)AiaStorage_GetU32( bytes + 4 ) << 32 );
+}
+
+static void AiaStorage_PutU32( uint8_t* bytes, uint32_t value )
+{
+    bytes[ 0 ] = (uint8_t)value;
+    bytes[ 1 ] = (uint8_t)( value >> 8 );
+    bytes[ 2 ] = (uint8_t)( value >> 16 );
+    bytes[ 3 ] = (uint8_t)( value >> 24 );
+}
+
+static void AiaStorage_PutU64( uint8_t* bytes, uint64_t value )
+{
+    AiaStorage_PutU32( bytes, (uint32_t)value );
+    AiaStorage_PutU32( bytes + 4, (uint32_t)( value >> 32 ) );
+}
+
+/**
+ * Serializes an alert into a record.
+ *
+ * @param[out] record Buffer of @c AIA_STORAGE_ALERT_RECORD_SIZE bytes.
+ * @param alert The alert to serialize.
+ */
+static void AiaStorage_EncodeAlert( uint8_t* record,
+                                    const AiaStorageAlert_t* alert )
+{
+    record[ AIA_STORAGE_ALERT_RECORD_VERSION_OFFSET ] =
+        AIA_STORAGE_ALERT_RECORD_VERSION;
+    record[ AIA_STORAGE_ALERT_RECORD_TYPE_OFFSET ] = alert->type;
+    record[ 2 ] = 0;
+    record[ 3 ] = 0;
+    AiaStorage_PutU32( record + AIA_STORAGE_ALERT_RECORD_DURATION_OFFSET,
+                       alert->duration );
+    AiaStorage_PutU64( record + AIA_STORAGE_ALERT_RECORD_SCHEDULED_TIME_OFFSET,
+                       alert->scheduledTime );
+    memcpy( record + AIA_STORAGE_ALERT_RECORD_TOKEN_OFFSET, alert->token,
+            AIA_STORAGE_ALERT_TOKEN_CHARS );
+    AiaStorage_PutU32(
+        record + AIA_STORAGE_ALERT_RECORD_CRC_OFFSET,
+        AiaStorage_Crc32c( 0, record, AIA_STORAGE_ALERT_RECORD_CRC_OFFSET ) );
+}
+
+/**
+ * Parses a record written by @c AiaStorage_EncodeAlert().
+ *
+ * @param record The record.
+ * @param size Size of @c record.
+ * @param[out] alert The parsed alert.
+ * @return @c true on success or @c false if the record is corrupted or of
+ * another version.
+ */
+static bool AiaStorage_DecodeAlert( const uint8_t* record, size_t size,
+                                    AiaStorageAlert_t* alert )
+{
+    if( size != AIA_STORAGE_ALERT_RECORD_SIZE ||
+        record[ AIA_STORAGE_ALERT_RECORD_VERSION_OFFSET ] !=
+            AIA_STORAGE_ALERT_RECORD_VERSION ||
+        AiaStorage_GetU32( record + AIA_STORAGE_ALERT_RECORD_CRC_OFFSET ) !=
+            AiaStorage_Crc32c( 0, record,
+                               AIA_STORAGE_ALERT_RECORD_CRC_OFFSET ) )
+    {
+        return false;
+    }
+    alert->type = record[ AIA_STORAGE_ALERT_RECORD_TYPE_OFFSET ];
+    alert->duration =
+        AiaStorage_GetU32( record + AIA_STORAGE_ALERT_RECORD_DURATION_OFFSET );
+    alert->scheduledTime = AiaStorage_GetU64(
+        record + AIA_STORAGE_ALERT_RECORD_SCHEDULED_TIME_OFFSET );
+    memcpy( alert->token, record + AIA_STORAGE_ALERT_RECORD_TOKEN_OFFSET,
+            AIA_STORAGE_ALERT_TOKEN_CHARS );
+    return true;
+}
+
+/**
+ * Serializes an alert in the format @c AiaLoadAlert() parses.
+ *
+ * @param[out] buffer Buffer of @c AIA_STORAGE_ALERT_V0_SIZE bytes.
+ * @param alert The alert to serialize.
+ */
+static void AiaStorage_EncodeAlertV0( uint8_t* buffer,
+                                      const AiaStorageAlert_t* alert )
+{
+    memcpy( buffer, alert->token, AIA_STORAGE_ALERT_TOKEN_CHARS );
+    buffer += AIA_STORAGE_ALERT_TOKEN_CHARS;
+    AiaStorage_PutU64( buffer, alert->scheduledTime );
+    AiaStorage_PutU32( buffer + 8, alert->duration );
+    buffer[ 12 ] = alert->type;
+}
+
+/**
+ * @return Whether the alert at heap position @c a of @c alertIndex is due
+ * before the one at @c b. Ties go to the lower slot so that the order is
+ * deterministic.
+ */
+static bool AiaStorage_AlertHeapBefore(
+    const AiaStorageAlertIndex_t* alertIndex, size_t a, size_t b )
+{
+    size_t slotA = alertIndex->heap[ a ];
+    size_t slotB = alertIndex->heap[ b ];
+    AiaTimepointSeconds_t timeA = alertIndex->scheduledTime[ slotA ];
+    AiaTimepointSeconds_t timeB = alertIndex->scheduledTime[ slotB ];
+    return timeA < timeB || ( timeA == timeB && slotA < slotB );
+}
+
+static void AiaStorage_AlertHeapSwap( AiaStorageAlertIndex_t* alertIndex,
+                                      size_t a, size_t b )
+{
+    size_t slotA = alertIndex->heap[ a ];
+    size_t slotB = alertIndex->heap[ b ];
+    alertIndex->heap[ a ] = slotB;
+    alertIndex->heap[ b ] = slotA;
+    alertIndex->heapPosition[ slotA ] = b;
+    alertIndex->heapPosition[ slotB ] = a;
+}
+
+/** Restores the heap of @c alertIndex after the key at @c position changed. */
+static void AiaStorage_AlertHeapFix( AiaStorageAlertIndex_t* alertIndex,
+                                     size_t position )
+{
+    while( position > 0 && AiaStorage_AlertHeapBefore( alertIndex, position,
+                                                       ( position - 1 ) / 2 ) )
+    {
+        AiaStorage_AlertHeapSwap( alertIndex, position, ( position - 1 ) / 2 );
+        position = ( position - 1 ) / 2;
+    }
+    for( ;; )
+    {
+        size_t first = position;
+        size_t child = 2 * position + 1;
+        for( size_t i = 0; i < 2; ++i, ++child )
+        {
+            if( child < alertIndex->count &&
+                AiaStorage_AlertHeapBefore( alertIndex, child, first ) )
+            {
+                first = child;
+            }
+        }
+        if( first == position )
+        {
+            return;
+        }
+        AiaStorage_AlertHeapSwap( alertIndex, position, first );
+        position = first;
+    }
+}
+
+/**
+ * Adds or updates the index entry of a slot.
+ *
+ * @param slot The slot @c alert was written to.
+ * @param alert The alert.
+ */
+static void AiaStorage_IndexAlert( size_t slot,
+                                   const AiaStorageAlert_t* alert )
+{
+    AiaStorageAlertIndex_t* alertIndex = AiaStorage_GetAlertIndex();
+    if( !alertIndex->used[ slot ] )
+    {
+        size_t position = alertIndex->count++;
+        alertIndex->used[ slot ] = true;
+        alertIndex->heap[ position ] = slot;
+        alertIndex->heapPosition[ slot ] = position;
+    }
+    alertIndex->tokenHash[ slot ] =
+        AiaStorage_HashAlertToken( alert->token );
+    alertIndex->scheduledTime[ slot ] = alert->scheduledTime;
+    alertIndex->duration[ slot ] = alert->duration;
+    AiaStorage_AlertHeapFix( alertIndex, alertIndex->heapPosition[ slot ] );
+}
+
+/** Removes the index entry of a used slot. */
+static void AiaStorage_UnindexAlert( size_t slot )
+{
+    AiaStorageAlertIndex_t* alertIndex = AiaStorage_GetAlertIndex();
+    size_t position = alertIndex->heapPosition[ slot ];
+    size_t last = --alertIndex->count;
+    alertIndex->used[ slot ] = false;
+    if( position != last )
+    {
+        AiaStorage_AlertHeapSwap( alertIndex, position, last );
+        AiaStorage_AlertHeapFix( alertIndex, position );
+    }
+}
+
+/**
+ * Compares part of the record in an alert slot with the given bytes.
+ *
+ * @param slot A used slot.
+ * @param offset Offset of the bytes to compare within the record.
+ * @param bytes The bytes to compare.
+ * @param size Number of bytes to compare.
+ * @return @c true if the record holds @c bytes at @c offset or @c false
+ * otherwise.
+ */
+static bool AiaStorage_AlertSlotMatches( size_t slot, size_t offset,
+                                         const void* bytes, size_t size )
+{
+    AiaStorageBlobView_t view;
+    bool matches;
+    if( !AiaStorage_BorrowBlobById( AiaStorage_GetAlertSlotId( slot ),
+                                    &view ) )
+    {
+        return false;
+    }
+    matches = view.size >= offset + size &&
+              !memcmp( view.data + offset, bytes, size );
+    AiaStorage_ReleaseBlob( &view );
+    return matches;
+}
+
+/**
+ * Finds the slot holding an alert.
+ *
+ * @param alertToken Token of @c AIA_ALERT_TOKEN_CHARS characters.
+ * @param[out] slot The slot holding the alert, if found.
+ * @return @c true if the alert was found or @c false otherwise.
+ */
+static bool AiaStorage_FindAlertSlot( const char* alertToken, size_t* slot )
+{
+    AiaStorageAlertIndex_t* alertIndex = AiaStorage_GetAlertIndex();
+    uint32_t hash = AiaStorage_HashAlertToken( alertToken );
+    for( size_t i = 0; i < AIA_STORAGE_ALERT_SLOTS; ++i )
+    {
+        if( alertIndex->used[ i ] &&
+            alertIndex->tokenHash[ i ] == hash &&
+            AiaStorage_AlertSlotMatches( i,
+                                         AIA_STORAGE_ALERT_RECORD_TOKEN_OFFSET,
+                                         alertToken, AIA_ALERT_TOKEN_CHARS ) )
+        {
+            *slot = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Writes an alert over the slot holding the same token, or into a free slot if
+ * there is none. A stored alert that is unchanged is not rewritten.
+ *
+ * @param alert The alert to write.
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorage_WriteAlertRecord( const AiaStorageAlert_t* alert )
+{
+    AiaStorageAlertIndex_t* alertIndex = AiaStorage_GetAlertIndex();
+    uint8_t record[ AIA_STORAGE_ALERT_RECORD_SIZE ];
+    size_t slot;
+    AiaStorage_EncodeAlert( record, alert );
+    if( AiaStorage_FindAlertSlot( alert->token, &slot ) )
+    {
+        if( AiaStorage_AlertSlotMatches( slot, 0, record, sizeof( record ) ) )
+        {
+            return true;
+        }
+    }
+    else
+    {
+        for( slot = 0; slot < AIA_STORAGE_ALERT_SLOTS; ++slot )
+        {
+            if( !alertIndex->used[ slot ] )
+            {
+                break;
+            }
+        }
+        if( slot == AIA_STORAGE_ALERT_SLOTS )
+        {
+            AiaLogError(
+                "AiaStoreAlert failed: Maximum number of local alerts to store "
+                "reached." );
+            return false;
+        }
+    }
+
+    if( !AiaStoreBlobById( AiaStorage_GetAlertSlotId( slot ), record,
+                           sizeof( record ) ) )
+    {
+        AiaLogError( "AiaStoreBlob failed" );
+        return false;
+    }
+
+    AiaStorage_IndexAlert( slot, alert );
+    return true;
+}
+
+/**
+ * Frees a used alert slot.
+ *
+ * @param slot The slot to free.
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorage_FreeAlertSlot( size_t slot )
+{
+    if( !AiaDeleteBlobById( AiaStorage_GetAlertSlotId( slot ) ) )
+    {
+        AiaLogError( "AiaStoreBlob failed" );
+        return false;
+    }
+    AiaStorage_UnindexAlert( slot );
+    return true;
+}
+
+/**
+ * Loads the alert in a used slot. A corrupted record is dropped from the index,
+ * which frees its slot.
+ *
+ * @param slot The slot to load.
+ * @param[out] alert The alert.
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorage_ReadAlertSlot( size_t slot, AiaStorageAlert_t* alert )
+{
+    AiaStorageBlobView_t view;
+    bool decoded;
+    if( !AiaStorage_BorrowBlobById( AiaStorage_GetAlertSlotId( slot ),
+                                    &view ) &&
+        AiaStorage_GetLastError() != AIA_STORAGE_ERROR_CORRUPTED )
+    {
+        AiaLogError( "AiaStorage_BorrowBlobById failed" );
+        return false;
+    }
+    /* A record failing the backend's checksum leaves the view empty. */
+    decoded = AiaStorage_DecodeAlert( view.data, view.size, alert );
+    AiaStorage_ReleaseBlob( &view );
+    if( !decoded )
+    {
+        AiaLogError( "Corrupted alert record, slot=%zu", slot );
+        AiaStorage_UnindexAlert( slot );
+    }
+    return decoded;
+}
+
+/**
+ * Moves the alerts of a blob written by earlier versions of this port, which
+ * kept all of them back to back under @c AIA_STORAGE_BLOB_ALL_ALERTS_V0, into
+ * slots. The old blob is only emptied once every alert has been moved, and
+ * moving an alert again overwrites its slot, so an interrupted migration is
+ * simply redone.
+ *
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorage_MigrateAlertsV0()
+{
+    if( AiaGetBlobSizeById( AIA_STORAGE_BLOB_ALL_ALERTS_V0 ) <
+        AIA_STORAGE_ALERT_V0_SIZE )
+    {
+        return true;
+    }
+
+    /* The migration runs once, so each alert is copied out of a view of the
+     * old blob rather than keeping a buffer for all of them. */
+    for( size_t bytePosition = 0;; bytePosition += AIA_STORAGE_ALERT_V0_SIZE )
+    {
+        uint8_t alertV0[ AIA_STORAGE_ALERT_V0_SIZE ];
+        AiaStorageBlobView_t view;
+        AiaStorageAlert_t alert;
+        if( !AiaStorage_BorrowBlobById( AIA_STORAGE_BLOB_ALL_ALERTS_V0,
+                                        &view ) )
+        {
+            AiaLogError( "AiaStorage_BorrowBlobById failed" );
+            /* Nothing can be recovered from a damaged blob, so drop it. */
+            return AiaStorage_GetLastError() == AIA_STORAGE_ERROR_CORRUPTED &&
+                   AiaDeleteBlobById( AIA_STORAGE_BLOB_ALL_ALERTS_V0 );
+        }
+        bool found = bytePosition + AIA_STORAGE_ALERT_V0_SIZE <= view.size &&
+                     '\0' != view.data[ bytePosition ];
+        if( found )
+        {
+            memcpy( alertV0, view.data + bytePosition, sizeof( alertV0 ) );
+        }
+        AiaStorage_ReleaseBlob( &view );
+        if( !found )
+        {
+            break;
+        }
+        if( !AiaLoadAlert( alert.token, sizeof( alert.token ),
+                           &alert.scheduledTime, &alert.duration, &alert.type,
+                           alertV0 ) ||
+            !AiaStorage_WriteAlertRecord( &alert ) )
+        {
+            return false;
+        }
+    }
+
+    return AiaDeleteBlobById( AIA_STORAGE_BLOB_ALL_ALERTS_V0 );
+}
+
+/**
+ * Rewrites a slot holding an alert in @c AIA_STORAGE_ALERT_V0_SIZE bytes, as
+ * earlier versions of this port stored them, as a record.
+ *
+ * @param slot The slot to rewrite.
+ * @param alert The alert the slot holds.
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorage_MigrateAlertSlotV0( size_t slot,
+                                           const AiaStorageAlert_t* alert )
+{
+    uint8_t record[ AIA_STORAGE_ALERT_RECORD_SIZE ];
+    AiaStorage_EncodeAlert( record, alert );
+    if( !AiaStoreBlobById( AiaStorage_GetAlertSlotId( slot ), record,
+                           sizeof( record ) ) )
+    {
+        AiaLogError( "AiaStoreBlob failed" );
+        return false;
+    }
+    AiaStorage_IndexAlert( slot, alert );
+    return true;
+}
+
+/**
+ * Builds the alert index of the selected namespace from the slots in storage
+ * if it has not been built yet. Corrupted records are left out, which frees
+ * their slots.
+ *
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorage_BuildAlertIndex()
+{
+    AiaStorageAlertIndex_t* alertIndex = AiaStorage_GetAlertIndex();
+    AiaStorageBlobView_t view;
+    AiaStorageAlert_t alert;
+    if( alertIndex->built )
+    {
+        return true;
+    }
+
+    memset( alertIndex, 0, sizeof( *alertIndex ) );
+    for( size_t slot = 0; slot < AIA_STORAGE_ALERT_SLOTS; ++slot )
+    {
+        bool decoded = false;
+        bool v0 = false;
+        if( !AiaStorage_BorrowBlobById( AiaStorage_GetAlertSlotId( slot ),
+                                        &view ) )
+        {
+            if( AiaStorage_GetLastError() != AIA_STORAGE_ERROR_CORRUPTED )
+            {
+                AiaLogError( "AiaStorage_BorrowBlobById failed" );
+                return false;
+            }
+            /* Left out of the index, so the slot is reused. */
+            AiaLogError( "Corrupted alert record, slot=%zu", slot );
+            continue;
+        }
+        if( view.size == AIA_STORAGE_ALERT_V0_SIZE )
+        {
+            v0 = AiaLoadAlert( alert.token, sizeof( alert.token ),
+                               &alert.scheduledTime, &alert.duration,
+                               &alert.type, view.data );
+        }
+        else if( view.size )
+        {
+            decoded = AiaStorage_DecodeAlert( view.data, view.size, &alert );
+            if( !decoded )
+            {
+                AiaLogError( "Corrupted alert record, slot=%zu", slot );
+            }
+        }
+        AiaStorage_ReleaseBlob( &view );
+
+        if( decoded )
+        {
+            AiaStorage_IndexAlert( slot, &alert );
+        }
+        else if( v0 && !AiaStorage_MigrateAlertSlotV0( slot, &alert ) )
+        {
+            return false;
+        }
+    }
+
+    if( !AiaStorage_MigrateAlertsV0() )
+    {
+        AiaLogError( "AiaStorage_MigrateAlertsV0 failed" );
+        return false;
+    }
+
+    alertIndex->built = true;
+    return true;
+}
+
+/**
+ * Opens a transaction for a bulk alert update, unless the caller has one open.
+ *
+ * @param[out] owned Receives whether the transaction was opened here.
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorage_BeginAlertBatch( bool* owned )
+{
+    *owned = !AiaStorage_GetOpenTransaction( AiaStorage_GetNamespace() );
+    return !*owned || AiaStorage_BeginTransaction();
+}
+
+/**
+ * Ends a bulk alert update begun by @c AiaStorage_BeginAlertBatch().
+ *
+ * @param owned Whether the transaction was opened for the update.
+ * @param staged Whether every write of the update was staged.
+ * @return @c true if the update was committed, or staged in the caller's
+ * transaction, or @c false otherwise.
+ */
+static bool AiaStorage_EndAlertBatch( bool owned, bool staged )
+{
+    if( !owned )
+    {
+        return staged;
+    }
+    if( !staged )
+    {
+        AiaStorage_AbortTransaction();
+        return false;
+    }
+    return AiaStorage_CommitTransaction();
+}
+
+bool AiaStoreAlert( const char* alertToken, size_t alertTokenLen,
+                    AiaTimepointSeconds_t scheduledTime,
+                    AiaDurationMs_t duration, uint8_t alertType )
+{
+    AiaStorageAlert_t alert;
+    if( !alertToken )
+    {
+        AiaLogError( "Null alertToken" );
+        return false;
+    }
+    if( alertTokenLen != AIA_ALERT_TOKEN_CHARS )
+    {
+        AiaLogError( "Invalid alert token length" );
+        return false;
+    }
+    if( !AiaStorage_BuildAlertIndex() )
+    {
+        return false;
+    }
+
+    memcpy( alert.token, alertToken, sizeof( alert.token ) );
+    alert.scheduledTime = scheduledTime;
+    alert.duration = duration;
+    alert.type = alertType;
+    return AiaStorage_WriteAlertRecord( &alert );
+}
+
+bool AiaDeleteAlert( const char* alertToken, size_t alertTokenLen )
+{
+    size_t slot;
+    if( !alertToken )
+    {
+        AiaLogError( "Null alertToken" );
+        return false;
+    }
+    if( alertTokenLen != AIA_ALERT_TOKEN_CHARS )
+    {
+        AiaLogError( "Invalid alert token length" );
+        return false;
+    }
+    if( !AiaStorage_BuildAlertIndex() )
+    {
+        return false;
+    }
+
+    if( !AiaStorage_FindAlertSlot( alertToken, &slot ) )
+    {
+        return true;
+    }
+    return AiaStorage_FreeAlertSlot( slot );
+}
+
+bool AiaLoadAlert( char* alertToken, size_t alertTokenLen,
+                   AiaTimepointSeconds_t* scheduledTime,
+                   AiaDurationMs_t* duration, uint8_t* alertType,
+                   const uint8_t* allAlertsBuffer )
+{
+    if( !alertToken )
+    {
+        AiaLogError( "Null alertToken" );
+        return false;
+    }
+    if( !scheduledTime )
+    {
+        AiaLogError( "Null scheduledTime" );
+        return false;
+    }
+    if( !duration )
+    {
+        AiaLogError( "Null duration" );
+        return false;
+    }
+    if( !alertType )
+    {
+        AiaLogError( "Null alertType" );
+        return false;
+    }
+    if( !allAlertsBuffer )
+    {
+        AiaLogError( "Null allAlertsBuffer" );
+        return false;
+    }
+    if( alertTokenLen != AIA_ALERT_TOKEN_CHARS )
+    {
+        AiaLogError( "Invalid alert token length" );
+        return false;
+    }
+
+    memcpy( alertToken, allAlertsBuffer, alertTokenLen );
+    allAlertsBuffer += alertTokenLen;
+    *scheduledTime = AiaStorage_GetU64( allAlertsBuffer );
+    *duration = AiaStorage_GetU32( allAlertsBuffer + 8 );
+    *alertType = allAlertsBuffer[ 12 ];
+    return true;
+}
+
+bool AiaLoadAlerts( uint8_t* allAlerts, size_t size )
+{
+    AiaStorageAlertIndex_t* alertIndex = AiaStorage_GetAlertIndex();
+    if( !AiaAlertsBlobExists() )
+    {
+        if( size != 0 )
+        {
+            AiaLogError( "Alerts blob with size %zu does not exist", size );
+            return false;
+        }
+        else
+        {
+            return true;
+        }
+    }
+    if( !allAlerts )
+    {
+        AiaLogError( "Null allAlerts" );
+        return false;
+    }
+
+    size_t used = AiaGetAlertsSize();
+    if( used > size )
+    {
+        AiaLogError( "alerts load size error: used(%zu), size(%zu)", used,
+                     size );
+        return false;
+    }
+
+    /** Concatenate the used slots in the format of the original blob */
+    for( size_t slot = 0; slot < AIA_STORAGE_ALERT_SLOTS; ++slot )
+    {
+        AiaStorageAlert_t alert;
+        if( !alertIndex->used[ slot ] )
+        {
+            continue;
+        }
+        if( !AiaStorage_ReadAlertSlot( slot, &alert ) )
+        {
+            return false;
+        }
+        AiaStorage_EncodeAlertV0( allAlerts, &alert );
+        allAlerts += AIA_STORAGE_ALERT_V0_SIZE;
+    }
+    return true;
+}
+
+size_t AiaGetAlertsSize()
+{
+    AiaStorageAlertIndex_t* alertIndex = AiaStorage_GetAlertIndex();
+    if( !AiaStorage_BuildAlertIndex() )
+    {
+        return 0;
+    }
+    return alertIndex->count * AIA_STORAGE_ALERT_V0_SIZE;
+}
+
+bool AiaAlertsBlobExists()
+{
+    AiaStorageAlertIndex_t* alertIndex = AiaStorage_GetAlertIndex();
+    return AiaStorage_BuildAlertIndex() && alertIndex->count > 0;
+}
+
+bool AiaStoreAlerts( const AiaStorageAlert_t* alerts, size_t count )
+{
+    AiaStorageAlertIndex_t* alertIndex = AiaStorage_GetAlertIndex();
+    size_t newAlerts = 0;
+    size_t slot;
+    if( !alerts && count )
+    {
+        AiaLogError( "Null alerts" );
+        return false;
+    }
+    if( !AiaStorage_BuildAlertIndex() )
+    {
+        return false;
+    }
+
+    /** Count the tokens which need a free slot, each only once */
+    for( size_t i = 0; i < count; ++i )
+    {
+        bool repeated = false;
+        for( size_t j = 0; j < i && !repeated; ++j )
+        {
+            repeated = !memcmp( alerts[ i ].token, alerts[ j ].token,
+                                AIA_STORAGE_ALERT_TOKEN_CHARS );
+        }
+        if( !repeated &&
+            !AiaStorage_FindAlertSlot( alerts[ i ].token, &slot ) )
+        {
+            ++newAlerts;
+        }
+    }
+    if( newAlerts > AIA_STORAGE_ALERT_SLOTS - alertIndex->count )
+    {
+        AiaLogError(
+            "AiaStoreAlerts failed: Maximum number of local alerts to store "
+            "reached, new=%zu.",
+            newAlerts );
+        return false;
+    }
 
-    if( !blob || k >= AIA_BLOB_STORAGE_KEY_MAX )
+    bool owned;
+    bool staged = true;
+    if( !AiaStorage_BeginAlertBatch( &owned ) )
     {
-        AiaLogError( "Invalid input: blob(%u) key(%s)", blob, key);
+        return false;
     }
-
-    return process;
+    for( size_t i = 0; i < count && staged; ++i )
+    {
+        staged = AiaStorage_WriteAlertRecord( &alerts[ i ] );
+    }
+    return AiaStorage_EndAlertBatch( owned, staged );
 }
 
-bool AiaLoadBlob( const char* key, uint8_t* const blob, size_t size )
+bool AiaDeleteAlerts( const char* const* alertTokens, size_t count )
 {
-    bool process = false;
-    blobstorage_key_e k = AIA_BLOB_STORAGE_KEY_MAX;
-
-    for( k = AIA_BLOB_STORAGE_KEY_START; blob && k < AIA_BLOB_STORAGE_KEY_MAX; ++k )
+    bool owned;
+    bool staged = true;
+    if( !alertTokens && count )
     {
-        if( strncmp(key, blobstorage[ k ].key, strlen(key)) == 0 )
-        {
-            if( blobstorage[ k ].used_len <= size )
-            {
-                memcpy( blob, blobstorage[ k ].storage, blobstorage[k].used_len );
-                process = true;
-            }
-            else
-            {
-                AiaLogError( "blob load size error: key(%s), used(%u), size(%u)", key, blobstorage[k].used_len, size );
-            }
-
-            break;
-        }
+        AiaLogError( "Null alertTokens" );
+        return false;
     }
-
-    if( !blob || k >= AIA_BLOB_STORAGE_KEY_MAX )
+    if( !AiaStorage_BuildAlertIndex() ||
+        !AiaStorage_BeginAlertBatch( &owned ) )
     {
-        AiaLogError( "Invalid input: blob(%u) key(%s)", blob, key);
+        return false;
     }
-
-    return process;
+    for( size_t i = 0; i < count && staged; ++i )
+    {
+        staged = AiaDeleteAlert( alertTokens[ i ], AIA_ALERT_TOKEN_CHARS );
+    }
+    return AiaStorage_EndAlertBatch( owned, staged );
 }
 
-bool AiaBlobExists( const char* key )
+bool AiaReplaceAlerts( const AiaStorageAlert_t* alerts, size_t count )
 {
-	bool existed = false;
-    blobstorage_key_e k = AIA_BLOB_STORAGE_KEY_MAX;
+    AiaStorageAlertIndex_t* alertIndex = AiaStorage_GetAlertIndex();
+    AiaStorageBlobView_t view;
+    if( !alerts && count )
+    {
+        AiaLogError( "Null alerts" );
+        return false;
+    }
+    if( count > AIA_STORAGE_ALERT_SLOTS )
+    {
+        AiaLogError( "Too many alerts, count=%zu.", count );
+        return false;
+    }
+    if( !AiaStorage_BuildAlertIndex() )
+    {
+        return false;
+    }
+
+    bool owned;
+    bool staged = true;
+    if( !AiaStorage_BeginAlertBatch( &owned ) )
+    {
+        return false;
+    }
 
-    for( k = AIA_BLOB_STORAGE_KEY_START;k < AIA_BLOB_STORAGE_KEY_MAX; ++k )
+    /** Free the slots of alerts missing from the new set first */
+    for( size_t slot = 0; slot < AIA_STORAGE_ALERT_SLOTS && staged; ++slot )
     {
-        if( strncmp(key, blobstorage[ k ].key, strlen(key)) == 0 )
+        bool keep = false;
+        if( !alertIndex->used[ slot ] )
+        {
+            continue;
+        }
+        if( !AiaStorage_BorrowBlobById( AiaStorage_GetAlertSlotId( slot ),
+                                        &view ) &&
+            AiaStorage_GetLastError() != AIA_STORAGE_ERROR_CORRUPTED )
         {
-            existed = true;
+            AiaLogError( "AiaStorage_BorrowBlobById failed" );
+            staged = false;
             break;
         }
+        /* A record failing the backend's checksum is empty here and freed. */
+        for( size_t i = 0;
+             i < count && !keep && view.size == AIA_STORAGE_ALERT_RECORD_SIZE;
+             ++i )
+        {
+            keep = !memcmp( view.data + AIA_STORAGE_ALERT_RECORD_TOKEN_OFFSET,
+                            alerts[ i ].token, AIA_STORAGE_ALERT_TOKEN_CHARS );
+        }
+        AiaStorage_ReleaseBlob( &view );
+        staged = keep || AiaStorage_FreeAlertSlot( slot );
     }
 
-    return existed;
+    staged = staged && AiaStoreAlerts( alerts, count );
+    return AiaStorage_EndAlertBatch( owned, staged );
 }
 
-size_t AiaGetBlobSize( const char* key )
+bool AiaLoadAllAlerts( AiaStorageAlert_t* alerts, size_t capacity,
+                       size_t* count )
 {
-    size_t blob_size = 0;
-    blobstorage_key_e k = AIA_BLOB_STORAGE_KEY_MAX;
-
-    for( k = AIA_BLOB_STORAGE_KEY_START; k < AIA_BLOB_STORAGE_KEY_MAX; ++k )
+    AiaStorageAlertIndex_t* alertIndex = AiaStorage_GetAlertIndex();
+    if( !count || ( !alerts && capacity ) )
     {
-        if( strncmp( key, blobstorage[ k ].key, strlen(key) ) == 0 )
-        {
-            blob_size = blobstorage[ k ].used_len;
-            break;
-        }
+        AiaLogError( "Invalid input: alerts(%p) count(%p)", (void*)alerts,
+                     (void*)count );
+        return false;
     }
-
-    if( k >= AIA_BLOB_STORAGE_KEY_MAX )
+    *count = 0;
+    if( !AiaStorage_BuildAlertIndex() )
+    {
+        return false;
+    }
+    if( alertIndex->count > capacity )
     {
-        AiaLogError( "blob key error: %s", key );
+        AiaLogError( "alerts load size error: used(%zu), capacity(%zu)",
+                     alertIndex->count, capacity );
+        return false;
     }
 
-    return blob_size;
+    for( size_t slot = 0; slot < AIA_STORAGE_ALERT_SLOTS; ++slot )
+    {
+        if( !alertIndex->used[ slot ] )
+        {
+            continue;
+        }
+        if( !AiaStorage_ReadAlertSlot( slot, alerts + *count ) )
+        {
+            return false;
+        }
+        ++*count;
+    }
+    return true;
 }
 
-bool AiaStoreAlert( const char* alertToken, size_t alertTokenLen,
-                    AiaTimepointSeconds_t scheduledTime,
-                    AiaDurationMs_t duration, uint8_t alertType )
+bool AiaLoadNextAlert( AiaStorageAlert_t* alert )
 {
-    if( !alertToken )
+    AiaStorageAlertIndex_t* alertIndex = AiaStorage_GetAlertIndex();
+    if( !alert )
     {
-        AiaLogError( "Null alertToken" );
+        AiaLogError( "Null alert" );
         return false;
     }
-    if( alertTokenLen != AIA_ALERT_TOKEN_CHARS )
+    if( !AiaStorage_BuildAlertIndex() || !alertIndex->count )
     {
-        AiaLogError( "Invalid alert token length" );
         return false;
     }
 
-    size_t allAlertsBytes = AiaGetAlertsSize();
-    size_t alertsBytesWithNewAlert =
-        allAlertsBytes + AIA_SIZE_OF_ALERT_IN_BYTES;
-    size_t startingOffset = allAlertsBytes;
-    size_t bytePosition;
-    bool updatingExistingAlert = false;
+    return AiaStorage_ReadAlertSlot( alertIndex->heap[ 0 ], alert );
+}
 
-    /**
-     * Load all alerts from persistent storage. Allocated additional space
-     * for a new alert though in case the token we are trying to insert does
-     * not exist in persistent storage yet.
-     */
-    uint8_t* allAlertsBuffer = AiaCalloc( 1, alertsBytesWithNewAlert );
-    if( !allAlertsBuffer )
-    {
-        AiaLogError( "AiaCalloc failed, bytes=%zu.", alertsBytesWithNewAlert );
-        return false;
-    }
+/**
+ * @param alertIndex The index holding @c slot.
+ * @param slot A used alert slot.
+ * @param now The current time.
+ * @return Whether the alert in @c slot has finished playing by @c now.
+ */
+static bool AiaStorage_IsAlertExpired( const AiaStorageAlertIndex_t* alertIndex,
+                                       size_t slot, AiaTimepointSeconds_t now )
+{
+    return alertIndex->scheduledTime[ slot ] +
+               alertIndex->duration[ slot ] / AIA_MS_PER_SECOND <
+           now;
+}
 
-    if( !AiaLoadAlerts( allAlertsBuffer, allAlertsBytes ) )
+bool AiaDeleteExpiredAlerts()
+{
+    AiaStorageAlertIndex_t* alertIndex = AiaStorage_GetAlertIndex();
+    AiaTimepointSeconds_t now = AiaClock_GetTimeSinceNTPEpoch();
+    size_t expired = 0;
+    bool owned;
+    bool staged = true;
+    if( !AiaStorage_BuildAlertIndex() )
     {
-        AiaLogError( "AiaLoadBlob failed" );
-        AiaFree( allAlertsBuffer );
         return false;
     }
 
-    /** Go through the tokens to find the first empty or matching one */
-    for( bytePosition = 0; bytePosition < alertsBytesWithNewAlert;
-         bytePosition += AIA_SIZE_OF_ALERT_IN_BYTES )
+    /** The index holds every alert's times, so no record is read here */
+    for( size_t slot = 0; slot < AIA_STORAGE_ALERT_SLOTS; ++slot )
     {
-        startingOffset = bytePosition;
-        if( '\0' == allAlertsBuffer[ bytePosition ] )
-        {
-            /** Found an empty token */
-            break;
-        }
-        else
+        if( alertIndex->used[ slot ] &&
+            AiaStorage_IsAlertExpired( alertIndex, slot, now ) )
         {
-            /** Check if this token matches with what we are trying to insert */
-            if( !strncmp( (const char*)allAlertsBuffer + bytePosition,
-                          alertToken, alertTokenLen ) )
-            {
-                updatingExistingAlert = true;
-                break;
-            }
+            ++expired;
         }
     }
+    if( !expired )
+    {
+        return true;
+    }
 
-    /* Check if we have reached the alerts storage limit */
-    if( startingOffset == alertsBytesWithNewAlert )
+    if( !AiaStorage_BeginAlertBatch( &owned ) )
     {
-        AiaLogError(
-            "AiaStoreAlert failed: Maximum number of local alerts to store "
-            "reached." );
-        AiaFree( allAlertsBuffer );
         return false;
     }
-
-    /** Write the new alert token */
-    uint8_t* newAlertOffset = allAlertsBuffer + startingOffset;
-    memcpy( newAlertOffset, alertToken, alertTokenLen );
-
-    /** Write the other fields: scheduledTime, duration, alertType */
-    bytePosition = alertTokenLen;
-    for( size_t i = 0; i < sizeof( AiaTimepointSeconds_t );
-         ++i, bytePosition++ )
+    for( size_t slot = 0; slot < AIA_STORAGE_ALERT_SLOTS && staged; ++slot )
     {
-        newAlertOffset[ bytePosition ] = ( scheduledTime >> ( i * 8 ) );
+        if( alertIndex->used[ slot ] &&
+            AiaStorage_IsAlertExpired( alertIndex, slot, now ) )
+        {
+            staged = AiaStorage_FreeAlertSlot( slot );
+        }
     }
-    for( size_t i = 0; i < sizeof( AiaDurationMs_t ); ++i, bytePosition++ )
+    if( !AiaStorage_EndAlertBatch( owned, staged ) )
     {
-        newAlertOffset[ bytePosition ] = ( duration >> ( i * 8 ) );
+        return false;
     }
-    for( size_t i = 0; i < sizeof( uint8_t ); ++i, bytePosition++ )
+
+    AiaLogInfo( "Deleted expired alerts, count=%zu", expired );
+    return true;
+}
+
+bool AiaStorage_BeginTransaction()
+{
+    size_t ns = AiaStorage_GetNamespace();
+    AiaStorageTransaction_t* transaction = NULL;
+    if( g_aiaStorageTransactions.open[ ns ] )
     {
-        newAlertOffset[ bytePosition ] = ( alertType >> ( i * 8 ) );
+        AiaLogError( "A transaction is already open" );
+        return false;
     }
 
-    /** Store the new blob in persistent storage */
-    size_t storeSize =
-        ( updatingExistingAlert ? allAlertsBytes : alertsBytesWithNewAlert );
-    /** Store the new blob in persistent storage */
-    if( !AiaStoreBlob( AIA_ALL_ALERTS_STORAGE_KEY_V0, allAlertsBuffer,
-                       storeSize ) )
+    AiaStorage_Lock();
+    for( size_t i = 0; i < AIA_STORAGE_CONCURRENT_NAMESPACES && !transaction;
+         ++i )
     {
-        AiaLogError( "AiaStoreBlob failed" );
-        AiaFree( allAlertsBuffer );
+        if( !g_aiaStorageTransactions.pool[ i ].claimed )
+        {
+            transaction = &g_aiaStorageTransactions.pool[ i ];
+            transaction->claimed = true;
+        }
+    }
+    AiaStorage_Unlock();
+    if( !transaction )
+    {
+        AiaLogError( "No transaction free, namespaces=%d",
+                     AIA_STORAGE_CONCURRENT_NAMESPACES );
         return false;
     }
 
-    AiaFree( allAlertsBuffer );
+    AiaStorageStagingArea_t area = { transaction->blobs,
+                                     AIA_STORAGE_TRANSACTION_MAX_BLOBS,
+                                     transaction->data,
+                                     AIA_STORAGE_TRANSACTION_SIZE,
+                                     0,
+                                     0 };
+    transaction->area = area;
+    g_aiaStorageTransactions.open[ ns ] = transaction;
     return true;
 }
 
-bool AiaDeleteAlert( const char* alertToken, size_t alertTokenLen )
+/**
+ * Returns a transaction to the pool.
+ *
+ * @param transaction A transaction no namespace has open any more.
+ */
+static void AiaStorage_ReleaseTransaction(
+    AiaStorageTransaction_t* transaction )
 {
-    if( !alertToken )
+    AiaStorage_Lock();
+    transaction->claimed = false;
+    AiaStorage_Unlock();
+}
+
+bool AiaStorage_CommitTransaction()
+{
+    AiaStorageBlobWrite_t writes[ AIA_STORAGE_TRANSACTION_MAX_BLOBS ];
+    size_t ns = AiaStorage_GetNamespace();
+    AiaStorageTransaction_t* transaction = AiaStorage_GetOpenTransaction( ns );
+    if( !transaction )
     {
-        AiaLogError( "Null alertToken" );
+        AiaLogError( "No open transaction" );
         return false;
     }
-    if( alertTokenLen != AIA_ALERT_TOKEN_CHARS )
+    if( g_aiaStorageViews.outstanding[ ns ] )
     {
-        AiaLogError( "Invalid alert token length" );
+        AiaLogError( "Cannot commit while blob views are borrowed, views=%zu",
+                     g_aiaStorageViews.outstanding[ ns ] );
         return false;
     }
 
-    size_t allAlertsBytes = AiaGetAlertsSize();
-    size_t bytePosition;
-    bool deletingExistingAlert = false;
+    for( size_t i = 0; i < transaction->area.count; ++i )
+    {
+        const AiaStorageStagedBlob_t* staged = &transaction->blobs[ i ];
+        writes[ i ].id = staged->id;
+        writes[ i ].blob = transaction->data + staged->offset;
+        writes[ i ].size = staged->size;
+    }
+    g_aiaStorageTransactions.open[ ns ] = NULL;
 
-    /**
-     * Load all alerts from persistent storage.
-     */
-    uint8_t* allAlertsBuffer = AiaCalloc( 1, allAlertsBytes );
-    if( !allAlertsBuffer )
+    /* Queued writes of the same blobs must not land after the commit. */
+    bool committed = AiaStorage_Flush();
+    if( committed )
+    {
+        AiaStorage_Lock();
+        committed =
+            AiaStorageBackend( CommitBlobs )( writes, transaction->area.count );
+        AiaStorage_Unlock();
+    }
+    AiaStorage_ReleaseTransaction( transaction );
+    if( !committed )
     {
-        AiaLogError( "AiaCalloc failed, bytes=%zu.", allAlertsBytes );
+        AiaLogError( "Failed to commit transaction" );
+
+        /* The alert index may reflect staged alerts. */
+        AiaStorage_GetAlertIndex()->built = false;
         return false;
     }
+    return true;
+}
 
-    if( !AiaLoadAlerts( allAlertsBuffer, allAlertsBytes ) )
+void AiaStorage_AbortTransaction()
+{
+    size_t ns = AiaStorage_GetNamespace();
+    AiaStorageTransaction_t* transaction = AiaStorage_GetOpenTransaction( ns );
+    if( transaction )
     {
-        AiaLogError( "AiaLoadBlob failed" );
-        AiaFree( allAlertsBuffer );
-        return false;
+        g_aiaStorageTransactions.open[ ns ] = NULL;
+        AiaStorage_ReleaseTransaction( transaction );
+
+        /* The alert index may reflect staged alerts. */
+        AiaStorage_GetAlertIndex()->built = false;
+    }
+}
+
+#if AIA_STORAGE_NAMESPACES > 1
+
+/** @return The blob identifier holding the claim of namespace @c ns. */
+static AiaStorageBlobId_t AiaStorage_GetOwnerBlobId( size_t ns )
+{
+    return (AiaStorageBlobId_t)(
+        AIA_STORAGE_NAMESPACES * AIA_STORAGE_NUM_BLOBS + ns );
+}
+
+/**
+ * Loads the client identifier a namespace is claimed by.
+ *
+ * @param ns The namespace.
+ * @param[out] clientId Buffer of @c AIA_STORAGE_CLIENT_ID_CAPACITY bytes.
+ * @param[out] length Receives the length of the identifier, which is zero if
+ * @c ns is free.
+ * @return Why the load failed, if it did.
+ */
+static AiaStorageError_t AiaStorage_LoadOwner( size_t ns, uint8_t* clientId,
+                                               size_t* length )
+{
+    return AiaStorage_LoadBlob( AiaStorage_GetOwnerBlobId( ns ), clientId,
+                                AIA_STORAGE_CLIENT_ID_CAPACITY, length );
+}
+
+/**
+ * Fills the claims of @c g_aiaStorageNamespaces from storage if they have not
+ * been yet. A namespace whose claim is corrupted stays claimed, since its
+ * blobs belong to a client, but no client can select it any more. Called with
+ * @c g_aiaStorageNamespaces.mutex held.
+ *
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorage_LoadOwners()
+{
+    static uint8_t clientId[ AIA_STORAGE_CLIENT_ID_CAPACITY ];
+    if( g_aiaStorageNamespaces.loaded )
+    {
+        return true;
     }
 
-    /** Go through the tokens to find the first empty or matching one */
-    for( bytePosition = 0; bytePosition < allAlertsBytes;
-         bytePosition += AIA_SIZE_OF_ALERT_IN_BYTES )
+    for( size_t ns = 0; ns < AIA_STORAGE_NAMESPACES; ++ns )
     {
-        if( '\0' == allAlertsBuffer[ bytePosition ] )
+        size_t length = 0;
+        AiaStorageError_t error = AiaStorage_LoadOwner( ns, clientId, &length );
+        if( error == AIA_STORAGE_ERROR_CORRUPTED )
         {
-            /** Found an empty token */
-            break;
+            AiaLogError( "Corrupted namespace claim, namespace=%zu", ns );
+            g_aiaStorageNamespaces.claimed[ ns ] = true;
+            g_aiaStorageNamespaces.clientIdHash[ ns ] = 0;
+            continue;
         }
-        else
+        if( error != AIA_STORAGE_ERROR_NONE )
         {
-            /** Check if this token matches with what we are trying to delete */
-            if( !strncmp( (const char*)allAlertsBuffer + bytePosition,
-                          alertToken, alertTokenLen ) )
-            {
-                uint8_t* moveDst = allAlertsBuffer + bytePosition;
-                uint8_t* moveSrc =
-                    allAlertsBuffer + bytePosition + AIA_SIZE_OF_ALERT_IN_BYTES;
-                size_t moveBytes =
-                    allAlertsBytes -
-                    ( bytePosition + AIA_SIZE_OF_ALERT_IN_BYTES );
-                memmove( moveDst, moveSrc, moveBytes );
-                deletingExistingAlert = true;
-                break;
-            }
+            AiaLogError( "Failed to load namespace claim, namespace=%zu", ns );
+            return false;
         }
+        g_aiaStorageNamespaces.claimed[ ns ] = length != 0;
+        g_aiaStorageNamespaces.clientIdHash[ ns ] =
+            AiaStorage_Crc32c( 0, clientId, length );
     }
+    g_aiaStorageNamespaces.loaded = true;
+    return true;
+}
+
+/**
+ * @param ns A claimed namespace.
+ * @param clientId The client identifier to compare.
+ * @param length Length of @c clientId.
+ * @return Whether @c ns is claimed by @c clientId.
+ */
+static bool AiaStorage_OwnerMatches( size_t ns, const char* clientId,
+                                     size_t length )
+{
+    static uint8_t owner[ AIA_STORAGE_CLIENT_ID_CAPACITY ];
+    size_t ownerLength;
+    return AiaStorage_LoadOwner( ns, owner, &ownerLength ) ==
+               AIA_STORAGE_ERROR_NONE &&
+           ownerLength == length && !memcmp( owner, clientId, length );
+}
 
-    /** Store the new blob in persistent storage */
-    size_t storeSize =
-        ( deletingExistingAlert ? allAlertsBytes - AIA_SIZE_OF_ALERT_IN_BYTES
-                                : allAlertsBytes );
-    /** Store the new blob */
-    if( !AiaStoreBlob( AIA_ALL_ALERTS_STORAGE_KEY_V0, allAlertsBuffer,
-                       storeSize ) )
+/**
+ * Sets up @c g_aiaStorageNamespaces, if it is not yet, along with everything
+ * else the storage would start on first use, since clients may use the
+ * storage concurrently once they have selected their namespaces.
+ *
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorage_CreateNamespaces()
+{
+    if( g_aiaStorageNamespaces.created )
     {
-        AiaLogError( "AiaStoreBlob failed" );
-        AiaFree( allAlertsBuffer );
+        return true;
+    }
+#if AIA_STORAGE_WRITE_BEHIND
+    if( AiaStorage_StartFlushTask() && !g_aiaStorageVolume.timerCreated &&
+        !AiaStorage_CreateVolumeTimer() )
+    {
+        return false;
+    }
+#endif
+    if( !AiaStorage_CreateLock() )
+    {
+        return false;
+    }
+    if( !AiaMutex( Create )( &g_aiaStorageNamespaces.mutex, false ) )
+    {
+        AiaLogError( "AiaMutex( Create ) failed" );
         return false;
     }
+#if AIA_STORAGE_NAMESPACE_PTHREAD
+    if( pthread_key_create( &g_aiaStorageNamespaces.key, NULL ) != 0 )
+    {
+        AiaLogError( "pthread_key_create failed" );
+        AiaMutex( Destroy )( &g_aiaStorageNamespaces.mutex );
+        return false;
+    }
+#endif
+    g_aiaStorageNamespaces.created = true;
+    return true;
+}
 
-    AiaFree( allAlertsBuffer );
+/**
+ * Makes a namespace the one the blob functions act on for the calling task.
+ *
+ * @param ns The namespace.
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorage_EnterNamespace( size_t ns )
+{
+    void* selected = (void*)(uintptr_t)( ns + 1 );
+#if AIA_STORAGE_NAMESPACE_PTHREAD
+    if( pthread_setspecific( g_aiaStorageNamespaces.key, selected ) != 0 )
+    {
+        AiaLogError( "pthread_setspecific failed" );
+        return false;
+    }
+#else
+    vTaskSetThreadLocalStoragePointer( NULL, AIA_STORAGE_NAMESPACE_TLS_INDEX,
+                                       selected );
+#endif
+    AiaLogDebug( "Storage namespace selected, namespace=%zu", ns );
     return true;
 }
 
-bool AiaLoadAlert( char* alertToken, size_t alertTokenLen,
-                   AiaTimepointSeconds_t* scheduledTime,
-                   AiaDurationMs_t* duration, uint8_t* alertType,
-                   const uint8_t* allAlertsBuffer )
+/**
+ * Finds the namespace claimed by a client, claiming a free one for it if it
+ * has none yet. Called with @c g_aiaStorageNamespaces.mutex held.
+ *
+ * @param clientId The client identifier.
+ * @param length Length of @c clientId.
+ * @param[out] ns Receives the namespace.
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorage_ClaimNamespace( const char* clientId, size_t length,
+                                       size_t* ns )
 {
-    if( !alertToken )
+    if( !AiaStorage_LoadOwners() )
     {
-        AiaLogError( "Null alertToken" );
         return false;
     }
-    if( !scheduledTime )
+
+    uint32_t hash = AiaStorage_Crc32c( 0, clientId, length );
+    size_t unclaimed = AIA_STORAGE_NAMESPACES;
+    for( *ns = 0; *ns < AIA_STORAGE_NAMESPACES; ++*ns )
     {
-        AiaLogError( "Null scheduledTime" );
+        if( !g_aiaStorageNamespaces.claimed[ *ns ] )
+        {
+            unclaimed = unclaimed == AIA_STORAGE_NAMESPACES ? *ns : unclaimed;
+        }
+        else if( g_aiaStorageNamespaces.clientIdHash[ *ns ] == hash &&
+                 AiaStorage_OwnerMatches( *ns, clientId, length ) )
+        {
+            return true;
+        }
+    }
+    if( unclaimed == AIA_STORAGE_NAMESPACES )
+    {
+        AiaLogError( "No free storage namespace, namespaces=%zu",
+                     (size_t)AIA_STORAGE_NAMESPACES );
         return false;
     }
-    if( !duration )
+
+    if( !AiaStorage_WriteBlob( AiaStorage_GetOwnerBlobId( unclaimed ),
+                               (const uint8_t*)clientId, length ) )
     {
-        AiaLogError( "Null duration" );
+        AiaLogError( "Failed to claim namespace, namespace=%zu", unclaimed );
         return false;
     }
-    if( !alertType )
+    g_aiaStorageNamespaces.claimed[ unclaimed ] = true;
+    g_aiaStorageNamespaces.clientIdHash[ unclaimed ] = hash;
+    *ns = unclaimed;
+    return true;
+}
+
+#endif /* AIA_STORAGE_NAMESPACES > 1 */
+
+bool AiaStorage_SelectNamespace( const char* clientId )
+{
+#if AIA_STORAGE_NAMESPACES > 1
+    if( !clientId )
     {
-        AiaLogError( "Null alertType" );
+        AiaLogError( "Null clientId" );
         return false;
     }
-    if( !allAlertsBuffer )
+    size_t length = strlen( clientId );
+    if( !length || length > AIA_STORAGE_CLIENT_ID_CAPACITY )
     {
-        AiaLogError( "Null allAlertsBuffer" );
+        AiaLogError( "Invalid client id length, length=%zu", length );
         return false;
     }
-    if( alertTokenLen != AIA_ALERT_TOKEN_CHARS )
+    if( !AiaStorage_CreateNamespaces() )
     {
-        AiaLogError( "Invalid alert token length" );
         return false;
     }
 
-    size_t bytePosition = 0;
-    *scheduledTime = 0;
-    *duration = 0;
-    *alertType = 0;
-
-    memcpy( alertToken, allAlertsBuffer, alertTokenLen );
-    bytePosition += alertTokenLen;
+    size_t ns;
+    AiaMutex( Lock )( &g_aiaStorageNamespaces.mutex );
+    bool claimed = AiaStorage_ClaimNamespace( clientId, length, &ns );
+    AiaMutex( Unlock )( &g_aiaStorageNamespaces.mutex );
+    return claimed && AiaStorage_EnterNamespace( ns );
+#else
+    (void)clientId;
+    return true;
+#endif
+}
 
-    for( size_t i = 0; i < sizeof( AiaTimepointSeconds_t );
-         ++i, ++bytePosition )
+bool AiaStorage_Flush()
+{
+    if( g_aiaStorageVolume.timerCreated )
     {
-        *scheduledTime |= (unsigned)allAlertsBuffer[ bytePosition ]
-                          << ( i * 8 );
+        AiaStorage_FlushVolume( true );
     }
 
-    for( size_t i = 0; i < sizeof( AiaDurationMs_t ); ++i, ++bytePosition )
+#if AIA_STORAGE_WRITE_BEHIND
+    if( !g_aiaStorageQueue.started )
     {
-        *duration |= (unsigned)allAlertsBuffer[ bytePosition ] << ( i * 8 );
+        return true;
     }
 
-    for( size_t i = 0; i < sizeof( uint8_t ); ++i, ++bytePosition )
+    AiaStorage_Lock();
+    size_t views = g_aiaStorageViews.outstanding[ AiaStorage_GetNamespace() ];
+    AiaStorage_Unlock();
+    if( views )
     {
-        *alertType |= (unsigned)allAlertsBuffer[ bytePosition ] << ( i * 8 );
+        AiaLogError( "Cannot flush while blob views are borrowed, views=%zu",
+                     views );
+        return false;
     }
 
-    return true;
-}
-
-bool AiaLoadAlerts( uint8_t* allAlerts, size_t size )
-{
-    if( !AiaAlertsBlobExists() )
+    AiaMutex( Lock )( &g_aiaStorageQueue.mutex );
+    size_t failures = g_aiaStorageQueue.failures;
+    AiaMutex( Unlock )( &g_aiaStorageQueue.mutex );
+    for( bool first = true;; first = false )
     {
-        if( size != 0 )
+        AiaMutex( Lock )( &g_aiaStorageQueue.mutex );
+        size_t queued = g_aiaStorageQueue.area.count;
+        bool failing = g_aiaStorageQueue.failures != failures;
+        AiaMutex( Unlock )( &g_aiaStorageQueue.mutex );
+        if( ( !queued || failing ) && !first )
         {
-            AiaLogError( "Alerts blob with size %zu does not exist", size );
-            return false;
+            AiaSemaphore( Post )( &g_aiaStorageQueue.progress );
         }
-        else
+        if( !queued )
         {
             return true;
         }
-    }
-    else
-    {
-        return AiaLoadBlob( AIA_ALL_ALERTS_STORAGE_KEY_V0, allAlerts, size );
-    }
-}
-
-size_t AiaGetAlertsSize()
-{
-    return AiaGetBlobSize( AIA_ALL_ALERTS_STORAGE_KEY_V0 );
-}
+        if( failing )
+        {
+            AiaLogError( "Failed to flush storage, blobs=%zu", queued );
+            return false;
+        }
 
-bool AiaAlertsBlobExists()
-{
-    return AiaBlobExists( AIA_ALL_ALERTS_STORAGE_KEY_V0 );
+        AiaSemaphore( Post )( &g_aiaStorageQueue.wake );
+        if( !AiaSemaphore( TimedWait )( &g_aiaStorageQueue.progress,
+                                        AIA_STORAGE_WRITE_BEHIND_TIMEOUT_MS ) )
+        {
+            AiaLogError( "Timed out flushing storage, blobs=%zu", queued );
+            return false;
+        }
+    }
+#else
+    return true;
+#endif
 }
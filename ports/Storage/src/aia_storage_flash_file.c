@@ -0,0 +1,176 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file aia_storage_flash_file.c
+ * @brief Implements the flash device of @c aia_storage_flash.h over an image
+ * file, for testing the log-structured storage backend on a host.
+ */
+
+#include <storage/aia_storage_flash.h>
+
+#if AIA_STORAGE_FLASH_FILE
+
+#include <aia_config.h>
+
+#include <stdio.h>
+
+/** Size of the whole device. */
+#define AIA_STORAGE_FLASH_SIZE \
+    ( (size_t)AIA_STORAGE_FLASH_BLOCK_SIZE * AIA_STORAGE_FLASH_NUM_BLOCKS )
+
+extern const char* g_aiaStorageFolder;
+
+/** The image file, opened on first use. */
+static FILE* g_aiaStorageFlashFile;
+
+/**
+ * Opens the image file, creating an erased image if there is none yet.
+ *
+ * @return The file, or @c NULL on failure.
+ */
+static FILE* AiaStorageFlash_GetFile()
+{
+    char path[ 256 ];
+    uint8_t erased[ 256 ];
+
+    if( g_aiaStorageFlashFile )
+    {
+        return g_aiaStorageFlashFile;
+    }
+
+    int length =
+        g_aiaStorageFolder
+            ? snprintf( path, sizeof( path ), "%s/%s", g_aiaStorageFolder,
+                        AIA_STORAGE_FLASH_FILE_NAME )
+            : snprintf( path, sizeof( path ), "%s",
+                        AIA_STORAGE_FLASH_FILE_NAME );
+    if( length < 0 || (size_t)length >= sizeof( path ) )
+    {
+        AiaLogError( "Flash image path too long" );
+        return NULL;
+    }
+
+    g_aiaStorageFlashFile = fopen( path, "r+b" );
+    if( g_aiaStorageFlashFile )
+    {
+        return g_aiaStorageFlashFile;
+    }
+
+    g_aiaStorageFlashFile = fopen( path, "w+b" );
+    if( !g_aiaStorageFlashFile )
+    {
+        AiaLogError( "Failed to create flash image %s", path );
+        return NULL;
+    }
+    memset( erased, 0xFF, sizeof( erased ) );
+    for( size_t done = 0; done < AIA_STORAGE_FLASH_SIZE;
+         done += sizeof( erased ) )
+    {
+        size_t n = AIA_STORAGE_FLASH_SIZE - done < sizeof( erased )
+                       ? AIA_STORAGE_FLASH_SIZE - done
+                       : sizeof( erased );
+        if( fwrite( erased, 1, n, g_aiaStorageFlashFile ) != n )
+        {
+            AiaLogError( "Failed to initialize flash image %s", path );
+            fclose( g_aiaStorageFlashFile );
+            g_aiaStorageFlashFile = NULL;
+            return NULL;
+        }
+    }
+    fflush( g_aiaStorageFlashFile );
+    return g_aiaStorageFlashFile;
+}
+
+bool AiaStorageFlash_Read( size_t offset, void* data, size_t size )
+{
+    FILE* file = AiaStorageFlash_GetFile();
+    if( !file || offset > AIA_STORAGE_FLASH_SIZE ||
+        size > AIA_STORAGE_FLASH_SIZE - offset )
+    {
+        return false;
+    }
+    return fseek( file, (long)offset, SEEK_SET ) == 0 &&
+           fread( data, 1, size, file ) == size;
+}
+
+bool AiaStorageFlash_Program( size_t offset, const void* data, size_t size )
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint8_t current[ 64 ];
+
+    if( offset % AIA_STORAGE_FLASH_PROGRAM_SIZE ||
+        size % AIA_STORAGE_FLASH_PROGRAM_SIZE )
+    {
+        AiaLogError( "Unaligned program, offset=%zu, size=%zu", offset, size );
+        return false;
+    }
+
+    /* Like NOR flash, programming can only clear bits. */
+    for( size_t done = 0; done < size; done += sizeof( current ) )
+    {
+        size_t n =
+            size - done < sizeof( current ) ? size - done : sizeof( current );
+        if( !AiaStorageFlash_Read( offset + done, current, n ) )
+        {
+            return false;
+        }
+        for( size_t i = 0; i < n; ++i )
+        {
+            if( ( current[ i ] & bytes[ done + i ] ) != bytes[ done + i ] )
+            {
+                AiaLogError( "Programming unerased byte, offset=%zu",
+                             offset + done + i );
+                return false;
+            }
+        }
+        if( fseek( g_aiaStorageFlashFile, (long)( offset + done ),
+                   SEEK_SET ) != 0 ||
+            fwrite( bytes + done, 1, n, g_aiaStorageFlashFile ) != n )
+        {
+            return false;
+        }
+    }
+    return fflush( g_aiaStorageFlashFile ) == 0;
+}
+
+bool AiaStorageFlash_Erase( size_t block )
+{
+    FILE* file = AiaStorageFlash_GetFile();
+    uint8_t erased[ 256 ];
+
+    if( !file || block >= AIA_STORAGE_FLASH_NUM_BLOCKS ||
+        fseek( file, (long)( block * AIA_STORAGE_FLASH_BLOCK_SIZE ),
+               SEEK_SET ) != 0 )
+    {
+        return false;
+    }
+    memset( erased, 0xFF, sizeof( erased ) );
+    for( size_t done = 0; done < AIA_STORAGE_FLASH_BLOCK_SIZE;
+         done += sizeof( erased ) )
+    {
+        size_t n = AIA_STORAGE_FLASH_BLOCK_SIZE - done < sizeof( erased )
+                       ? AIA_STORAGE_FLASH_BLOCK_SIZE - done
+                       : sizeof( erased );
+        if( fwrite( erased, 1, n, file ) != n )
+        {
+            return false;
+        }
+    }
+    return fflush( file ) == 0;
+}
+
+#endif
@@ -0,0 +1,982 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file aia_storage_log.c
+ * @brief Implements the log-structured storage backend of @c
+ * aia_storage_backend.h.
+ */
+
+#include <storage/aia_storage_backend.h>
+
+#if AIA_STORAGE_BACKEND == AIA_STORAGE_BACKEND_LOG
+
+#include <aia_config.h>
+
+#include <storage/aia_storage_crc.h>
+#include <storage/aia_storage_flash.h>
+
+/**
+ * @name On-flash layout.
+ *
+ * Each block starts with a header of a magic number and the block's sequence
+ * number. Records follow at @c AIA_STORAGE_LOG_ALIGNMENT byte boundaries, each
+ * a header of the blob identifier, a flags byte, the data length and a CRC-32C
+ * followed by the data. All fields are little endian. The checksum covers the
+ * identifier, the length and the data but not the flags, which are left at
+ * @c 0xFF so that bits can later be cleared in place.
+ *
+ * The records of a transaction are written with @c
+ * AIA_STORAGE_LOG_FLAG_COMMITTED cleared and followed by an empty record with
+ * the identifier @c AIA_STORAGE_LOG_COMMIT_ID, all in the same block. Replay
+ * only applies them once it reaches that commit record.
+ */
+/** @{ */
+
+#define AIA_STORAGE_LOG_MAGIC ( (uint32_t)0x4C414941 )
+#define AIA_STORAGE_LOG_BLOCK_HEADER_SIZE 8
+#define AIA_STORAGE_LOG_RECORD_HEADER_SIZE 8
+#define AIA_STORAGE_LOG_ALIGNMENT 8
+#define AIA_STORAGE_LOG_FLAG_COMMITTED 0x01
+#define AIA_STORAGE_LOG_COMMIT_ID 0xFE
+#define AIA_STORAGE_LOG_ALIGN( size )                   \
+    ( ( ( size ) + AIA_STORAGE_LOG_ALIGNMENT - 1 ) & \
+      ~(size_t)( AIA_STORAGE_LOG_ALIGNMENT - 1 ) )
+
+/** @} */
+
+/** Largest record that fits in an empty block. */
+#define AIA_STORAGE_LOG_MAX_RECORD_SIZE \
+    ( AIA_STORAGE_FLASH_BLOCK_SIZE - AIA_STORAGE_LOG_BLOCK_HEADER_SIZE )
+
+/** Size of the buffer records are streamed through. */
+#define AIA_STORAGE_LOG_CHUNK_SIZE 64
+
+/** Offset of a blob that has no record. */
+#define AIA_STORAGE_LOG_NO_RECORD ( (size_t)-1 )
+
+typedef char aia_storage_log_program_size_is_valid
+    [ AIA_STORAGE_FLASH_PROGRAM_SIZE <= AIA_STORAGE_LOG_ALIGNMENT &&
+              AIA_STORAGE_LOG_ALIGNMENT % AIA_STORAGE_FLASH_PROGRAM_SIZE == 0
+          ? 1
+          : -1 ];
+typedef char aia_storage_log_has_reserve_block
+    [ AIA_STORAGE_FLASH_NUM_BLOCKS >= 2 ? 1 : -1 ];
+typedef char aia_storage_log_block_size_is_aligned
+    [ AIA_STORAGE_FLASH_BLOCK_SIZE % AIA_STORAGE_LOG_ALIGNMENT == 0 ? 1 : -1 ];
+/* Record identifiers are one byte and @c 0xFF reads as erased flash, which
+ * bounds AIA_STORAGE_NAMESPACES as documented in aia_storage_config.h. */
+typedef char aia_storage_log_blob_ids_fit
+    [ AIA_STORAGE_BACKEND_NUM_BLOBS < AIA_STORAGE_LOG_COMMIT_ID ? 1 : -1 ];
+/* A transaction rewriting every alert slot fits in one block. */
+typedef char aia_storage_log_alert_slots_fit
+    [ AIA_STORAGE_ALERT_SLOTS *
+                      AIA_STORAGE_LOG_ALIGN(
+                          AIA_STORAGE_LOG_RECORD_HEADER_SIZE +
+                          AIA_STORAGE_ALERT_RECORD_SIZE ) +
+                  AIA_STORAGE_LOG_RECORD_HEADER_SIZE <=
+              AIA_STORAGE_LOG_MAX_RECORD_SIZE
+          ? 1
+          : -1 ];
+
+/** Outcome of reading a record. */
+typedef enum AiaStorageLogRecordStatus
+{
+    /** A complete record. */
+    AIA_STORAGE_LOG_RECORD_VALID,
+
+    /** Erased flash, so the end of the block's records. */
+    AIA_STORAGE_LOG_RECORD_END,
+
+    /** A complete record whose checksum does not match its data. */
+    AIA_STORAGE_LOG_RECORD_DAMAGED,
+
+    /** A record that cannot be read or framed. */
+    AIA_STORAGE_LOG_RECORD_INVALID
+} AiaStorageLogRecordStatus_t;
+
+/** Location of the latest record of a blob. */
+typedef struct AiaStorageLogEntry
+{
+    /** Offset of the record header from the start of the device. */
+    size_t offset;
+
+    /** Length of the record's data. */
+    size_t length;
+} AiaStorageLogEntry_t;
+
+/** State of the log, rebuilt from flash on first use. */
+static struct
+{
+    /** Whether the log has been replayed from flash. */
+    bool mounted;
+
+    /** Sequence number of each block, or @c 0 for a free block. */
+    uint32_t blockSeq[ AIA_STORAGE_FLASH_NUM_BLOCKS ];
+
+    /** Whether each free block has been erased since the log was mounted. */
+    bool erased[ AIA_STORAGE_FLASH_NUM_BLOCKS ];
+
+    /** Highest sequence number handed out. */
+    uint32_t maxSeq;
+
+    /** Block records are appended to. */
+    size_t activeBlock;
+
+    /** Offset within @c activeBlock of the next record. */
+    size_t head;
+
+    /** Latest record of each blob. */
+    AiaStorageLogEntry_t index[ AIA_STORAGE_BACKEND_NUM_BLOBS ];
+} g_aiaStorageLog;
+
+static void AiaStorageLog_PutU16( uint8_t* bytes, uint16_t value )
+{
+    bytes[ 0 ] = (uint8_t)value;
+    bytes[ 1 ] = (uint8_t)( value >> 8 );
+}
+
+static void AiaStorageLog_PutU32( uint8_t* bytes, uint32_t value )
+{
+    for( size_t i = 0; i < sizeof( value ); ++i )
+    {
+        bytes[ i ] = (uint8_t)( value >> ( i * 8 ) );
+    }
+}
+
+static uint16_t AiaStorageLog_GetU16( const uint8_t* bytes )
+{
+    return (uint16_t)( bytes[ 0 ] | ( bytes[ 1 ] << 8 ) );
+}
+
+static uint32_t AiaStorageLog_GetU32( const uint8_t* bytes )
+{
+    return (uint32_t)bytes[ 0 ] | ( (uint32_t)bytes[ 1 ] << 8 ) |
+           ( (uint32_t)bytes[ 2 ] << 16 ) | ( (uint32_t)bytes[ 3 ] << 24 );
+}
+
+/**
+ * Starts the checksum of a record from the fields of its header it covers.
+ *
+ * @param header The record header.
+ * @return The checksum, to be continued over the record's data.
+ */
+static uint32_t AiaStorageLog_HeaderCrc( const uint8_t* header )
+{
+    uint32_t crc = AiaStorage_Crc32c( 0, header, 1 );
+    return AiaStorage_Crc32c( crc, header + 2, 2 );
+}
+
+/**
+ * Programs @c size bytes of @c data, padding the last program unit with
+ * @c 0xFF.
+ */
+static bool AiaStorageLog_Program( size_t offset, const uint8_t* data,
+                                   size_t size )
+{
+    size_t whole = size & ~(size_t)( AIA_STORAGE_FLASH_PROGRAM_SIZE - 1 );
+    if( whole && !AiaStorageFlash_Program( offset, data, whole ) )
+    {
+        return false;
+    }
+    if( whole < size )
+    {
+        uint8_t tail[ AIA_STORAGE_FLASH_PROGRAM_SIZE ];
+        memset( tail, 0xFF, sizeof( tail ) );
+        memcpy( tail, data + whole, size - whole );
+        return AiaStorageFlash_Program( offset + whole, tail, sizeof( tail ) );
+    }
+    return true;
+}
+
+/**
+ * Reads the record at @c offset within @c block and verifies its checksum.
+ *
+ * @param block The block to read from.
+ * @param offset Offset of the record within @c block.
+ * @param[out] id The record's blob identifier, or @c AIA_STORAGE_LOG_COMMIT_ID.
+ * @param[out] flags The record's flags.
+ * @param[out] length Length of the record's data.
+ * @return The status of the record.
+ */
+static AiaStorageLogRecordStatus_t AiaStorageLog_ReadRecord(
+    size_t block, size_t offset, size_t* id, uint8_t* flags, size_t* length )
+{
+    uint8_t header[ AIA_STORAGE_LOG_RECORD_HEADER_SIZE ];
+    uint8_t chunk[ AIA_STORAGE_LOG_CHUNK_SIZE ];
+    size_t start = block * AIA_STORAGE_FLASH_BLOCK_SIZE + offset;
+
+    if( offset + sizeof( header ) > AIA_STORAGE_FLASH_BLOCK_SIZE )
+    {
+        return AIA_STORAGE_LOG_RECORD_END;
+    }
+    if( !AiaStorageFlash_Read( start, header, sizeof( header ) ) )
+    {
+        return AIA_STORAGE_LOG_RECORD_INVALID;
+    }
+
+    bool erased = true;
+    for( size_t i = 0; i < sizeof( header ); ++i )
+    {
+        erased = erased && header[ i ] == 0xFF;
+    }
+    if( erased )
+    {
+        return AIA_STORAGE_LOG_RECORD_END;
+    }
+
+    *id = header[ 0 ];
+    *flags = header[ 1 ];
+    *length = AiaStorageLog_GetU16( header + 2 );
+    if( ( *id >= AIA_STORAGE_BACKEND_NUM_BLOBS &&
+          *id != AIA_STORAGE_LOG_COMMIT_ID ) ||
+        offset + sizeof( header ) + *length > AIA_STORAGE_FLASH_BLOCK_SIZE )
+    {
+        return AIA_STORAGE_LOG_RECORD_INVALID;
+    }
+
+    uint32_t crc = AiaStorageLog_HeaderCrc( header );
+    for( size_t done = 0; done < *length; )
+    {
+        size_t n = *length - done;
+        if( n > sizeof( chunk ) )
+        {
+            n = sizeof( chunk );
+        }
+        if( !AiaStorageFlash_Read( start + sizeof( header ) + done, chunk,
+                                   n ) )
+        {
+            return AIA_STORAGE_LOG_RECORD_INVALID;
+        }
+        crc = AiaStorage_Crc32c( crc, chunk, n );
+        done += n;
+    }
+    return crc == AiaStorageLog_GetU32( header + 4 )
+               ? AIA_STORAGE_LOG_RECORD_VALID
+               : AIA_STORAGE_LOG_RECORD_DAMAGED;
+}
+
+/**
+ * Tells whether a valid record follows @c offset within @c block, possibly
+ * after more damaged ones. Only the last record of a block can be torn, so
+ * damaged records followed by a valid one were complete when written.
+ *
+ * @param block The block to read from.
+ * @param offset Offset within @c block past a damaged record.
+ * @return @c true if a valid record follows or @c false otherwise.
+ */
+static bool AiaStorageLog_IsFollowed( size_t block, size_t offset )
+{
+    for( ;; )
+    {
+        size_t id;
+        uint8_t flags;
+        size_t length;
+        switch(
+            AiaStorageLog_ReadRecord( block, offset, &id, &flags, &length ) )
+        {
+            case AIA_STORAGE_LOG_RECORD_VALID:
+                return true;
+            case AIA_STORAGE_LOG_RECORD_DAMAGED:
+                offset += AIA_STORAGE_LOG_ALIGN(
+                    AIA_STORAGE_LOG_RECORD_HEADER_SIZE + length );
+                break;
+            case AIA_STORAGE_LOG_RECORD_END:
+            case AIA_STORAGE_LOG_RECORD_INVALID:
+                return false;
+        }
+    }
+}
+
+/**
+ * Indexes the records of a block.
+ *
+ * @param block The block to scan.
+ * @return Offset within @c block past its last record, or the block size if
+ * the block ends in a torn record or an unfinished transaction and must not be
+ * appended to.
+ */
+static size_t AiaStorageLog_ScanBlock( size_t block )
+{
+    /* Records of the transaction being read, applied at its commit record. */
+    size_t pendingIds[ AIA_STORAGE_TRANSACTION_MAX_BLOBS ];
+    AiaStorageLogEntry_t pending[ AIA_STORAGE_TRANSACTION_MAX_BLOBS ];
+    size_t numPending = 0;
+    bool inTransaction = false;
+
+    size_t offset = AIA_STORAGE_LOG_BLOCK_HEADER_SIZE;
+    for( ;; )
+    {
+        size_t id;
+        uint8_t flags;
+        size_t length;
+        AiaStorageLogRecordStatus_t status =
+            AiaStorageLog_ReadRecord( block, offset, &id, &flags, &length );
+        if( status == AIA_STORAGE_LOG_RECORD_DAMAGED &&
+            AiaStorageLog_IsFollowed(
+                block, offset + AIA_STORAGE_LOG_ALIGN(
+                                    AIA_STORAGE_LOG_RECORD_HEADER_SIZE +
+                                    length ) ) )
+        {
+            /* Indexed all the same, so that loading it reports the damage
+             * instead of an older record or none being returned. */
+            AiaLogError( "Corrupted record, block=%zu, offset=%zu", block,
+                         offset );
+            status = AIA_STORAGE_LOG_RECORD_VALID;
+        }
+        switch( status )
+        {
+            case AIA_STORAGE_LOG_RECORD_VALID:
+                if( id == AIA_STORAGE_LOG_COMMIT_ID )
+                {
+                    for( size_t i = 0; i < numPending; ++i )
+                    {
+                        g_aiaStorageLog.index[ pendingIds[ i ] ] = pending[ i ];
+                    }
+                    numPending = 0;
+                    inTransaction = false;
+                }
+                else if( !( flags & AIA_STORAGE_LOG_FLAG_COMMITTED ) )
+                {
+                    if( numPending == AIA_STORAGE_TRANSACTION_MAX_BLOBS )
+                    {
+                        AiaLogWarn( "Oversized transaction, block=%zu", block );
+                        return AIA_STORAGE_FLASH_BLOCK_SIZE;
+                    }
+                    pendingIds[ numPending ] = id;
+                    pending[ numPending ].offset =
+                        block * AIA_STORAGE_FLASH_BLOCK_SIZE + offset;
+                    pending[ numPending ].length = length;
+                    ++numPending;
+                    inTransaction = true;
+                }
+                else if( inTransaction )
+                {
+                    AiaLogWarn( "Unfinished transaction, block=%zu", block );
+                    return AIA_STORAGE_FLASH_BLOCK_SIZE;
+                }
+                else
+                {
+                    g_aiaStorageLog.index[ id ].offset =
+                        block * AIA_STORAGE_FLASH_BLOCK_SIZE + offset;
+                    g_aiaStorageLog.index[ id ].length = length;
+                }
+                offset += AIA_STORAGE_LOG_ALIGN(
+                    AIA_STORAGE_LOG_RECORD_HEADER_SIZE + length );
+                break;
+            case AIA_STORAGE_LOG_RECORD_END:
+                if( inTransaction )
+                {
+                    /* Appending after the dropped records would later commit
+                     * them, so the block is sealed. */
+                    AiaLogWarn( "Unfinished transaction, block=%zu", block );
+                    return AIA_STORAGE_FLASH_BLOCK_SIZE;
+                }
+                return offset;
+            case AIA_STORAGE_LOG_RECORD_DAMAGED:
+            case AIA_STORAGE_LOG_RECORD_INVALID:
+                AiaLogWarn( "Torn record, block=%zu, offset=%zu", block,
+                            offset );
+                return AIA_STORAGE_FLASH_BLOCK_SIZE;
+        }
+    }
+}
+
+/**
+ * Erases a free block, unless that was done when it was freed, and makes it
+ * the active block.
+ *
+ * @param block The block to open.
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorageLog_OpenBlock( size_t block )
+{
+    uint8_t header[ AIA_STORAGE_LOG_BLOCK_HEADER_SIZE ];
+    uint32_t seq = g_aiaStorageLog.maxSeq + 1;
+
+    if( !g_aiaStorageLog.erased[ block ] && !AiaStorageFlash_Erase( block ) )
+    {
+        AiaLogError( "AiaStorageFlash_Erase failed, block=%zu", block );
+        return false;
+    }
+    g_aiaStorageLog.erased[ block ] = false;
+    AiaStorageLog_PutU32( header, AIA_STORAGE_LOG_MAGIC );
+    AiaStorageLog_PutU32( header + 4, seq );
+    if( !AiaStorageFlash_Program( block * AIA_STORAGE_FLASH_BLOCK_SIZE, header,
+                                  sizeof( header ) ) )
+    {
+        AiaLogError( "AiaStorageFlash_Program failed, block=%zu", block );
+        return false;
+    }
+
+    g_aiaStorageLog.maxSeq = seq;
+    g_aiaStorageLog.blockSeq[ block ] = seq;
+    g_aiaStorageLog.activeBlock = block;
+    g_aiaStorageLog.head = AIA_STORAGE_LOG_BLOCK_HEADER_SIZE;
+    return true;
+}
+
+/**
+ * @return The number of free blocks, and in @c freeBlock the first of them
+ * after the active block, wrapping around, if there are any. Taking blocks in
+ * turn this way spreads erases evenly over the device.
+ */
+static size_t AiaStorageLog_CountFree( size_t* freeBlock )
+{
+    size_t count = 0;
+    for( size_t i = 1; i <= AIA_STORAGE_FLASH_NUM_BLOCKS; ++i )
+    {
+        size_t block =
+            ( g_aiaStorageLog.activeBlock + i ) % AIA_STORAGE_FLASH_NUM_BLOCKS;
+        if( !g_aiaStorageLog.blockSeq[ block ] )
+        {
+            if( !count )
+            {
+                *freeBlock = block;
+            }
+            ++count;
+        }
+    }
+    return count;
+}
+
+/** Replays the log from flash if that has not been done yet. */
+static bool AiaStorageLog_Mount()
+{
+    if( g_aiaStorageLog.mounted )
+    {
+        return true;
+    }
+
+    memset( &g_aiaStorageLog, 0, sizeof( g_aiaStorageLog ) );
+    for( size_t id = 0; id < AIA_STORAGE_BACKEND_NUM_BLOBS; ++id )
+    {
+        g_aiaStorageLog.index[ id ].offset = AIA_STORAGE_LOG_NO_RECORD;
+    }
+
+    for( size_t block = 0; block < AIA_STORAGE_FLASH_NUM_BLOCKS; ++block )
+    {
+        uint8_t header[ AIA_STORAGE_LOG_BLOCK_HEADER_SIZE ];
+        if( !AiaStorageFlash_Read( block * AIA_STORAGE_FLASH_BLOCK_SIZE,
+                                   header, sizeof( header ) ) )
+        {
+            AiaLogError( "AiaStorageFlash_Read failed, block=%zu", block );
+            return false;
+        }
+        uint32_t seq = AiaStorageLog_GetU32( header + 4 );
+        if( AiaStorageLog_GetU32( header ) == AIA_STORAGE_LOG_MAGIC &&
+            seq != 0 && seq != UINT32_MAX )
+        {
+            g_aiaStorageLog.blockSeq[ block ] = seq;
+        }
+    }
+
+    /* Replay blocks oldest first so that later records win. */
+    for( uint32_t lastSeq = 0;; )
+    {
+        size_t next = AIA_STORAGE_FLASH_NUM_BLOCKS;
+        for( size_t block = 0; block < AIA_STORAGE_FLASH_NUM_BLOCKS; ++block )
+        {
+            uint32_t seq = g_aiaStorageLog.blockSeq[ block ];
+            if( seq > lastSeq &&
+                ( next == AIA_STORAGE_FLASH_NUM_BLOCKS ||
+                  seq < g_aiaStorageLog.blockSeq[ next ] ) )
+            {
+                next = block;
+            }
+        }
+        if( next == AIA_STORAGE_FLASH_NUM_BLOCKS )
+        {
+            break;
+        }
+        lastSeq = g_aiaStorageLog.blockSeq[ next ];
+        g_aiaStorageLog.maxSeq = lastSeq;
+        g_aiaStorageLog.activeBlock = next;
+        g_aiaStorageLog.head = AiaStorageLog_ScanBlock( next );
+    }
+
+    if( !g_aiaStorageLog.maxSeq && !AiaStorageLog_OpenBlock( 0 ) )
+    {
+        return false;
+    }
+
+    /* Only a relocation into the reserve leaves no block free, and the source
+     * is only erased once every record has been copied, so the newest block
+     * holds nothing but copies. It may end in a torn one and could then never
+     * be appended to or reclaimed, so it is dropped and the relocation will be
+     * redone. */
+    size_t freeBlock;
+    if( !AiaStorageLog_CountFree( &freeBlock ) )
+    {
+        AiaLogWarn( "Interrupted relocation, block=%zu",
+                    g_aiaStorageLog.activeBlock );
+        if( !AiaStorageFlash_Erase( g_aiaStorageLog.activeBlock ) )
+        {
+            AiaLogError( "AiaStorageFlash_Erase failed, block=%zu",
+                         g_aiaStorageLog.activeBlock );
+            return false;
+        }
+        return AiaStorageLog_Mount();
+    }
+
+    g_aiaStorageLog.mounted = true;
+    return true;
+}
+
+/**
+ * @param block The block to query.
+ * @return Bytes taken in @c block by records that are still current.
+ */
+static size_t AiaStorageLog_LiveBytes( size_t block )
+{
+    size_t live = 0;
+    for( size_t id = 0; id < AIA_STORAGE_BACKEND_NUM_BLOBS; ++id )
+    {
+        const AiaStorageLogEntry_t* entry = &g_aiaStorageLog.index[ id ];
+        if( entry->offset != AIA_STORAGE_LOG_NO_RECORD &&
+            entry->offset / AIA_STORAGE_FLASH_BLOCK_SIZE == block )
+        {
+            live += AIA_STORAGE_LOG_ALIGN( AIA_STORAGE_LOG_RECORD_HEADER_SIZE +
+                                           entry->length );
+        }
+    }
+    return live;
+}
+
+/**
+ * @param block A block in use.
+ * @return Whether no other block on flash is older than @c block, counting
+ * free blocks that still hold their records, so that the records superseded
+ * by those of @c block are all in @c block itself.
+ */
+static bool AiaStorageLog_IsOldestBlock( size_t block )
+{
+    for( size_t other = 0; other < AIA_STORAGE_FLASH_NUM_BLOCKS; ++other )
+    {
+        uint32_t seq = g_aiaStorageLog.blockSeq[ other ];
+        if( other == block )
+        {
+            continue;
+        }
+        if( !seq )
+        {
+            uint8_t header[ AIA_STORAGE_LOG_BLOCK_HEADER_SIZE ];
+            if( !AiaStorageFlash_Read( other * AIA_STORAGE_FLASH_BLOCK_SIZE,
+                                       header, sizeof( header ) ) )
+            {
+                return false;
+            }
+            if( AiaStorageLog_GetU32( header ) == AIA_STORAGE_LOG_MAGIC )
+            {
+                seq = AiaStorageLog_GetU32( header + 4 );
+            }
+        }
+        if( seq && seq != UINT32_MAX &&
+            seq < g_aiaStorageLog.blockSeq[ block ] )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Copies the current records of @c block to the head of the active block,
+ * which must have room for them, and erases @c block. Tombstones are dropped
+ * instead when erasing @c block leaves nothing for them to hide.
+ */
+static bool AiaStorageLog_Relocate( size_t block )
+{
+    uint8_t chunk[ AIA_STORAGE_LOG_CHUNK_SIZE ];
+    bool dropTombstones = AiaStorageLog_IsOldestBlock( block );
+    for( size_t id = 0; id < AIA_STORAGE_BACKEND_NUM_BLOBS; ++id )
+    {
+        AiaStorageLogEntry_t* entry = &g_aiaStorageLog.index[ id ];
+        if( entry->offset == AIA_STORAGE_LOG_NO_RECORD ||
+            entry->offset / AIA_STORAGE_FLASH_BLOCK_SIZE != block )
+        {
+            continue;
+        }
+
+        if( dropTombstones && !entry->length &&
+            AiaStorage_IsAlertSlot( (AiaStorageBlobId_t)id ) )
+        {
+            entry->offset = AIA_STORAGE_LOG_NO_RECORD;
+            continue;
+        }
+
+        /* Padding is still erased, so the aligned size can be copied as is. */
+        size_t size = AIA_STORAGE_LOG_ALIGN(
+            AIA_STORAGE_LOG_RECORD_HEADER_SIZE + entry->length );
+        size_t to = g_aiaStorageLog.activeBlock * AIA_STORAGE_FLASH_BLOCK_SIZE +
+                    g_aiaStorageLog.head;
+        for( size_t done = 0; done < size; done += sizeof( chunk ) )
+        {
+            size_t n = size - done < sizeof( chunk ) ? size - done
+                                                     : sizeof( chunk );
+            if( !AiaStorageFlash_Read( entry->offset + done, chunk, n ) )
+            {
+                AiaLogError( "Failed to relocate record, id=%zu", id );
+                g_aiaStorageLog.head = AIA_STORAGE_FLASH_BLOCK_SIZE;
+                return false;
+            }
+
+            /* The copy stands on its own, outside of any transaction. */
+            if( !done )
+            {
+                chunk[ 1 ] = 0xFF;
+            }
+            if( !AiaStorageFlash_Program( to + done, chunk, n ) )
+            {
+                AiaLogError( "Failed to relocate record, id=%zu", id );
+                g_aiaStorageLog.head = AIA_STORAGE_FLASH_BLOCK_SIZE;
+                return false;
+            }
+        }
+        entry->offset = to;
+        g_aiaStorageLog.head += size;
+    }
+
+    /* A crash before this point leaves both copies, and the newer one wins. */
+    g_aiaStorageLog.blockSeq[ block ] = 0;
+    g_aiaStorageLog.erased[ block ] = AiaStorageFlash_Erase( block );
+    if( !g_aiaStorageLog.erased[ block ] )
+    {
+        AiaLogWarn( "AiaStorageFlash_Erase failed, block=%zu", block );
+    }
+    return true;
+}
+
+/**
+ * Makes room for @c size bytes at the head of the log, moving to a new block
+ * and compacting as needed.
+ */
+static bool AiaStorageLog_MakeRoom( size_t size )
+{
+    for( size_t attempt = 0; attempt <= 2 * AIA_STORAGE_FLASH_NUM_BLOCKS;
+         ++attempt )
+    {
+        size_t freeBlock = AIA_STORAGE_FLASH_NUM_BLOCKS;
+        if( g_aiaStorageLog.head + size <= AIA_STORAGE_FLASH_BLOCK_SIZE )
+        {
+            return true;
+        }
+
+        /* Open a new block as long as one stays in reserve. */
+        size_t freeCount = AiaStorageLog_CountFree( &freeBlock );
+        if( freeCount >= 2 )
+        {
+            if( !AiaStorageLog_OpenBlock( freeBlock ) )
+            {
+                return false;
+            }
+            continue;
+        }
+
+        /* Otherwise reclaim the block with the least live data. */
+        size_t victim = AIA_STORAGE_FLASH_NUM_BLOCKS;
+        size_t victimLive = 0;
+        for( size_t block = 0; block < AIA_STORAGE_FLASH_NUM_BLOCKS; ++block )
+        {
+            size_t live = AiaStorageLog_LiveBytes( block );
+            if( block != g_aiaStorageLog.activeBlock &&
+                g_aiaStorageLog.blockSeq[ block ] &&
+                ( victim == AIA_STORAGE_FLASH_NUM_BLOCKS ||
+                  live < victimLive ) )
+            {
+                victim = block;
+                victimLive = live;
+            }
+        }
+        /* With no other block in use, the active block is reclaimed itself,
+         * as when it ends in a torn record. */
+        if( victim == AIA_STORAGE_FLASH_NUM_BLOCKS && freeCount )
+        {
+            victim = g_aiaStorageLog.activeBlock;
+            victimLive = AiaStorageLog_LiveBytes( victim );
+        }
+        /* A block with nothing live is reclaimed without a free block, as
+         * after a crash between relocating a block and erasing it. */
+        if( victim == AIA_STORAGE_FLASH_NUM_BLOCKS ||
+            ( victimLive && !freeCount ) )
+        {
+            break;
+        }
+        if( victimLive &&
+            ( !AiaStorageLog_OpenBlock( freeBlock ) ||
+              !AiaStorageLog_Relocate( victim ) ) )
+        {
+            return false;
+        }
+        if( !victimLive )
+        {
+            /* Erased now, so that a block is free on flash as well. */
+            g_aiaStorageLog.blockSeq[ victim ] = 0;
+            g_aiaStorageLog.erased[ victim ] = AiaStorageFlash_Erase( victim );
+        }
+    }
+
+    AiaLogError( "Storage full, bytes=%zu", size );
+    return false;
+}
+
+/** @return The bytes a record of @c size bytes of data takes in the log. */
+static size_t AiaStorageLog_RecordSize( size_t size )
+{
+    return AIA_STORAGE_LOG_ALIGN( AIA_STORAGE_LOG_RECORD_HEADER_SIZE + size );
+}
+
+/**
+ * Appends a record at the head of the active block, which must have room for
+ * it.
+ *
+ * @param id The record's identifier.
+ * @param flags The record's flags.
+ * @param blob The record's data.
+ * @param size Size of @c blob.
+ * @return Offset of the record from the start of the device, or @c
+ * AIA_STORAGE_LOG_NO_RECORD on failure, after which the block is sealed.
+ */
+static size_t AiaStorageLog_AppendRecord( size_t id, uint8_t flags,
+                                          const uint8_t* blob, size_t size )
+{
+    uint8_t header[ AIA_STORAGE_LOG_RECORD_HEADER_SIZE ];
+    header[ 0 ] = (uint8_t)id;
+    header[ 1 ] = flags;
+    AiaStorageLog_PutU16( header + 2, (uint16_t)size );
+    AiaStorageLog_PutU32(
+        header + 4,
+        AiaStorage_Crc32c( AiaStorageLog_HeaderCrc( header ), blob, size ) );
+
+    /* The header goes first so that a torn write fails its checksum. */
+    size_t offset = g_aiaStorageLog.activeBlock * AIA_STORAGE_FLASH_BLOCK_SIZE +
+                    g_aiaStorageLog.head;
+    if( !AiaStorageFlash_Program( offset, header, sizeof( header ) ) ||
+        !AiaStorageLog_Program( offset + sizeof( header ), blob, size ) )
+    {
+        AiaLogError( "Failed to program record, id=%zu", id );
+        g_aiaStorageLog.head = AIA_STORAGE_FLASH_BLOCK_SIZE;
+        return AIA_STORAGE_LOG_NO_RECORD;
+    }
+
+    g_aiaStorageLog.head += AiaStorageLog_RecordSize( size );
+    return offset;
+}
+
+bool AiaStorageLog_StoreBlob( AiaStorageBlobId_t id, const uint8_t* blob,
+                              size_t size )
+{
+    size_t recordSize = AiaStorageLog_RecordSize( size );
+    if( recordSize > AIA_STORAGE_LOG_MAX_RECORD_SIZE || size > UINT16_MAX )
+    {
+        AiaLogError( "Blob too large for a flash block, size=%zu", size );
+        return false;
+    }
+    if( !AiaStorageLog_Mount() || !AiaStorageLog_MakeRoom( recordSize ) )
+    {
+        return false;
+    }
+
+    size_t offset = AiaStorageLog_AppendRecord( id, 0xFF, blob, size );
+    if( offset == AIA_STORAGE_LOG_NO_RECORD )
+    {
+        return false;
+    }
+    g_aiaStorageLog.index[ id ].offset = offset;
+    g_aiaStorageLog.index[ id ].length = size;
+    return true;
+}
+
+bool AiaStorageLog_CommitBlobs( const AiaStorageBlobWrite_t* writes,
+                                size_t count )
+{
+    size_t offsets[ AIA_STORAGE_TRANSACTION_MAX_BLOBS ];
+    size_t totalSize = AiaStorageLog_RecordSize( 0 );
+
+    if( count == 1 )
+    {
+        return AiaStorageLog_StoreBlob( writes[ 0 ].id, writes[ 0 ].blob,
+                                        writes[ 0 ].size );
+    }
+    for( size_t i = 0; i < count; ++i )
+    {
+        totalSize += AiaStorageLog_RecordSize( writes[ i ].size );
+    }
+    if( totalSize > AIA_STORAGE_LOG_MAX_RECORD_SIZE )
+    {
+        AiaLogError( "Transaction too large for a flash block, size=%zu",
+                     totalSize );
+        return false;
+    }
+    if( !count )
+    {
+        return true;
+    }
+    if( !AiaStorageLog_Mount() || !AiaStorageLog_MakeRoom( totalSize ) )
+    {
+        return false;
+    }
+
+    for( size_t i = 0; i < count; ++i )
+    {
+        offsets[ i ] = AiaStorageLog_AppendRecord(
+            writes[ i ].id, (uint8_t)~AIA_STORAGE_LOG_FLAG_COMMITTED,
+            writes[ i ].blob, writes[ i ].size );
+        if( offsets[ i ] == AIA_STORAGE_LOG_NO_RECORD )
+        {
+            return false;
+        }
+    }
+    if( AiaStorageLog_AppendRecord( AIA_STORAGE_LOG_COMMIT_ID, 0xFF, NULL,
+                                    0 ) == AIA_STORAGE_LOG_NO_RECORD )
+    {
+        return false;
+    }
+
+    for( size_t i = 0; i < count; ++i )
+    {
+        g_aiaStorageLog.index[ writes[ i ].id ].offset = offsets[ i ];
+        g_aiaStorageLog.index[ writes[ i ].id ].length = writes[ i ].size;
+    }
+    return true;
+}
+
+/**
+ * Checks the data of a blob's current record against the checksum in its
+ * header, which may have been damaged since the log was replayed.
+ *
+ * @param id The blob.
+ * @param blob The record's data.
+ * @param size Size of @c blob.
+ * @return @c AIA_STORAGE_ERROR_NONE if the record is intact, or another error
+ * otherwise.
+ */
+static AiaStorageError_t AiaStorageLog_VerifyRecord( AiaStorageBlobId_t id,
+                                                     const uint8_t* blob,
+                                                     size_t size )
+{
+    uint8_t header[ AIA_STORAGE_LOG_RECORD_HEADER_SIZE ];
+    if( !AiaStorageFlash_Read( g_aiaStorageLog.index[ id ].offset, header,
+                               sizeof( header ) ) )
+    {
+        return AIA_STORAGE_ERROR_FAILED;
+    }
+    if( header[ 0 ] != id || AiaStorageLog_GetU16( header + 2 ) != size ||
+        AiaStorage_Crc32c( AiaStorageLog_HeaderCrc( header ), blob, size ) !=
+            AiaStorageLog_GetU32( header + 4 ) )
+    {
+        AiaLogError( "Corrupted record, id=%zu", (size_t)id );
+        return AIA_STORAGE_ERROR_CORRUPTED;
+    }
+    return AIA_STORAGE_ERROR_NONE;
+}
+
+AiaStorageError_t AiaStorageLog_LoadBlob( AiaStorageBlobId_t id,
+                                          uint8_t* blob, size_t size )
+{
+    if( !AiaStorageLog_Mount() )
+    {
+        return AIA_STORAGE_ERROR_FAILED;
+    }
+    if( g_aiaStorageLog.index[ id ].offset == AIA_STORAGE_LOG_NO_RECORD )
+    {
+        return AIA_STORAGE_ERROR_NONE;
+    }
+    if( !AiaStorageFlash_Read( g_aiaStorageLog.index[ id ].offset +
+                                   AIA_STORAGE_LOG_RECORD_HEADER_SIZE,
+                               blob, size ) )
+    {
+        return AIA_STORAGE_ERROR_FAILED;
+    }
+    return AiaStorageLog_VerifyRecord( id, blob, size );
+}
+
+bool AiaStorageLog_BorrowBlob( AiaStorageBlobId_t id, const uint8_t** data )
+{
+#ifdef AIA_STORAGE_FLASH_MAPPED
+    if( !AiaStorageLog_Mount() ||
+        g_aiaStorageLog.index[ id ].offset == AIA_STORAGE_LOG_NO_RECORD )
+    {
+        return false;
+    }
+    *data = AIA_STORAGE_FLASH_MAPPED( g_aiaStorageLog.index[ id ].offset +
+                                      AIA_STORAGE_LOG_RECORD_HEADER_SIZE );
+    /* A damaged record is left to LoadBlob(), which reports it. */
+    return AiaStorageLog_VerifyRecord(
+               id, *data, g_aiaStorageLog.index[ id ].length ) ==
+           AIA_STORAGE_ERROR_NONE;
+#else
+    (void)id;
+    (void)data;
+    return false;
+#endif
+}
+
+size_t AiaStorageLog_GetBlobSize( AiaStorageBlobId_t id )
+{
+    if( !AiaStorageLog_Mount() ||
+        g_aiaStorageLog.index[ id ].offset == AIA_STORAGE_LOG_NO_RECORD )
+    {
+        return 0;
+    }
+    return g_aiaStorageLog.index[ id ].length;
+}
+
+bool AiaStorageLog_BlobExists( AiaStorageBlobId_t id )
+{
+    return AiaStorageLog_Mount() &&
+           g_aiaStorageLog.index[ id ].offset != AIA_STORAGE_LOG_NO_RECORD &&
+           g_aiaStorageLog.index[ id ].length != 0;
+}
+
+bool AiaStorageLog_Compact()
+{
+    if( !AiaStorageLog_Mount() )
+    {
+        return false;
+    }
+
+    /* Nothing to do while a block can be opened without taking the reserve:
+     * compacting earlier only erases more often. */
+    size_t freeBlock;
+    if( AiaStorageLog_CountFree( &freeBlock ) >= 2 )
+    {
+        return false;
+    }
+
+    /* Pick the block with the most superseded data that the active block can
+     * absorb. */
+    size_t room = AIA_STORAGE_FLASH_BLOCK_SIZE - g_aiaStorageLog.head;
+    size_t victim = AIA_STORAGE_FLASH_NUM_BLOCKS;
+    size_t victimLive = room;
+    for( size_t block = 0; block < AIA_STORAGE_FLASH_NUM_BLOCKS; ++block )
+    {
+        size_t live = AiaStorageLog_LiveBytes( block );
+        if( block != g_aiaStorageLog.activeBlock &&
+            g_aiaStorageLog.blockSeq[ block ] && live <= victimLive )
+        {
+            victim = block;
+            victimLive = live;
+        }
+    }
+    if( victim == AIA_STORAGE_FLASH_NUM_BLOCKS )
+    {
+        return false;
+    }
+    return AiaStorageLog_Relocate( victim );
+}
+
+#endif
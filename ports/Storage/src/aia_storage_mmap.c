@@ -0,0 +1,518 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file aia_storage_mmap.c
+ * @brief Implements the memory-mapped file storage backend of @c
+ * aia_storage_backend.h, for host builds.
+ */
+
+/* mmap() and the file functions below are POSIX rather than C99. */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <storage/aia_storage_backend.h>
+
+#if AIA_STORAGE_BACKEND == AIA_STORAGE_BACKEND_MMAP
+
+#include <aia_config.h>
+
+#include <storage/aia_storage_crc.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @name File layout.
+ *
+ * The file starts with a header of a magic number, a format version and the
+ * size of the file, which changes with the blob capacities. A file with
+ * another header is started over. The journal follows, and then one slot per
+ * blob at a fixed offset, each a header of the data length, a flag set once the
+ * blob has been stored and a CRC-32C over the length and the data, followed by
+ * room for the blob's capacity. Slots start at @c AIA_STORAGE_MMAP_ALIGNMENT
+ * byte boundaries. All fields are little endian.
+ *
+ * Every write is first copied into the journal: a header of the number of
+ * blobs and a CRC-32C over the number and the rest of the journal, followed by
+ * each blob's identifier and length, two bytes each, and data. It is then
+ * copied into the slots. Only the latest write is kept in the journal, and the
+ * slots never hold anything newer, so a journal that passes its checksum is
+ * replayed on every mount. The number is cleared before the journal is
+ * overwritten and set last: blobs carrying their own CRC-32C, like alert
+ * records, leave the journal's checksum unchanged when swapped for one
+ * another, so it cannot tell a journal cut short from a whole one.
+ */
+/** @{ */
+
+#define AIA_STORAGE_MMAP_MAGIC ( (uint32_t)0x4D414941 )
+#define AIA_STORAGE_MMAP_VERSION 1
+#define AIA_STORAGE_MMAP_FILE_HEADER_SIZE 16
+#define AIA_STORAGE_MMAP_JOURNAL_HEADER_SIZE 8
+#define AIA_STORAGE_MMAP_ENTRY_HEADER_SIZE 4
+#define AIA_STORAGE_MMAP_SLOT_HEADER_SIZE 8
+#define AIA_STORAGE_MMAP_ALIGNMENT 8
+#define AIA_STORAGE_MMAP_ALIGN( size )                   \
+    ( ( ( size ) + AIA_STORAGE_MMAP_ALIGNMENT - 1 ) & \
+      ~(size_t)( AIA_STORAGE_MMAP_ALIGNMENT - 1 ) )
+
+/** @} */
+
+/* Journal entries store blob identifiers in two bytes. */
+typedef char aia_storage_mmap_blob_ids_fit
+    [ AIA_STORAGE_BACKEND_NUM_BLOBS <= 0x10000 ? 1 : -1 ];
+
+extern const char* g_aiaStorageFolder;
+
+/** State of the mapping, set up on first use. */
+static struct
+{
+    /** Whether the file has been mapped. */
+    bool mounted;
+
+    /** The mapped file. */
+    uint8_t* map;
+
+    /** Size of the file. */
+    size_t size;
+
+    /** Size of the journal, including its header. */
+    size_t journalSize;
+
+    /** Offset of each blob's slot from the start of the file. */
+    size_t slotOffset[ AIA_STORAGE_BACKEND_NUM_BLOBS ];
+} g_aiaStorageMmap;
+
+static void AiaStorageMmap_PutU16( uint8_t* bytes, uint16_t value )
+{
+    bytes[ 0 ] = (uint8_t)value;
+    bytes[ 1 ] = (uint8_t)( value >> 8 );
+}
+
+static void AiaStorageMmap_PutU32( uint8_t* bytes, uint32_t value )
+{
+    for( size_t i = 0; i < sizeof( value ); ++i )
+    {
+        bytes[ i ] = (uint8_t)( value >> ( i * 8 ) );
+    }
+}
+
+static uint16_t AiaStorageMmap_GetU16( const uint8_t* bytes )
+{
+    return (uint16_t)( bytes[ 0 ] | ( bytes[ 1 ] << 8 ) );
+}
+
+static uint32_t AiaStorageMmap_GetU32( const uint8_t* bytes )
+{
+    return (uint32_t)bytes[ 0 ] | ( (uint32_t)bytes[ 1 ] << 8 ) |
+           ( (uint32_t)bytes[ 2 ] << 16 ) | ( (uint32_t)bytes[ 3 ] << 24 );
+}
+
+/**
+ * Flushes a range of the mapping to the file, which is a durability point when
+ * @c AIA_STORAGE_MMAP_SYNC is enabled. Only the pages holding the range are
+ * written back.
+ *
+ * @param offset Offset of the range from the start of the file.
+ * @param length Length of the range.
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorageMmap_Sync( size_t offset, size_t length )
+{
+#if AIA_STORAGE_MMAP_SYNC
+    /* msync() wants a page aligned address. */
+    long page = sysconf( _SC_PAGESIZE );
+    size_t start = page > 0 ? offset - offset % (size_t)page : 0;
+    if( msync( g_aiaStorageMmap.map + start, offset + length - start,
+               MS_SYNC ) != 0 )
+    {
+        AiaLogError( "msync failed, errno=%d", errno );
+        return false;
+    }
+#else
+    (void)offset;
+    (void)length;
+#endif
+    return true;
+}
+
+/**
+ * Flushes a blob's slot to the file.
+ *
+ * @param id The blob.
+ * @param size Size of the blob stored in the slot.
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorageMmap_SyncSlot( size_t id, size_t size )
+{
+    return AiaStorageMmap_Sync( g_aiaStorageMmap.slotOffset[ id ],
+                                AIA_STORAGE_MMAP_SLOT_HEADER_SIZE + size );
+}
+
+/** Copies a blob into its slot. */
+static void AiaStorageMmap_WriteSlot( size_t id, const uint8_t* blob,
+                                      size_t size )
+{
+    uint8_t* slot = g_aiaStorageMmap.map + g_aiaStorageMmap.slotOffset[ id ];
+    memcpy( slot + AIA_STORAGE_MMAP_SLOT_HEADER_SIZE, blob, size );
+    AiaStorageMmap_PutU16( slot, (uint16_t)size );
+    slot[ 2 ] = 1;
+    slot[ 3 ] = 0;
+    AiaStorageMmap_PutU32(
+        slot + 4, AiaStorage_Crc32c( AiaStorage_Crc32c( 0, slot, 2 ),
+                                     slot + AIA_STORAGE_MMAP_SLOT_HEADER_SIZE,
+                                     size ) );
+}
+
+/**
+ * Checks a blob's slot against its checksum.
+ *
+ * @param id The blob.
+ * @param size The size the blob is expected to have.
+ * @return @c AIA_STORAGE_ERROR_NONE if the slot is intact or has never been
+ * stored, or @c AIA_STORAGE_ERROR_CORRUPTED otherwise.
+ */
+static AiaStorageError_t AiaStorageMmap_VerifySlot( AiaStorageBlobId_t id,
+                                                    size_t size )
+{
+    const uint8_t* slot =
+        g_aiaStorageMmap.map + g_aiaStorageMmap.slotOffset[ id ];
+    if( !slot[ 2 ] && !size )
+    {
+        return AIA_STORAGE_ERROR_NONE;
+    }
+    if( AiaStorageMmap_GetU16( slot ) != size ||
+        AiaStorage_Crc32c( AiaStorage_Crc32c( 0, slot, 2 ),
+                           slot + AIA_STORAGE_MMAP_SLOT_HEADER_SIZE, size ) !=
+            AiaStorageMmap_GetU32( slot + 4 ) )
+    {
+        AiaLogError( "Corrupted slot, id=%zu", (size_t)id );
+        return AIA_STORAGE_ERROR_CORRUPTED;
+    }
+    return AIA_STORAGE_ERROR_NONE;
+}
+
+/**
+ * Applies the write in the journal to the slots again, in case it was cut
+ * short. Nothing is applied if the journal fails its checksum, since then the
+ * write was cut short before the slots were touched.
+ */
+static void AiaStorageMmap_Replay()
+{
+    const uint8_t* journal =
+        g_aiaStorageMmap.map + AIA_STORAGE_MMAP_FILE_HEADER_SIZE;
+    uint32_t count = AiaStorageMmap_GetU32( journal );
+    size_t used = AIA_STORAGE_MMAP_JOURNAL_HEADER_SIZE;
+
+    if( !count || count > AIA_STORAGE_TRANSACTION_MAX_BLOBS )
+    {
+        return;
+    }
+    for( uint32_t i = 0; i < count; ++i )
+    {
+        if( used + AIA_STORAGE_MMAP_ENTRY_HEADER_SIZE >
+            g_aiaStorageMmap.journalSize )
+        {
+            return;
+        }
+        size_t id = AiaStorageMmap_GetU16( journal + used );
+        size_t size = AiaStorageMmap_GetU16( journal + used + 2 );
+        if( id >= AIA_STORAGE_BACKEND_NUM_BLOBS ||
+            size > AiaStorage_GetBackendBlobCapacity( id ) ||
+            used + AIA_STORAGE_MMAP_ENTRY_HEADER_SIZE + size >
+                g_aiaStorageMmap.journalSize )
+        {
+            return;
+        }
+        used += AIA_STORAGE_MMAP_ENTRY_HEADER_SIZE + size;
+    }
+    if( AiaStorage_Crc32c( AiaStorage_Crc32c( 0, journal, 4 ),
+                           journal + AIA_STORAGE_MMAP_JOURNAL_HEADER_SIZE,
+                           used - AIA_STORAGE_MMAP_JOURNAL_HEADER_SIZE ) !=
+        AiaStorageMmap_GetU32( journal + 4 ) )
+    {
+        return;
+    }
+
+    used = AIA_STORAGE_MMAP_JOURNAL_HEADER_SIZE;
+    for( uint32_t i = 0; i < count; ++i )
+    {
+        size_t id = AiaStorageMmap_GetU16( journal + used );
+        size_t size = AiaStorageMmap_GetU16( journal + used + 2 );
+        AiaStorageMmap_WriteSlot(
+            id, journal + used + AIA_STORAGE_MMAP_ENTRY_HEADER_SIZE, size );
+        AiaStorageMmap_SyncSlot( id, size );
+        used += AIA_STORAGE_MMAP_ENTRY_HEADER_SIZE + size;
+    }
+}
+
+/**
+ * Maps the file on first use, creating it if there is none yet or starting it
+ * over if it was laid out for other blob capacities.
+ *
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorageMmap_Mount()
+{
+    char path[ 256 ];
+    struct stat status;
+    size_t largest = 0;
+
+    if( g_aiaStorageMmap.mounted )
+    {
+        return true;
+    }
+
+    for( size_t id = 0; id < AIA_STORAGE_BACKEND_NUM_BLOBS; ++id )
+    {
+        size_t capacity = AiaStorage_GetBackendBlobCapacity( id );
+        largest = capacity > largest ? capacity : largest;
+    }
+    size_t single = AIA_STORAGE_MMAP_ENTRY_HEADER_SIZE + largest;
+    size_t transaction =
+        AIA_STORAGE_TRANSACTION_MAX_BLOBS * AIA_STORAGE_MMAP_ENTRY_HEADER_SIZE +
+        AIA_STORAGE_TRANSACTION_SIZE;
+    g_aiaStorageMmap.journalSize =
+        AIA_STORAGE_MMAP_JOURNAL_HEADER_SIZE +
+        ( single > transaction ? single : transaction );
+    size_t offset = AIA_STORAGE_MMAP_ALIGN( AIA_STORAGE_MMAP_FILE_HEADER_SIZE +
+                                            g_aiaStorageMmap.journalSize );
+    for( size_t id = 0; id < AIA_STORAGE_BACKEND_NUM_BLOBS; ++id )
+    {
+        g_aiaStorageMmap.slotOffset[ id ] = offset;
+        offset += AIA_STORAGE_MMAP_ALIGN(
+            AIA_STORAGE_MMAP_SLOT_HEADER_SIZE +
+            AiaStorage_GetBackendBlobCapacity( (AiaStorageBlobId_t)id ) );
+    }
+    g_aiaStorageMmap.size = offset;
+
+    int length =
+        g_aiaStorageFolder
+            ? snprintf( path, sizeof( path ), "%s/%s", g_aiaStorageFolder,
+                        AIA_STORAGE_MMAP_FILE_NAME )
+            : snprintf( path, sizeof( path ), "%s",
+                        AIA_STORAGE_MMAP_FILE_NAME );
+    if( length < 0 || (size_t)length >= sizeof( path ) )
+    {
+        AiaLogError( "Storage file path too long" );
+        return false;
+    }
+
+    int fd = open( path, O_RDWR | O_CREAT, 0600 );
+    if( fd < 0 )
+    {
+        AiaLogError( "Failed to open storage file %s, errno=%d", path, errno );
+        return false;
+    }
+    if( fstat( fd, &status ) != 0 )
+    {
+        AiaLogError( "fstat failed, errno=%d", errno );
+        close( fd );
+        return false;
+    }
+    bool resized = (size_t)status.st_size != g_aiaStorageMmap.size;
+    if( resized && status.st_size )
+    {
+        AiaLogWarn( "Storage file %s has another layout, starting over",
+                    path );
+    }
+    /* Truncating first zeroes the whole file. */
+    if( resized && ( ftruncate( fd, 0 ) != 0 ||
+                     ftruncate( fd, (off_t)g_aiaStorageMmap.size ) != 0 ) )
+    {
+        AiaLogError( "ftruncate failed, errno=%d", errno );
+        close( fd );
+        return false;
+    }
+    void* map = mmap( NULL, g_aiaStorageMmap.size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0 );
+    close( fd );
+    if( map == MAP_FAILED )
+    {
+        AiaLogError( "mmap failed, errno=%d", errno );
+        return false;
+    }
+    g_aiaStorageMmap.map = (uint8_t*)map;
+
+    uint8_t* header = g_aiaStorageMmap.map;
+    if( AiaStorageMmap_GetU32( header ) != AIA_STORAGE_MMAP_MAGIC ||
+        AiaStorageMmap_GetU32( header + 4 ) != AIA_STORAGE_MMAP_VERSION ||
+        AiaStorageMmap_GetU32( header + 8 ) != g_aiaStorageMmap.size )
+    {
+        if( !resized )
+        {
+            AiaLogWarn( "Storage file %s has a bad header, starting over",
+                        path );
+        }
+        memset( g_aiaStorageMmap.map, 0, g_aiaStorageMmap.size );
+        AiaStorageMmap_PutU32( header, AIA_STORAGE_MMAP_MAGIC );
+        AiaStorageMmap_PutU32( header + 4, AIA_STORAGE_MMAP_VERSION );
+        AiaStorageMmap_PutU32( header + 8, (uint32_t)g_aiaStorageMmap.size );
+        if( !AiaStorageMmap_Sync( 0, g_aiaStorageMmap.size ) )
+        {
+            munmap( map, g_aiaStorageMmap.size );
+            return false;
+        }
+    }
+
+    AiaStorageMmap_Replay();
+    g_aiaStorageMmap.mounted = true;
+    return true;
+}
+
+/**
+ * Writes blobs through the journal, so that either all or none of them are
+ * found after the process or the host stops.
+ *
+ * @param writes The blobs to write.
+ * @param count Number of @c writes.
+ * @return @c true on success or @c false otherwise.
+ */
+static bool AiaStorageMmap_Write( const AiaStorageBlobWrite_t* writes,
+                                  size_t count )
+{
+    uint8_t* journal =
+        g_aiaStorageMmap.map + AIA_STORAGE_MMAP_FILE_HEADER_SIZE;
+    uint8_t number[ 4 ];
+    size_t used = AIA_STORAGE_MMAP_JOURNAL_HEADER_SIZE;
+
+    AiaStorageMmap_PutU32( journal, 0 );
+    if( !AiaStorageMmap_Sync( AIA_STORAGE_MMAP_FILE_HEADER_SIZE,
+                              sizeof( number ) ) )
+    {
+        return false;
+    }
+    for( size_t i = 0; i < count; ++i )
+    {
+        if( used + AIA_STORAGE_MMAP_ENTRY_HEADER_SIZE + writes[ i ].size >
+            g_aiaStorageMmap.journalSize )
+        {
+            AiaLogError( "Write too large for the journal, count=%zu", count );
+            return false;
+        }
+        AiaStorageMmap_PutU16( journal + used, (uint16_t)writes[ i ].id );
+        AiaStorageMmap_PutU16( journal + used + 2,
+                               (uint16_t)writes[ i ].size );
+        memcpy( journal + used + AIA_STORAGE_MMAP_ENTRY_HEADER_SIZE,
+                writes[ i ].blob, writes[ i ].size );
+        used += AIA_STORAGE_MMAP_ENTRY_HEADER_SIZE + writes[ i ].size;
+    }
+    AiaStorageMmap_PutU32( number, (uint32_t)count );
+    AiaStorageMmap_PutU32(
+        journal + 4,
+        AiaStorage_Crc32c( AiaStorage_Crc32c( 0, number, sizeof( number ) ),
+                           journal + AIA_STORAGE_MMAP_JOURNAL_HEADER_SIZE,
+                           used - AIA_STORAGE_MMAP_JOURNAL_HEADER_SIZE ) );
+    if( !AiaStorageMmap_Sync( AIA_STORAGE_MMAP_FILE_HEADER_SIZE, used ) )
+    {
+        return false;
+    }
+    memcpy( journal, number, sizeof( number ) );
+    if( !AiaStorageMmap_Sync( AIA_STORAGE_MMAP_FILE_HEADER_SIZE,
+                              sizeof( number ) ) )
+    {
+        return false;
+    }
+
+    for( size_t i = 0; i < count; ++i )
+    {
+        AiaStorageMmap_WriteSlot( writes[ i ].id, writes[ i ].blob,
+                                  writes[ i ].size );
+        if( !AiaStorageMmap_SyncSlot( writes[ i ].id, writes[ i ].size ) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool AiaStorageMmap_StoreBlob( AiaStorageBlobId_t id, const uint8_t* blob,
+                               size_t size )
+{
+    AiaStorageBlobWrite_t write = { id, blob, size };
+    return AiaStorageMmap_Mount() && AiaStorageMmap_Write( &write, 1 );
+}
+
+bool AiaStorageMmap_CommitBlobs( const AiaStorageBlobWrite_t* writes,
+                                 size_t count )
+{
+    if( !count )
+    {
+        return true;
+    }
+    return AiaStorageMmap_Mount() && AiaStorageMmap_Write( writes, count );
+}
+
+AiaStorageError_t AiaStorageMmap_LoadBlob( AiaStorageBlobId_t id,
+                                           uint8_t* blob, size_t size )
+{
+    if( !AiaStorageMmap_Mount() )
+    {
+        return AIA_STORAGE_ERROR_FAILED;
+    }
+    memcpy( blob,
+            g_aiaStorageMmap.map + g_aiaStorageMmap.slotOffset[ id ] +
+                AIA_STORAGE_MMAP_SLOT_HEADER_SIZE,
+            size );
+    return AiaStorageMmap_VerifySlot( id, size );
+}
+
+size_t AiaStorageMmap_GetBlobSize( AiaStorageBlobId_t id )
+{
+    if( !AiaStorageMmap_Mount() )
+    {
+        return 0;
+    }
+    size_t size = AiaStorageMmap_GetU16( g_aiaStorageMmap.map +
+                                         g_aiaStorageMmap.slotOffset[ id ] );
+    size_t capacity = AiaStorage_GetBackendBlobCapacity( id );
+
+    /* A damaged length is caught by the checksum when the blob is loaded. */
+    return size < capacity ? size : capacity;
+}
+
+bool AiaStorageMmap_BlobExists( AiaStorageBlobId_t id )
+{
+    /* The stored flag stays set once a blob is deleted by storing it empty. */
+    return AiaStorageMmap_GetBlobSize( id ) != 0;
+}
+
+bool AiaStorageMmap_BorrowBlob( AiaStorageBlobId_t id, const uint8_t** data )
+{
+    if( !AiaStorageMmap_Mount() )
+    {
+        return false;
+    }
+    *data = g_aiaStorageMmap.map + g_aiaStorageMmap.slotOffset[ id ] +
+            AIA_STORAGE_MMAP_SLOT_HEADER_SIZE;
+
+    /* A damaged slot is left to LoadBlob(), which reports it. */
+    return AiaStorageMmap_VerifySlot( id, AiaStorageMmap_GetBlobSize( id ) ) ==
+           AIA_STORAGE_ERROR_NONE;
+}
+
+bool AiaStorageMmap_Compact()
+{
+    /* Blobs are stored in place, so nothing is ever superseded. */
+    return false;
+}
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file aia_storage_ram.c
+ * @brief Implements the RAM storage backend of @c aia_storage_backend.h.
+ */
+
+#include <storage/aia_storage_backend.h>
+
+#if AIA_STORAGE_BACKEND == AIA_STORAGE_BACKEND_RAM
+
+#include <aia_config.h>
+
+/** If using the provided sample storage implementation, this is the memory
+ * space that the SDK will read/write from/to.
+ * Vendors should store/load blob to/from NVRAM/persistant storage by their platform
+ */
+
+#define BLOBSTORAGE_CAPACITY_TERM( NAME, KEY, HASH ) \
+    +AIA_STORAGE_##NAME##_CAPACITY
+
+/** Bytes taken by the keyed blobs of one namespace. */
+#define BLOBSTORAGE_KEYED_SIZE \
+    ( 0 AIA_STORAGE_BLOBS( BLOBSTORAGE_CAPACITY_TERM ) )
+
+/** Bytes taken by all the blobs of one namespace. */
+#define BLOBSTORAGE_NAMESPACE_SIZE \
+    ( BLOBSTORAGE_KEYED_SIZE +     \
+      AIA_STORAGE_ALERT_SLOTS * AIA_STORAGE_ALERT_RECORD_SIZE )
+
+/**
+ * Every blob of every namespace, packed in identifier order, followed by the
+ * client identifiers the namespaces are claimed by.
+ */
+static struct
+{
+    uint8_t data[ AIA_STORAGE_NAMESPACES * BLOBSTORAGE_NAMESPACE_SIZE +
+                  ( AIA_STORAGE_BACKEND_NUM_BLOBS -
+                    AIA_STORAGE_NAMESPACES * AIA_STORAGE_NUM_BLOBS ) *
+                      AIA_STORAGE_CLIENT_ID_CAPACITY ];
+    size_t length[ AIA_STORAGE_BACKEND_NUM_BLOBS ];
+} g_aiaStorageRam;
+
+/**
+ * @param id A blob identifier.
+ * @return Where the blob is kept in @c g_aiaStorageRam.data.
+ */
+static uint8_t* AiaStorageRam_GetBlob( AiaStorageBlobId_t id )
+{
+    size_t space = (size_t)id / AIA_STORAGE_NUM_BLOBS;
+    size_t local = (size_t)id % AIA_STORAGE_NUM_BLOBS;
+    size_t offset = space * BLOBSTORAGE_NAMESPACE_SIZE;
+    if( space >= AIA_STORAGE_NAMESPACES )
+    {
+        return g_aiaStorageRam.data +
+               AIA_STORAGE_NAMESPACES * BLOBSTORAGE_NAMESPACE_SIZE +
+               ( (size_t)id -
+                 AIA_STORAGE_NAMESPACES * AIA_STORAGE_NUM_BLOBS ) *
+                   AIA_STORAGE_CLIENT_ID_CAPACITY;
+    }
+    if( local >= AIA_STORAGE_BLOB_ALERT_SLOT_0 )
+    {
+        return g_aiaStorageRam.data + offset + BLOBSTORAGE_KEYED_SIZE +
+               ( local - AIA_STORAGE_BLOB_ALERT_SLOT_0 ) *
+                   AIA_STORAGE_ALERT_RECORD_SIZE;
+    }
+    for( size_t i = 0; i < local; ++i )
+    {
+        offset += AiaStorage_GetBlobCapacity( (AiaStorageBlobId_t)i );
+    }
+    return g_aiaStorageRam.data + offset;
+}
+
+bool AiaStorageRam_StoreBlob( AiaStorageBlobId_t id, const uint8_t* blob,
+                              size_t size )
+{
+    memcpy( AiaStorageRam_GetBlob( id ), blob, size );
+    g_aiaStorageRam.length[ id ] = size;
+    return true;
+}
+
+AiaStorageError_t AiaStorageRam_LoadBlob( AiaStorageBlobId_t id,
+                                          uint8_t* blob, size_t size )
+{
+    /* RAM is not expected to rot within a boot, so there is no checksum. */
+    memcpy( blob, AiaStorageRam_GetBlob( id ), size );
+    return AIA_STORAGE_ERROR_NONE;
+}
+
+size_t AiaStorageRam_GetBlobSize( AiaStorageBlobId_t id )
+{
+    return g_aiaStorageRam.length[ id ];
+}
+
+bool AiaStorageRam_BlobExists( AiaStorageBlobId_t id )
+{
+    return g_aiaStorageRam.length[ id ] != 0;
+}
+
+bool AiaStorageRam_BorrowBlob( AiaStorageBlobId_t id, const uint8_t** data )
+{
+    *data = AiaStorageRam_GetBlob( id );
+    return true;
+}
+
+bool AiaStorageRam_CommitBlobs( const AiaStorageBlobWrite_t* writes,
+                                size_t count )
+{
+    /* Nothing survives a power loss, so applying in order is atomic enough. */
+    for( size_t i = 0; i < count; ++i )
+    {
+        AiaStorageRam_StoreBlob( writes[ i ].id, writes[ i ].blob,
+                                 writes[ i ].size );
+    }
+    return true;
+}
+
+bool AiaStorageRam_Compact()
+{
+    /* Blobs are stored in place, so nothing is ever superseded. */
+    return false;
+}
+
+#endif
@@ -67,7 +67,10 @@ static const AiaJsonLongType AIA_SPEAKER_AUDIO_DECODER_BITS_PER_SECOND = 64000;
  */
 /** @{ */
 #define AIA_ENABLE_ALERTS
-static const AiaJsonLongType AIA_ALERTS_MAX_ALERT_COUNT = 20;
+/** Also sizes the alert storage, which needs an integer constant. */
+#define AIA_ALERTS_MAX_ALERT_SLOTS 20
+static const AiaJsonLongType AIA_ALERTS_MAX_ALERT_COUNT =
+    AIA_ALERTS_MAX_ALERT_SLOTS;
 /** @} */
 
 /**
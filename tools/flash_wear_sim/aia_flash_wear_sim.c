@@ -0,0 +1,1257 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file aia_flash_wear_sim.c
+ * @brief Host tool that runs the Storage port's log-structured backend on a
+ * simulated flash device under a long-running alert workload, to predict
+ * flash wear and storage latency before trying it on hardware.
+ *
+ * The Storage port sources are built unchanged against this file, which
+ * implements the functions of @c aia_storage_flash.h, and against the host
+ * @c aia_config.h next to it. From this directory:
+ *
+ *     cc -std=c99 -O2 -DAIA_STORAGE_BACKEND=1 -DAIA_STORAGE_WRITE_BEHIND=0 \
+ *         -Ihost \
+ *         -I../../ports/include -I../../ports/Storage/include \
+ *         -I../../ports/Clock/include \
+ *         -I../../external/AIAClientSDK/AiaCore/include \
+ *         -o aia_flash_wear_sim aia_flash_wear_sim.c \
+ *         ../../ports/Storage/src/aia_storage_config.c \
+ *         ../../ports/Storage/src/aia_storage_log.c \
+ *         ../../ports/Storage/src/aia_storage_crc.c
+ *     ./aia_flash_wear_sim [options]
+ *
+ * The device geometry is the one the port is built with, so pass the same @c
+ * AIA_STORAGE_FLASH_BLOCK_SIZE, @c AIA_STORAGE_FLASH_NUM_BLOCKS and @c
+ * AIA_STORAGE_FLASH_PROGRAM_SIZE definitions as the target build.
+ *
+ * Device options:
+ *   -E us           Time to erase a block (default 45000).
+ *   -P us           Time to program one program unit (default 11).
+ *   -R ns           Time to read one byte (default 20).
+ *   -C cycles       Rated erase cycles per block (default 100000).
+ *   -1              Allow each program unit to be programmed only once per
+ *                   erase, as on NAND or flash with ECC, instead of NOR
+ *                   semantics where bits can be cleared at any time.
+ *
+ * Workload options:
+ *   -d days         Days to simulate (default 365).
+ *   -t count        Timers set per day (default 6).
+ *   -a count        Daily recurring alarms (default 2).
+ *   -r count        Reconnects per day, each replacing the alert set as a
+ *                   SynchronizeState would (default 4).
+ *   -k days         Days between re-registrations, which store the shared
+ *                   secret and topic root in one transaction (default 30).
+ *   -V count        Volume changes per day, each a burst of 1 to 8 calls to
+ *                   AiaStoreVolume() as when a volume button is held
+ *                   (default 4).
+ *   -c              Disable the hourly idle call to AiaStorageLog_Compact().
+ *   -s seed         Seed of the workload (default 1).
+ *   -v              Print the Storage port's log messages.
+ *
+ * Power-loss options:
+ *   -p count        Instead of the workload above, make count storage calls
+ *                   and cut the power at every byte each of them programs or
+ *                   erases.
+ *
+ * Every hour of simulated time, timers are set and may be extended, due
+ * timers are deleted, due alarms are moved to the next day and reconnects
+ * happen at random according to the daily rates. Timers the Storage port arms,
+ * such as the one writing the volume, expire at the end of the hour. The tool
+ * reports the bytes
+ * the port was asked to store against the bytes programmed, erases per block,
+ * the projected lifetime of the most worn block, and the simulated flash time
+ * spent in each storage call. Alerts passed to @c AiaReplaceAlerts() count as
+ * requested even when they are unchanged and not rewritten, so the write
+ * amplification can fall below 1.
+ *
+ * With @c -p, each call stores, reschedules or deletes an alert, changes the
+ * volume, compacts the log, or commits a transaction: a re-registration or an
+ * @c AiaReplaceAlerts(). It first runs to completion in a child process,
+ * which mounts the log from the image the previous call left. It then runs
+ * again once for each byte it programs or erases, with the power cut at that
+ * byte: a program or erase only reaches the bytes before the cut, front to
+ * back. Another child process remounts the torn image and checks that every
+ * blob the call changes reads back as before the call, as after it, or as
+ * corrupted, that every other blob reads back unchanged, and that a blob
+ * stored after the remount reads back. The blobs a transaction changes must
+ * all read back as before it or all as after it. Use a small @c
+ * AIA_STORAGE_FLASH_BLOCK_SIZE so that the calls also cut compactions.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <aia_config.h>
+
+#include <storage/aia_storage_backend.h>
+#include <storage/aia_storage_flash.h>
+
+#include <aiacore/aia_volume_constants.h>
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if AIA_STORAGE_BACKEND != AIA_STORAGE_BACKEND_LOG
+#error "Build with -DAIA_STORAGE_BACKEND=1 to simulate the log backend"
+#endif
+
+/* The simulation is single-threaded and times each write as it is made. */
+#if AIA_STORAGE_WRITE_BEHIND
+#error "Build with -DAIA_STORAGE_WRITE_BEHIND=0"
+#endif
+
+#define DEVICE_SIZE \
+    ( AIA_STORAGE_FLASH_BLOCK_SIZE * AIA_STORAGE_FLASH_NUM_BLOCKS )
+#define DEVICE_UNITS ( DEVICE_SIZE / AIA_STORAGE_FLASH_PROGRAM_SIZE )
+
+#define SECONDS_PER_HOUR 3600
+#define SECONDS_PER_DAY ( 24 * SECONDS_PER_HOUR )
+
+/** Timing and endurance of the simulated device. */
+typedef struct DeviceParams
+{
+    double eraseUs;
+    double programUs;
+    double readNs;
+    uint32_t endurance;
+    bool programOnce;
+} DeviceParams_t;
+
+/** The simulated device and what it has been through. */
+static struct
+{
+    DeviceParams_t params;
+    uint8_t image[ DEVICE_SIZE ];
+    bool programmed[ DEVICE_UNITS ];
+    uint32_t erases[ AIA_STORAGE_FLASH_NUM_BLOCKS ];
+    uint64_t bytesRead;
+    uint64_t bytesProgrammed;
+    uint64_t violations;
+    double timeUs;
+} g_device;
+
+/** Storage calls the workload makes. */
+typedef enum Op
+{
+    OP_STORE_ALERT,
+    OP_DELETE_ALERT,
+    OP_REPLACE_ALERTS,
+    OP_REGISTER,
+    OP_COMPACT,
+    OP_STORE_VOLUME,
+    OP_TIMER,
+    NUM_OPS
+} Op_t;
+
+static const char* const g_opNames[ NUM_OPS ] = {
+    "AiaStoreAlert", "AiaDeleteAlert", "AiaReplaceAlerts",
+    "registration", "AiaStorageLog_Compact", "AiaStoreVolume",
+    "timer expiry"
+};
+
+/** Totals of one kind of storage call. */
+typedef struct OpStats
+{
+    uint64_t calls;
+    uint64_t failures;
+    uint64_t bytes;
+    double timeUs;
+    double maxUs;
+} OpStats_t;
+
+static OpStats_t g_opStats[ NUM_OPS ];
+
+static bool g_verbose;
+static uint64_t g_errors;
+
+#define BLOB_MEMBER( NAME, KEY, HASH ) \
+    uint8_t NAME[ AIA_STORAGE_##NAME##_CAPACITY ];
+
+/** Large enough for any blob. */
+typedef union AnyBlob
+{
+    AIA_STORAGE_BLOBS( BLOB_MEMBER )
+    uint8_t alert[ AIA_STORAGE_ALERT_RECORD_SIZE ];
+} AnyBlob_t;
+
+#undef BLOB_MEMBER
+
+#define BLOB_NAME( NAME, KEY, HASH ) #NAME,
+
+static const char* const g_blobNames[] = { AIA_STORAGE_BLOBS( BLOB_NAME ) };
+
+#undef BLOB_NAME
+
+/** What every blob read back as. */
+typedef struct Snapshot
+{
+    AiaStorageError_t error[ AIA_STORAGE_NUM_BLOBS ];
+    size_t size[ AIA_STORAGE_NUM_BLOBS ];
+    AnyBlob_t data[ AIA_STORAGE_NUM_BLOBS ];
+} Snapshot_t;
+
+/** What a child process of the power-loss mode hands back. */
+typedef struct ChildResult
+{
+    /** Whether the power was cut before the call finished. */
+    bool cut;
+
+    /** Bytes the call programmed or erased. */
+    uint64_t bytes;
+
+    /** Whether a blob stored after the remount read back. */
+    bool probed;
+
+    /** The blobs before the call, or after the remount. */
+    Snapshot_t before;
+
+    /** The blobs after the call. */
+    Snapshot_t after;
+
+    /** The flash when the call finished or the power was cut. */
+    uint8_t image[ DEVICE_SIZE ];
+} ChildResult_t;
+
+/**
+ * Power-loss injection. While armed, programs and erases draw on a budget of
+ * bytes, and the one that exhausts it cuts the power.
+ */
+static struct
+{
+    bool armed;
+    uint64_t budget;
+    uint64_t used;
+
+    /** Where a child process writes its result. */
+    int resultFd;
+
+    /** The result of this child process. */
+    ChildResult_t result;
+} g_cut;
+
+/** Hands the result of a child process to its parent and ends the child. */
+static void finishChild()
+{
+    const uint8_t* bytes = (const uint8_t*)&g_cut.result;
+    size_t left = sizeof( g_cut.result );
+    memcpy( g_cut.result.image, g_device.image, DEVICE_SIZE );
+    while( left )
+    {
+        ssize_t written = write( g_cut.resultFd, bytes, left );
+        if( written <= 0 )
+        {
+            _exit( EXIT_FAILURE );
+        }
+        bytes += written;
+        left -= (size_t)written;
+    }
+    _exit( EXIT_SUCCESS );
+}
+
+/**
+ * Draws on the budget for a program or erase.
+ *
+ * @param size Bytes the program or erase covers.
+ * @return The bytes it reaches before the power is cut, which is @c size if
+ * it is not.
+ */
+static size_t reachBeforeCut( size_t size )
+{
+    if( !g_cut.armed )
+    {
+        return size;
+    }
+    uint64_t left = g_cut.budget - g_cut.used;
+    size_t reached = left < size ? (size_t)left : size;
+    g_cut.used += reached;
+    return reached;
+}
+
+/** Cuts the power in the middle of a program or erase. */
+static void cutPower()
+{
+    g_cut.result.cut = true;
+    g_cut.result.bytes = g_cut.used;
+    finishChild();
+}
+
+void AiaFlashWearSim_Log( const char* level, const char* format, ... )
+{
+    if( !strcmp( level, "ERROR" ) )
+    {
+        ++g_errors;
+    }
+    if( g_verbose )
+    {
+        va_list args;
+        va_start( args, format );
+        fprintf( stderr, "[%s] ", level );
+        vfprintf( stderr, format, args );
+        fputc( '\n', stderr );
+        va_end( args );
+    }
+}
+
+bool AiaStorageFlash_Read( size_t offset, void* data, size_t size )
+{
+    if( offset > DEVICE_SIZE || size > DEVICE_SIZE - offset )
+    {
+        return false;
+    }
+    memcpy( data, g_device.image + offset, size );
+    g_device.bytesRead += size;
+    g_device.timeUs += size * g_device.params.readNs / 1000.0;
+    return true;
+}
+
+bool AiaStorageFlash_Program( size_t offset, const void* data, size_t size )
+{
+    const uint8_t* bytes = data;
+    if( offset > DEVICE_SIZE || size > DEVICE_SIZE - offset ||
+        offset % AIA_STORAGE_FLASH_PROGRAM_SIZE ||
+        size % AIA_STORAGE_FLASH_PROGRAM_SIZE )
+    {
+        return false;
+    }
+    size_t reached = reachBeforeCut( size );
+    for( size_t i = 0; i < reached; ++i )
+    {
+        /* Programming can only clear bits. */
+        if( bytes[ i ] & ~g_device.image[ offset + i ] )
+        {
+            ++g_device.violations;
+        }
+        g_device.image[ offset + i ] &= bytes[ i ];
+    }
+    if( reached < size )
+    {
+        cutPower();
+    }
+    for( size_t unit = offset / AIA_STORAGE_FLASH_PROGRAM_SIZE;
+         unit < ( offset + size ) / AIA_STORAGE_FLASH_PROGRAM_SIZE; ++unit )
+    {
+        if( g_device.params.programOnce && g_device.programmed[ unit ] )
+        {
+            ++g_device.violations;
+        }
+        g_device.programmed[ unit ] = true;
+    }
+    g_device.bytesProgrammed += size;
+    g_device.timeUs += ( size / AIA_STORAGE_FLASH_PROGRAM_SIZE ) *
+                       g_device.params.programUs;
+    return true;
+}
+
+bool AiaStorageFlash_Erase( size_t block )
+{
+    if( block >= AIA_STORAGE_FLASH_NUM_BLOCKS )
+    {
+        return false;
+    }
+    size_t start = block * AIA_STORAGE_FLASH_BLOCK_SIZE;
+    size_t reached = reachBeforeCut( AIA_STORAGE_FLASH_BLOCK_SIZE );
+    memset( g_device.image + start, 0xFF, reached );
+    if( reached < AIA_STORAGE_FLASH_BLOCK_SIZE )
+    {
+        cutPower();
+    }
+    memset( g_device.programmed + start / AIA_STORAGE_FLASH_PROGRAM_SIZE, 0,
+            AIA_STORAGE_FLASH_BLOCK_SIZE / AIA_STORAGE_FLASH_PROGRAM_SIZE );
+    ++g_device.erases[ block ];
+    g_device.timeUs += g_device.params.eraseUs;
+    return true;
+}
+
+/** Accounts for one storage call that started at simulated time @c startUs. */
+static void recordOp( Op_t op, bool success, size_t bytes, double startUs )
+{
+    OpStats_t* stats = &g_opStats[ op ];
+    double elapsedUs = g_device.timeUs - startUs;
+    ++stats->calls;
+    stats->failures += !success;
+    stats->bytes += bytes;
+    stats->timeUs += elapsedUs;
+    if( elapsedUs > stats->maxUs )
+    {
+        stats->maxUs = elapsedUs;
+    }
+}
+
+/** Timers created by the Storage port. */
+static struct
+{
+    AiaTimer_t* timers[ 4 ];
+    size_t count;
+} g_timers;
+
+bool AiaFlashWearSimTimer_Create( AiaTimer_t* timer,
+                                  void ( *routine )( void* ), void* context )
+{
+    if( g_timers.count == sizeof( g_timers.timers ) / sizeof( timer ) )
+    {
+        return false;
+    }
+    timer->routine = routine;
+    timer->context = context;
+    timer->armed = false;
+    g_timers.timers[ g_timers.count++ ] = timer;
+    return true;
+}
+
+bool AiaFlashWearSimTimer_Arm( AiaTimer_t* timer, uint32_t delayMs,
+                               uint32_t periodMs )
+{
+    (void)delayMs;
+    (void)periodMs;
+    timer->armed = true;
+    return true;
+}
+
+void AiaFlashWearSimTimer_Destroy( AiaTimer_t* timer )
+{
+    timer->armed = false;
+}
+
+/** Runs the armed timers, as if their delay had passed. */
+static void expireTimers()
+{
+    for( size_t i = 0; i < g_timers.count; ++i )
+    {
+        AiaTimer_t* timer = g_timers.timers[ i ];
+        if( timer->armed )
+        {
+            double startUs = g_device.timeUs;
+            timer->armed = false;
+            timer->routine( timer->context );
+            recordOp( OP_TIMER, true, 0, startUs );
+        }
+    }
+}
+
+/** Workload state. */
+static struct
+{
+    uint32_t random;
+    uint32_t nextToken;
+    AiaTimepointSeconds_t now;
+
+    /** Alerts believed to be stored, and whether each is a recurring alarm. */
+    AiaStorageAlert_t alerts[ AIA_STORAGE_ALERT_SLOTS ];
+    bool recurring[ AIA_STORAGE_ALERT_SLOTS ];
+    size_t numAlerts;
+} g_workload;
+
+/** The Storage port reads the clock in simulated time. */
+AiaTimepointSeconds_t AiaClock_GetTimeSinceNTPEpoch()
+{
+    return g_workload.now;
+}
+
+static uint32_t nextRandom()
+{
+    /* xorshift32 */
+    uint32_t x = g_workload.random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    g_workload.random = x;
+    return x;
+}
+
+/** @return A number of events this hour for a rate of @c perDay a day. */
+static unsigned eventsThisHour( unsigned perDay )
+{
+    unsigned events = perDay / 24;
+    if( nextRandom() % 24 < perDay % 24 )
+    {
+        ++events;
+    }
+    return events;
+}
+
+static void storeAlert( size_t index )
+{
+    const AiaStorageAlert_t* alert = &g_workload.alerts[ index ];
+    double startUs = g_device.timeUs;
+    bool success =
+        AiaStoreAlert( alert->token, sizeof( alert->token ),
+                       alert->scheduledTime, alert->duration, alert->type );
+    recordOp( OP_STORE_ALERT, success, AIA_STORAGE_ALERT_RECORD_SIZE,
+              startUs );
+}
+
+/**
+ * Adds an alert with a fresh token to those believed to be stored, without
+ * storing it.
+ *
+ * @return The index of the alert, or @c AIA_STORAGE_ALERT_SLOTS if there is
+ * no room.
+ */
+static size_t newAlert( bool recurring, AiaTimepointSeconds_t scheduledTime,
+                        uint8_t type )
+{
+    if( g_workload.numAlerts == AIA_STORAGE_ALERT_SLOTS )
+    {
+        return AIA_STORAGE_ALERT_SLOTS;
+    }
+    size_t index = g_workload.numAlerts++;
+    AiaStorageAlert_t* alert = &g_workload.alerts[ index ];
+    char serial[ 16 ];
+    memset( alert->token, 'A', sizeof( alert->token ) );
+    snprintf( serial, sizeof( serial ), "%08" PRIx32,
+              g_workload.nextToken++ );
+    memcpy( alert->token, serial, 8 );
+    alert->scheduledTime = scheduledTime;
+    alert->duration = 60000;
+    alert->type = type;
+    g_workload.recurring[ index ] = recurring;
+    return index;
+}
+
+static void addAlert( bool recurring, AiaTimepointSeconds_t scheduledTime,
+                      uint8_t type )
+{
+    size_t index = newAlert( recurring, scheduledTime, type );
+    if( index < AIA_STORAGE_ALERT_SLOTS )
+    {
+        storeAlert( index );
+    }
+}
+
+/** Drops an alert from those believed to be stored. */
+static void forgetAlert( size_t index )
+{
+    size_t last = --g_workload.numAlerts;
+    g_workload.alerts[ index ] = g_workload.alerts[ last ];
+    g_workload.recurring[ index ] = g_workload.recurring[ last ];
+}
+
+static void removeAlert( size_t index )
+{
+    double startUs = g_device.timeUs;
+    bool success = AiaDeleteAlert( g_workload.alerts[ index ].token,
+                                   sizeof( g_workload.alerts[ index ].token ) );
+    recordOp( OP_DELETE_ALERT, success, 0, startUs );
+    forgetAlert( index );
+}
+
+static void reRegister()
+{
+    uint8_t secret[ AIA_STORAGE_SHARED_SECRET_CAPACITY ];
+    uint8_t topicRoot[ AIA_STORAGE_TOPIC_ROOT_CAPACITY ];
+    for( size_t i = 0; i < sizeof( secret ); ++i )
+    {
+        secret[ i ] = (uint8_t)nextRandom();
+    }
+    memset( topicRoot, 't', sizeof( topicRoot ) );
+
+    double startUs = g_device.timeUs;
+    bool success =
+        AiaStorage_BeginTransaction() &&
+        AiaStoreSecret( secret, sizeof( secret ) ) &&
+        AiaStoreBlob( "AiaTopicRootKey", topicRoot, sizeof( topicRoot ) );
+    success = success ? AiaStorage_CommitTransaction()
+                      : ( AiaStorage_AbortTransaction(), false );
+    recordOp( OP_REGISTER, success, sizeof( secret ) + sizeof( topicRoot ),
+              startUs );
+}
+
+/** Changes the volume in a burst of steps in the same direction. */
+static void changeVolume()
+{
+    static uint8_t volume = AIA_DEFAULT_VOLUME;
+    unsigned steps = 1 + nextRandom() % 8;
+    bool up = nextRandom() % 2;
+    for( unsigned i = 0; i < steps; ++i )
+    {
+        if( up && volume < AIA_MAX_VOLUME )
+        {
+            ++volume;
+        }
+        else if( !up && volume > AIA_MIN_VOLUME )
+        {
+            --volume;
+        }
+        double startUs = g_device.timeUs;
+        bool success = AiaStoreVolume( volume );
+        recordOp( OP_STORE_VOLUME, success, sizeof( volume ), startUs );
+    }
+}
+
+static void simulateHour( unsigned timersPerDay, unsigned reconnectsPerDay,
+                          unsigned volumeChangesPerDay, bool idleCompaction )
+{
+    /* Fire due alerts: timers go away, alarms move to the next day. */
+    for( size_t i = 0; i < g_workload.numAlerts; )
+    {
+        AiaStorageAlert_t* alert = &g_workload.alerts[ i ];
+        if( alert->scheduledTime > g_workload.now )
+        {
+            ++i;
+        }
+        else if( g_workload.recurring[ i ] )
+        {
+            alert->scheduledTime += SECONDS_PER_DAY;
+            storeAlert( i++ );
+        }
+        else
+        {
+            removeAlert( i );
+        }
+    }
+
+    for( unsigned i = eventsThisHour( timersPerDay ); i; --i )
+    {
+        AiaTimepointSeconds_t in = 60 * ( 1 + nextRandom() % 180 );
+        addAlert( false, g_workload.now + in, 0 );
+    }
+
+    /* Now and then a timer gets extended. */
+    if( g_workload.numAlerts && nextRandom() % 10 == 0 )
+    {
+        size_t index = nextRandom() % g_workload.numAlerts;
+        if( !g_workload.recurring[ index ] )
+        {
+            g_workload.alerts[ index ].scheduledTime += 300;
+            storeAlert( index );
+        }
+    }
+
+    for( unsigned i = eventsThisHour( reconnectsPerDay ); i; --i )
+    {
+        double startUs = g_device.timeUs;
+        bool success =
+            AiaReplaceAlerts( g_workload.alerts, g_workload.numAlerts );
+        recordOp( OP_REPLACE_ALERTS, success,
+                  g_workload.numAlerts * AIA_STORAGE_ALERT_RECORD_SIZE,
+                  startUs );
+    }
+
+    for( unsigned i = eventsThisHour( volumeChangesPerDay ); i; --i )
+    {
+        changeVolume();
+    }
+    expireTimers();
+
+    if( idleCompaction )
+    {
+        double startUs = g_device.timeUs;
+        AiaStorageLog_Compact();
+        recordOp( OP_COMPACT, true, 0, startUs );
+    }
+}
+
+/** A storage call of the power-loss mode. */
+typedef struct Step
+{
+    Op_t op;
+    AiaStorageAlert_t alert;
+    uint8_t volume;
+
+    /** The secret stored by a registration. */
+    uint8_t secret[ AIA_STORAGE_SHARED_SECRET_CAPACITY ];
+
+    /** The alerts a replacement leaves. */
+    AiaStorageAlert_t alerts[ AIA_STORAGE_ALERT_SLOTS ];
+    size_t numAlerts;
+} Step_t;
+
+/** Outcomes of the power-loss mode. */
+static struct
+{
+    uint64_t cuts;
+    uint64_t kept;
+    uint64_t updated;
+    uint64_t corrupted;
+    uint64_t commitsKept;
+    uint64_t commitsApplied;
+    uint64_t failures;
+} g_powerLoss;
+
+/** Picks the next call of the power-loss mode. */
+static void nextStep( Step_t* step )
+{
+    unsigned choice = nextRandom() % 10;
+    size_t index;
+    memset( step, 0, sizeof( *step ) );
+    if( choice < 3 && g_workload.numAlerts < AIA_STORAGE_ALERT_SLOTS )
+    {
+        AiaTimepointSeconds_t in = 60 * ( 1 + nextRandom() % 180 );
+        index = newAlert( false, g_workload.now + in, 0 );
+        step->op = OP_STORE_ALERT;
+        step->alert = g_workload.alerts[ index ];
+    }
+    else if( choice < 6 && g_workload.numAlerts )
+    {
+        index = nextRandom() % g_workload.numAlerts;
+        step->alert = g_workload.alerts[ index ];
+        if( choice < 5 )
+        {
+            g_workload.alerts[ index ].scheduledTime += 300;
+            step->op = OP_STORE_ALERT;
+            step->alert.scheduledTime += 300;
+        }
+        else
+        {
+            step->op = OP_DELETE_ALERT;
+            forgetAlert( index );
+        }
+    }
+    else if( choice < 7 )
+    {
+        step->op = OP_STORE_VOLUME;
+        step->volume = (uint8_t)( nextRandom() % ( AIA_MAX_VOLUME + 1 ) );
+    }
+    else if( choice < 8 )
+    {
+        step->op = OP_REGISTER;
+        for( size_t i = 0; i < sizeof( step->secret ); ++i )
+        {
+            step->secret[ i ] = (uint8_t)nextRandom();
+        }
+    }
+    else if( choice < 9 )
+    {
+        /* A SynchronizeState that drops one alert and moves the others. */
+        if( g_workload.numAlerts )
+        {
+            forgetAlert( nextRandom() % g_workload.numAlerts );
+        }
+        for( index = 0; index < g_workload.numAlerts; ++index )
+        {
+            g_workload.alerts[ index ].scheduledTime += 60;
+        }
+        step->op = OP_REPLACE_ALERTS;
+        step->numAlerts = g_workload.numAlerts;
+        memcpy( step->alerts, g_workload.alerts,
+                g_workload.numAlerts * sizeof( g_workload.alerts[ 0 ] ) );
+    }
+    else
+    {
+        step->op = OP_COMPACT;
+    }
+}
+
+/** @return Whether @c step writes all of its blobs or none of them. */
+static bool isAtomic( const Step_t* step )
+{
+    return step->op == OP_REGISTER || step->op == OP_REPLACE_ALERTS;
+}
+
+/** Makes the storage call of @c step. */
+static void runStep( const Step_t* step )
+{
+    const AiaStorageAlert_t* alert = &step->alert;
+    switch( step->op )
+    {
+        case OP_STORE_ALERT:
+            AiaStoreAlert( alert->token, sizeof( alert->token ),
+                           alert->scheduledTime, alert->duration,
+                           alert->type );
+            break;
+        case OP_DELETE_ALERT:
+            AiaDeleteAlert( alert->token, sizeof( alert->token ) );
+            break;
+        case OP_STORE_VOLUME:
+            AiaStoreVolume( step->volume );
+            expireTimers();
+            break;
+        case OP_REGISTER:
+        {
+            uint8_t topicRoot[ AIA_STORAGE_TOPIC_ROOT_CAPACITY ];
+            memset( topicRoot, step->secret[ 0 ], sizeof( topicRoot ) );
+            if( !AiaStorage_BeginTransaction() )
+            {
+                break;
+            }
+            if( AiaStoreSecret( step->secret, sizeof( step->secret ) ) &&
+                AiaStoreBlobById( AIA_STORAGE_BLOB_TOPIC_ROOT, topicRoot,
+                                  sizeof( topicRoot ) ) )
+            {
+                AiaStorage_CommitTransaction();
+            }
+            else
+            {
+                AiaStorage_AbortTransaction();
+            }
+            break;
+        }
+        case OP_REPLACE_ALERTS:
+            AiaReplaceAlerts( step->alerts, step->numAlerts );
+            break;
+        default:
+            AiaStorageLog_Compact();
+            break;
+    }
+}
+
+static void takeSnapshot( Snapshot_t* snapshot )
+{
+    for( size_t id = 0; id < AIA_STORAGE_NUM_BLOBS; ++id )
+    {
+        snapshot->size[ id ] = AiaGetBlobSizeById( (AiaStorageBlobId_t)id );
+        snapshot->error[ id ] =
+            AiaLoadBlobById( (AiaStorageBlobId_t)id,
+                             (uint8_t*)&snapshot->data[ id ],
+                             sizeof( snapshot->data[ id ] ) )
+                ? AIA_STORAGE_ERROR_NONE
+                : AiaStorage_GetLastError();
+    }
+}
+
+/** Child process that mounts the log and makes a call, maybe cut short. */
+static void runStepChild( const Step_t* step )
+{
+    takeSnapshot( &g_cut.result.before );
+    g_cut.armed = true;
+    runStep( step );
+    g_cut.armed = false;
+    g_cut.result.bytes = g_cut.used;
+    takeSnapshot( &g_cut.result.after );
+}
+
+/** Child process that remounts the log and stores a blob. */
+static void remountChild( const Step_t* step )
+{
+    uint8_t probe[ AIA_STORAGE_TOPIC_ROOT_CAPACITY ];
+    uint8_t loaded[ sizeof( probe ) ];
+    (void)step;
+    takeSnapshot( &g_cut.result.before );
+    memset( probe, 'p', sizeof( probe ) );
+    g_cut.result.probed =
+        AiaStoreBlobById( AIA_STORAGE_BLOB_TOPIC_ROOT, probe,
+                          sizeof( probe ) ) &&
+        AiaLoadBlobById( AIA_STORAGE_BLOB_TOPIC_ROOT, loaded,
+                         sizeof( loaded ) ) &&
+        !memcmp( probe, loaded, sizeof( probe ) );
+}
+
+/**
+ * Runs @c body in a child process on the current image.
+ *
+ * @param[out] result Receives what the child hands back.
+ * @return @c true if the child handed back a result.
+ */
+static bool runChild( void ( *body )( const Step_t* ), const Step_t* step,
+                      ChildResult_t* result )
+{
+    int fds[ 2 ];
+    int status;
+    size_t got = 0;
+    if( pipe( fds ) )
+    {
+        return false;
+    }
+    fflush( NULL );
+    pid_t pid = fork();
+    if( pid == 0 )
+    {
+        close( fds[ 0 ] );
+        g_cut.resultFd = fds[ 1 ];
+        body( step );
+        finishChild();
+    }
+    close( fds[ 1 ] );
+    while( pid > 0 && got < sizeof( *result ) )
+    {
+        ssize_t n =
+            read( fds[ 0 ], (uint8_t*)result + got, sizeof( *result ) - got );
+        if( n <= 0 )
+        {
+            break;
+        }
+        got += (size_t)n;
+    }
+    close( fds[ 0 ] );
+    if( pid < 0 || waitpid( pid, &status, 0 ) != pid )
+    {
+        return false;
+    }
+    return got == sizeof( *result ) && WIFEXITED( status ) &&
+           WEXITSTATUS( status ) == EXIT_SUCCESS;
+}
+
+static bool sameBlob( const Snapshot_t* a, const Snapshot_t* b, size_t id )
+{
+    return a->error[ id ] == AIA_STORAGE_ERROR_NONE &&
+           b->error[ id ] == AIA_STORAGE_ERROR_NONE &&
+           a->size[ id ] == b->size[ id ] &&
+           !memcmp( &a->data[ id ], &b->data[ id ], a->size[ id ] );
+}
+
+static void printFailure( unsigned step, const Step_t* s, uint64_t cut,
+                          uint64_t bytes, const char* what, size_t id )
+{
+    if( ++g_powerLoss.failures > 10 )
+    {
+        return;
+    }
+    printf( "call %u (%s), cut after %" PRIu64 " of %" PRIu64 " bytes: ",
+            step, g_opNames[ s->op ], cut, bytes );
+    if( id < AIA_STORAGE_BLOB_ALERT_SLOT_0 )
+    {
+        printf( "%s %s\n", g_blobNames[ id ], what );
+    }
+    else if( id < AIA_STORAGE_NUM_BLOBS )
+    {
+        printf( "alert slot %zu %s\n", id - AIA_STORAGE_BLOB_ALERT_SLOT_0,
+                what );
+    }
+    else
+    {
+        printf( "%s\n", what );
+    }
+}
+
+/**
+ * Checks the blobs a remount found after a cut against those before and after
+ * the call.
+ */
+static void checkRemount( unsigned step, const Step_t* s, uint64_t cut,
+                          const ChildResult_t* run,
+                          const ChildResult_t* remount )
+{
+    const Snapshot_t* found = &remount->before;
+    size_t kept = 0;
+    size_t updated = 0;
+    ++g_powerLoss.cuts;
+    if( !remount->probed )
+    {
+        printFailure( step, s, cut, run->bytes,
+                      "no blob could be stored after the remount",
+                      AIA_STORAGE_NUM_BLOBS );
+    }
+    for( size_t id = 0; id < AIA_STORAGE_NUM_BLOBS; ++id )
+    {
+        bool changed = !sameBlob( &run->before, &run->after, id );
+        if( sameBlob( found, &run->before, id ) )
+        {
+            kept += changed;
+        }
+        else if( changed && sameBlob( found, &run->after, id ) )
+        {
+            ++updated;
+        }
+        else if( changed && !isAtomic( s ) &&
+                 found->error[ id ] == AIA_STORAGE_ERROR_CORRUPTED )
+        {
+            ++g_powerLoss.corrupted;
+        }
+        else
+        {
+            printFailure( step, s, cut, run->bytes,
+                          changed ? "is neither old, new nor corrupted"
+                                  : "changed",
+                          id );
+        }
+    }
+    g_powerLoss.kept += kept;
+    g_powerLoss.updated += updated;
+
+    /* A commit lands whole or not at all. */
+    if( isAtomic( s ) && kept && updated )
+    {
+        printFailure( step, s, cut, run->bytes,
+                      "the commit was applied in part",
+                      AIA_STORAGE_NUM_BLOBS );
+    }
+    else if( isAtomic( s ) && updated )
+    {
+        ++g_powerLoss.commitsApplied;
+    }
+    else if( isAtomic( s ) && kept )
+    {
+        ++g_powerLoss.commitsKept;
+    }
+}
+
+/** Runs the power-loss mode for @c steps calls. */
+static void simulatePowerLoss( unsigned steps )
+{
+    static ChildResult_t run;
+    static ChildResult_t trial;
+    static ChildResult_t remount;
+    static uint8_t base[ DEVICE_SIZE ];
+    Step_t step;
+
+    for( unsigned i = 0; i < steps; ++i )
+    {
+        g_workload.now = (AiaTimepointSeconds_t)i * 60;
+        nextStep( &step );
+        memcpy( base, g_device.image, DEVICE_SIZE );
+        g_cut.budget = UINT64_MAX;
+        if( !runChild( runStepChild, &step, &run ) )
+        {
+            printFailure( i, &step, 0, 0, "the call did not finish",
+                          AIA_STORAGE_NUM_BLOBS );
+            return;
+        }
+
+        /* A cut after the last byte is a clean shutdown. */
+        for( uint64_t cut = 0; cut <= run.bytes; ++cut )
+        {
+            const uint8_t* image = run.image;
+            if( cut < run.bytes )
+            {
+                g_cut.budget = cut;
+                if( !runChild( runStepChild, &step, &trial ) || !trial.cut )
+                {
+                    printFailure( i, &step, cut, run.bytes,
+                                  "the cut call did not stop at the cut",
+                                  AIA_STORAGE_NUM_BLOBS );
+                    continue;
+                }
+                image = trial.image;
+            }
+            memcpy( g_device.image, image, DEVICE_SIZE );
+            if( !runChild( remountChild, &step, &remount ) )
+            {
+                printFailure( i, &step, cut, run.bytes,
+                              "the remount did not finish",
+                              AIA_STORAGE_NUM_BLOBS );
+            }
+            else
+            {
+                checkRemount( i, &step, cut, &run, &remount );
+            }
+            memcpy( g_device.image, base, DEVICE_SIZE );
+        }
+        memcpy( g_device.image, run.image, DEVICE_SIZE );
+    }
+}
+
+static void reportPowerLoss( unsigned steps )
+{
+    printf( "device: %d blocks of %d bytes, %d-byte program unit\n",
+            AIA_STORAGE_FLASH_NUM_BLOCKS, AIA_STORAGE_FLASH_BLOCK_SIZE,
+            AIA_STORAGE_FLASH_PROGRAM_SIZE );
+    printf( "storage calls:          %u\n", steps );
+    printf( "power cuts:             %" PRIu64 "\n", g_powerLoss.cuts );
+    printf( "changed blobs found:    %" PRIu64 " old, %" PRIu64
+            " new, %" PRIu64 " corrupted\n",
+            g_powerLoss.kept, g_powerLoss.updated, g_powerLoss.corrupted );
+    printf( "commits found:          %" PRIu64 " not applied, %" PRIu64
+            " applied\n",
+            g_powerLoss.commitsKept, g_powerLoss.commitsApplied );
+    printf( "failures:               %" PRIu64 "\n", g_powerLoss.failures );
+}
+
+static void report( unsigned days )
+{
+    uint64_t requested = 0;
+    uint32_t minErases = UINT32_MAX;
+    uint32_t maxErases = 0;
+    uint64_t totalErases = 0;
+    for( size_t op = 0; op < NUM_OPS; ++op )
+    {
+        requested += g_opStats[ op ].bytes;
+    }
+    for( size_t block = 0; block < AIA_STORAGE_FLASH_NUM_BLOCKS; ++block )
+    {
+        uint32_t erases = g_device.erases[ block ];
+        minErases = erases < minErases ? erases : minErases;
+        maxErases = erases > maxErases ? erases : maxErases;
+        totalErases += erases;
+    }
+
+    printf( "device: %d blocks of %d bytes, %d-byte program unit, %s\n",
+            AIA_STORAGE_FLASH_NUM_BLOCKS, AIA_STORAGE_FLASH_BLOCK_SIZE,
+            AIA_STORAGE_FLASH_PROGRAM_SIZE,
+            g_device.params.programOnce ? "program once" : "NOR" );
+    printf( "simulated days:         %u\n", days );
+    printf( "bytes requested:        %" PRIu64 "\n", requested );
+    printf( "bytes programmed:       %" PRIu64 "\n",
+            g_device.bytesProgrammed );
+    printf( "write amplification:    %.2f\n",
+            requested ? (double)g_device.bytesProgrammed / requested : 0.0 );
+    printf( "bytes read:             %" PRIu64 "\n", g_device.bytesRead );
+    printf( "erases:                 %" PRIu64 " (per block min %" PRIu32
+            ", mean %.1f, max %" PRIu32 ")\n",
+            totalErases, minErases,
+            (double)totalErases / AIA_STORAGE_FLASH_NUM_BLOCKS, maxErases );
+    if( maxErases )
+    {
+        double erasesPerDay = (double)maxErases / days;
+        printf( "projected lifetime:     %.1f years at %" PRIu32
+                " cycles\n",
+                g_device.params.endurance / erasesPerDay / 365.0,
+                g_device.params.endurance );
+    }
+    else
+    {
+        printf( "projected lifetime:     no block was erased\n" );
+    }
+    printf( "programming violations: %" PRIu64 "\n", g_device.violations );
+    printf( "storage errors logged:  %" PRIu64 "\n", g_errors );
+    printf( "flash time:             %.1f s\n", g_device.timeUs / 1e6 );
+
+    printf( "\n%-22s %10s %8s %10s %10s\n", "call", "count", "failed",
+            "mean ms", "max ms" );
+    for( size_t op = 0; op < NUM_OPS; ++op )
+    {
+        const OpStats_t* stats = &g_opStats[ op ];
+        printf( "%-22s %10" PRIu64 " %8" PRIu64 " %10.3f %10.3f\n",
+                g_opNames[ op ], stats->calls, stats->failures,
+                stats->calls ? stats->timeUs / stats->calls / 1000.0 : 0.0,
+                stats->maxUs / 1000.0 );
+    }
+}
+
+static void usage( const char* program )
+{
+    fprintf( stderr,
+             "usage: %s [-E us] [-P us] [-R ns] [-C cycles] [-1] [-d days] "
+             "[-t timers] [-a alarms] [-r reconnects] [-k days] [-V changes] "
+             "[-c] [-s seed] [-v] [-p calls]\n",
+             program );
+}
+
+int main( int argc, char** argv )
+{
+    DeviceParams_t params = { 45000, 11, 20, 100000, false };
+    unsigned days = 365;
+    unsigned timersPerDay = 6;
+    unsigned alarms = 2;
+    unsigned reconnectsPerDay = 4;
+    unsigned rotationDays = 30;
+    unsigned volumeChangesPerDay = 4;
+    bool idleCompaction = true;
+    uint32_t seed = 1;
+    unsigned powerLossSteps = 0;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        bool hasValue = i + 1 < argc;
+        if( !strcmp( argv[ i ], "-E" ) && hasValue )
+        {
+            params.eraseUs = strtod( argv[ ++i ], NULL );
+        }
+        else if( !strcmp( argv[ i ], "-P" ) && hasValue )
+        {
+            params.programUs = strtod( argv[ ++i ], NULL );
+        }
+        else if( !strcmp( argv[ i ], "-R" ) && hasValue )
+        {
+            params.readNs = strtod( argv[ ++i ], NULL );
+        }
+        else if( !strcmp( argv[ i ], "-C" ) && hasValue )
+        {
+            params.endurance = strtoul( argv[ ++i ], NULL, 0 );
+        }
+        else if( !strcmp( argv[ i ], "-1" ) )
+        {
+            params.programOnce = true;
+        }
+        else if( !strcmp( argv[ i ], "-d" ) && hasValue )
+        {
+            days = strtoul( argv[ ++i ], NULL, 0 );
+        }
+        else if( !strcmp( argv[ i ], "-t" ) && hasValue )
+        {
+            timersPerDay = strtoul( argv[ ++i ], NULL, 0 );
+        }
+        else if( !strcmp( argv[ i ], "-a" ) && hasValue )
+        {
+            alarms = strtoul( argv[ ++i ], NULL, 0 );
+        }
+        else if( !strcmp( argv[ i ], "-r" ) && hasValue )
+        {
+            reconnectsPerDay = strtoul( argv[ ++i ], NULL, 0 );
+        }
+        else if( !strcmp( argv[ i ], "-k" ) && hasValue )
+        {
+            rotationDays = strtoul( argv[ ++i ], NULL, 0 );
+        }
+        else if( !strcmp( argv[ i ], "-V" ) && hasValue )
+        {
+            volumeChangesPerDay = strtoul( argv[ ++i ], NULL, 0 );
+        }
+        else if( !strcmp( argv[ i ], "-c" ) )
+        {
+            idleCompaction = false;
+        }
+        else if( !strcmp( argv[ i ], "-s" ) && hasValue )
+        {
+            seed = strtoul( argv[ ++i ], NULL, 0 );
+        }
+        else if( !strcmp( argv[ i ], "-v" ) )
+        {
+            g_verbose = true;
+        }
+        else if( !strcmp( argv[ i ], "-p" ) && hasValue )
+        {
+            powerLossSteps = strtoul( argv[ ++i ], NULL, 0 );
+        }
+        else
+        {
+            usage( argv[ 0 ] );
+            return EXIT_FAILURE;
+        }
+    }
+    if( !days )
+    {
+        usage( argv[ 0 ] );
+        return EXIT_FAILURE;
+    }
+
+    /* The device starts out erased. */
+    g_device.params = params;
+    memset( g_device.image, 0xFF, sizeof( g_device.image ) );
+    g_workload.random = seed ? seed : 1;
+
+    if( powerLossSteps )
+    {
+        simulatePowerLoss( powerLossSteps );
+        reportPowerLoss( powerLossSteps );
+        return g_powerLoss.failures ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    reRegister();
+    for( unsigned i = 0; i < alarms; ++i )
+    {
+        addAlert( true, SECONDS_PER_HOUR * ( 6 + nextRandom() % 4 ), 1 );
+    }
+
+    for( unsigned day = 0; day < days; ++day )
+    {
+        if( day && rotationDays && day % rotationDays == 0 )
+        {
+            reRegister();
+        }
+        for( unsigned hour = 0; hour < 24; ++hour )
+        {
+            g_workload.now =
+                (AiaTimepointSeconds_t)day * SECONDS_PER_DAY +
+                hour * SECONDS_PER_HOUR;
+            simulateHour( timersPerDay, reconnectsPerDay,
+                          volumeChangesPerDay, idleCompaction );
+        }
+    }
+
+    report( days );
+    return g_device.violations || g_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
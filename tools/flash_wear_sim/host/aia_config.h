@@ -0,0 +1,97 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file aia_config.h
+ * @brief Host stand-in for @c ports/include/aia_config.h, so that the Storage
+ * port builds into @c aia_flash_wear_sim without FreeRTOS. Only what the
+ * Storage sources use is provided.
+ */
+
+#ifndef AIA_CONFIG_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define AIA_CONFIG_H_
+
+#include <storage/aia_storage_config.h>
+
+#include <aia_capabilities_config.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Logs a message from the Storage port.
+ *
+ * @param level Name of the log level.
+ * @param format printf-style format.
+ */
+void AiaFlashWearSim_Log( const char* level, const char* format, ... );
+
+#define AiaLogError( ... ) AiaFlashWearSim_Log( "ERROR", __VA_ARGS__ )
+#define AiaLogWarn( ... ) AiaFlashWearSim_Log( "WARN", __VA_ARGS__ )
+#define AiaLogInfo( ... ) AiaFlashWearSim_Log( "INFO", __VA_ARGS__ )
+#define AiaLogDebug( ... ) AiaFlashWearSim_Log( "DEBUG", __VA_ARGS__ )
+
+/* The simulation is single-threaded, so the mutex does nothing. */
+#define AiaMutex( MEMBER ) AiaFlashWearSimMutex_##MEMBER
+#define AiaFlashWearSimMutex_HEADER <aia_config.h>
+typedef int AiaMutex_t;
+
+static inline bool AiaFlashWearSimMutex_Create( AiaMutex_t* mutex,
+                                                bool recursive )
+{
+    (void)recursive;
+    *mutex = 0;
+    return true;
+}
+
+static inline void AiaFlashWearSimMutex_Lock( AiaMutex_t* mutex )
+{
+    (void)mutex;
+}
+
+static inline void AiaFlashWearSimMutex_Unlock( AiaMutex_t* mutex )
+{
+    (void)mutex;
+}
+
+/**
+ * Timers run in simulated time: an armed timer expires at the end of the
+ * simulated hour, which is longer than any delay the Storage port uses.
+ */
+#define AiaTimer( MEMBER ) AiaFlashWearSimTimer_##MEMBER
+#define AiaFlashWearSimTimer_HEADER <aia_config.h>
+
+typedef struct AiaFlashWearSimTimer
+{
+    void ( *routine )( void* );
+    void* context;
+    bool armed;
+} AiaTimer_t;
+
+bool AiaFlashWearSimTimer_Create( AiaTimer_t* timer,
+                                  void ( *routine )( void* ), void* context );
+bool AiaFlashWearSimTimer_Arm( AiaTimer_t* timer, uint32_t delayMs,
+                               uint32_t periodMs );
+void AiaFlashWearSimTimer_Destroy( AiaTimer_t* timer );
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* ifndef AIA_CONFIG_H_ */
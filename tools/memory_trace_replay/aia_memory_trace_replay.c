@@ -0,0 +1,722 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file aia_memory_trace_replay.c
+ * @brief Host tool that replays an allocation trace captured with @c
+ * AIA_MEMORY_TRACE_ENABLE against models of FreeRTOS heap_4, heap_5 and the
+ * Memory port block pools.
+ *
+ * Build and run on the host:
+ *
+ *     cc -std=c99 -O2 -o aia_memory_trace_replay aia_memory_trace_replay.c
+ *     ./aia_memory_trace_replay [options] device.log
+ *
+ * The input is the console log of a session that ended with a call to @c
+ * AiaMemory_DumpTrace(). Lines without the @c AIATRACE marker are ignored, so
+ * the raw log can be passed as is.
+ *
+ * Options:
+ *   -H bytes        Size of the heap_4 heap, and of the heap behind the
+ *                   pools (default 65536).
+ *   -R b1,b2,...    Sizes of the heap_5 regions (default two halves of -H).
+ *   -P s1xc1,...    Pool classes as blockSize x blockCount (default matches
+ *                   AIA_MEMORY_POOL_CLASSES).
+ *   -o bytes        Overhead to add to every request, e.g. 8 to model a
+ *                   build with AIA_MEMORY_STATS_ENABLE (default 0).
+ *
+ * For each model the tool reports peak heap usage including block headers,
+ * the lowest free space seen, fragmentation (1 - largest free block / total
+ * free space) at the peak and at its worst, failed allocations, and the
+ * worst-case number of free list blocks visited by a single allocation or
+ * release, which is what bounds allocation latency with these allocators.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Maximum number of heap_5 regions or pool classes. */
+#define MAX_REGIONS 16
+#define MAX_CLASSES 16
+
+/** heap_4 and heap_5 block header size and alignment on a 32-bit target. */
+#define HEAP_HEADER_SIZE 8
+#define HEAP_ALIGNMENT 8
+#define HEAP_MINIMUM_BLOCK_SIZE ( HEAP_HEADER_SIZE * 2 )
+
+/** A trace event. */
+typedef struct TraceEvent
+{
+    char op;
+    uint32_t address;
+    uint32_t size;
+} TraceEvent_t;
+
+/** A contiguous span of heap memory. */
+typedef struct Span
+{
+    size_t start;
+    size_t size;
+} Span_t;
+
+/**
+ * Model of heap_4 (one region) and heap_5 (several regions): an address
+ * ordered first-fit free list with splitting and coalescing.
+ */
+typedef struct Heap
+{
+    Span_t* freeList;
+    size_t numFree;
+    size_t capacity;
+    size_t totalSize;
+    size_t freeBytes;
+} Heap_t;
+
+/** Model of one block pool class. */
+typedef struct PoolClass
+{
+    size_t blockSize;
+    size_t blockCount;
+    size_t inUse;
+    size_t peakInUse;
+} PoolClass_t;
+
+/** Where a live allocation of a model came from. */
+typedef struct Placement
+{
+    /** Pool class index, or @c SIZE_MAX for the heap. */
+    size_t poolClass;
+
+    /** Span taken from the heap. */
+    Span_t span;
+} Placement_t;
+
+/** Results of replaying a trace against a model. */
+typedef struct Report
+{
+    size_t peakUsed;
+    size_t minFree;
+    double fragmentationAtPeak;
+    double worstFragmentation;
+    size_t failed;
+    size_t worstAllocateSteps;
+    size_t worstFreeSteps;
+    size_t poolFallbacks;
+} Report_t;
+
+/** Open-addressed map from trace addresses to live placements. */
+typedef struct LiveMap
+{
+    uint32_t* keys;
+    Placement_t* values;
+    bool* used;
+    size_t capacity;
+} LiveMap_t;
+
+static void* checkedAlloc( size_t count, size_t size )
+{
+    void* ptr = calloc( count ? count : 1, size );
+    if( !ptr )
+    {
+        fprintf( stderr, "Out of memory\n" );
+        exit( EXIT_FAILURE );
+    }
+    return ptr;
+}
+
+static bool heapInit( Heap_t* heap, const size_t* regions, size_t numRegions )
+{
+    memset( heap, 0, sizeof( *heap ) );
+    heap->capacity = 64;
+    heap->freeList = checkedAlloc( heap->capacity, sizeof( Span_t ) );
+
+    /* Regions are laid out with a gap between them so they never coalesce. */
+    size_t start = HEAP_ALIGNMENT;
+    for( size_t i = 0; i < numRegions; ++i )
+    {
+        size_t size = regions[ i ] & ~(size_t)( HEAP_ALIGNMENT - 1 );
+        if( size < HEAP_MINIMUM_BLOCK_SIZE )
+        {
+            fprintf( stderr, "Region %zu is too small\n", i );
+            return false;
+        }
+        heap->freeList[ heap->numFree ].start = start;
+        heap->freeList[ heap->numFree ].size = size;
+        ++heap->numFree;
+        heap->totalSize += size;
+        start += size + HEAP_ALIGNMENT;
+    }
+    heap->freeBytes = heap->totalSize;
+    return true;
+}
+
+static void heapDestroy( Heap_t* heap )
+{
+    free( heap->freeList );
+}
+
+static bool heapAllocate( Heap_t* heap, size_t size, Span_t* span,
+                          size_t* steps )
+{
+    size_t wanted = size + HEAP_HEADER_SIZE;
+    if( wanted < size )
+    {
+        return false;
+    }
+    wanted = ( wanted + HEAP_ALIGNMENT - 1 ) & ~(size_t)( HEAP_ALIGNMENT - 1 );
+
+    for( size_t i = 0; i < heap->numFree; ++i )
+    {
+        ++*steps;
+        Span_t* block = &heap->freeList[ i ];
+        if( block->size < wanted )
+        {
+            continue;
+        }
+
+        span->start = block->start;
+        if( block->size - wanted > HEAP_MINIMUM_BLOCK_SIZE )
+        {
+            span->size = wanted;
+            block->start += wanted;
+            block->size -= wanted;
+        }
+        else
+        {
+            span->size = block->size;
+            memmove( block, block + 1,
+                     ( heap->numFree - i - 1 ) * sizeof( Span_t ) );
+            --heap->numFree;
+        }
+        heap->freeBytes -= span->size;
+        return true;
+    }
+    return false;
+}
+
+static void heapFree( Heap_t* heap, Span_t span, size_t* steps )
+{
+    size_t i = 0;
+    while( i < heap->numFree && heap->freeList[ i ].start < span.start )
+    {
+        ++*steps;
+        ++i;
+    }
+    heap->freeBytes += span.size;
+
+    bool mergesPrevious =
+        i > 0 && heap->freeList[ i - 1 ].start + heap->freeList[ i - 1 ].size ==
+                     span.start;
+    bool mergesNext = i < heap->numFree &&
+                      span.start + span.size == heap->freeList[ i ].start;
+
+    if( mergesPrevious && mergesNext )
+    {
+        heap->freeList[ i - 1 ].size += span.size + heap->freeList[ i ].size;
+        memmove( &heap->freeList[ i ], &heap->freeList[ i + 1 ],
+                 ( heap->numFree - i - 1 ) * sizeof( Span_t ) );
+        --heap->numFree;
+    }
+    else if( mergesPrevious )
+    {
+        heap->freeList[ i - 1 ].size += span.size;
+    }
+    else if( mergesNext )
+    {
+        heap->freeList[ i ].start = span.start;
+        heap->freeList[ i ].size += span.size;
+    }
+    else
+    {
+        if( heap->numFree == heap->capacity )
+        {
+            heap->capacity *= 2;
+            Span_t* grown = realloc( heap->freeList,
+                                     heap->capacity * sizeof( Span_t ) );
+            if( !grown )
+            {
+                fprintf( stderr, "Out of memory\n" );
+                exit( EXIT_FAILURE );
+            }
+            heap->freeList = grown;
+        }
+        memmove( &heap->freeList[ i + 1 ], &heap->freeList[ i ],
+                 ( heap->numFree - i ) * sizeof( Span_t ) );
+        heap->freeList[ i ] = span;
+        ++heap->numFree;
+    }
+}
+
+static double heapFragmentation( const Heap_t* heap )
+{
+    if( !heap->freeBytes )
+    {
+        return 0.0;
+    }
+    size_t largest = 0;
+    for( size_t i = 0; i < heap->numFree; ++i )
+    {
+        if( heap->freeList[ i ].size > largest )
+        {
+            largest = heap->freeList[ i ].size;
+        }
+    }
+    return 1.0 - (double)largest / (double)heap->freeBytes;
+}
+
+static size_t hashAddress( uint32_t address, size_t capacity )
+{
+    return ( address * UINT32_C( 2654435761 ) ) % capacity;
+}
+
+static void liveMapInit( LiveMap_t* map, size_t capacity )
+{
+    map->capacity = capacity;
+    map->keys = checkedAlloc( capacity, sizeof( uint32_t ) );
+    map->values = checkedAlloc( capacity, sizeof( Placement_t ) );
+    map->used = checkedAlloc( capacity, sizeof( bool ) );
+}
+
+static void liveMapDestroy( LiveMap_t* map )
+{
+    free( map->keys );
+    free( map->values );
+    free( map->used );
+}
+
+static void liveMapPut( LiveMap_t* map, uint32_t address,
+                        const Placement_t* placement )
+{
+    size_t slot = hashAddress( address, map->capacity );
+    while( map->used[ slot ] && map->keys[ slot ] != address )
+    {
+        slot = ( slot + 1 ) % map->capacity;
+    }
+    map->used[ slot ] = true;
+    map->keys[ slot ] = address;
+    map->values[ slot ] = *placement;
+}
+
+static bool liveMapTake( LiveMap_t* map, uint32_t address,
+                         Placement_t* placement )
+{
+    size_t slot = hashAddress( address, map->capacity );
+    while( map->used[ slot ] )
+    {
+        if( map->keys[ slot ] == address )
+        {
+            *placement = map->values[ slot ];
+            map->used[ slot ] = false;
+
+            /* Re-insert the rest of the cluster to keep probing correct. */
+            size_t next = ( slot + 1 ) % map->capacity;
+            while( map->used[ next ] )
+            {
+                uint32_t key = map->keys[ next ];
+                Placement_t value = map->values[ next ];
+                map->used[ next ] = false;
+                liveMapPut( map, key, &value );
+                next = ( next + 1 ) % map->capacity;
+            }
+            return true;
+        }
+        slot = ( slot + 1 ) % map->capacity;
+    }
+    return false;
+}
+
+/**
+ * Replays @c events against a heap with the given regions, optionally fronted
+ * by block pools.
+ */
+static void replay( const TraceEvent_t* events, size_t numEvents,
+                    const size_t* regions, size_t numRegions,
+                    PoolClass_t* classes, size_t numClasses, size_t overhead,
+                    Report_t* report )
+{
+    memset( report, 0, sizeof( *report ) );
+
+    Heap_t heap;
+    if( !heapInit( &heap, regions, numRegions ) )
+    {
+        exit( EXIT_FAILURE );
+    }
+    report->minFree = heap.freeBytes;
+
+    LiveMap_t live;
+    liveMapInit( &live, numEvents * 2 + 1 );
+
+    for( size_t c = 0; c < numClasses; ++c )
+    {
+        classes[ c ].inUse = 0;
+        classes[ c ].peakInUse = 0;
+    }
+
+    for( size_t e = 0; e < numEvents; ++e )
+    {
+        const TraceEvent_t* event = &events[ e ];
+        size_t steps = 0;
+        Placement_t placement;
+
+        if( event->op == 'A' || event->op == 'X' )
+        {
+            size_t size = (size_t)event->size + overhead;
+            bool placed = false;
+
+            /* The port looks the smallest class that fits up in a table and
+             * falls back to the heap if that class is exhausted. */
+            size_t c = 0;
+            while( c < numClasses && classes[ c ].blockSize < size )
+            {
+                ++c;
+            }
+            placement.poolClass = SIZE_MAX;
+            if( c < numClasses )
+            {
+                ++steps;
+                if( classes[ c ].inUse < classes[ c ].blockCount )
+                {
+                    placement.poolClass = c;
+                    if( ++classes[ c ].inUse > classes[ c ].peakInUse )
+                    {
+                        classes[ c ].peakInUse = classes[ c ].inUse;
+                    }
+                    placed = true;
+                }
+            }
+            if( !placed && numClasses )
+            {
+                ++report->poolFallbacks;
+            }
+            if( !placed )
+            {
+                placed = heapAllocate( &heap, size, &placement.span, &steps );
+            }
+
+            if( !placed )
+            {
+                ++report->failed;
+            }
+            else if( event->op == 'A' )
+            {
+                liveMapPut( &live, event->address, &placement );
+            }
+            else
+            {
+                /* The device failed this request but the model did not;
+                 * release it again immediately. */
+                if( placement.poolClass != SIZE_MAX )
+                {
+                    --classes[ placement.poolClass ].inUse;
+                }
+                else
+                {
+                    heapFree( &heap, placement.span, &steps );
+                }
+            }
+
+            if( steps > report->worstAllocateSteps )
+            {
+                report->worstAllocateSteps = steps;
+            }
+        }
+        else if( event->op == 'F' )
+        {
+            if( !liveMapTake( &live, event->address, &placement ) )
+            {
+                /* Allocated before the trace window, or failed in the
+                 * model. */
+                continue;
+            }
+            if( placement.poolClass != SIZE_MAX )
+            {
+                --classes[ placement.poolClass ].inUse;
+            }
+            else
+            {
+                heapFree( &heap, placement.span, &steps );
+            }
+            if( steps > report->worstFreeSteps )
+            {
+                report->worstFreeSteps = steps;
+            }
+        }
+
+        size_t used = heap.totalSize - heap.freeBytes;
+        double fragmentation = heapFragmentation( &heap );
+        if( used > report->peakUsed )
+        {
+            report->peakUsed = used;
+            report->fragmentationAtPeak = fragmentation;
+        }
+        if( heap.freeBytes < report->minFree )
+        {
+            report->minFree = heap.freeBytes;
+        }
+        if( fragmentation > report->worstFragmentation )
+        {
+            report->worstFragmentation = fragmentation;
+        }
+    }
+
+    liveMapDestroy( &live );
+    heapDestroy( &heap );
+}
+
+static void printReport( const char* name, const Report_t* report )
+{
+    printf( "%s\n", name );
+    printf( "  peak heap used:         %zu bytes\n", report->peakUsed );
+    printf( "  lowest heap free:       %zu bytes\n", report->minFree );
+    printf( "  fragmentation at peak:  %.1f%%\n",
+            report->fragmentationAtPeak * 100.0 );
+    printf( "  worst fragmentation:    %.1f%%\n",
+            report->worstFragmentation * 100.0 );
+    printf( "  failed allocations:     %zu\n", report->failed );
+    printf( "  worst allocation steps: %zu\n", report->worstAllocateSteps );
+    printf( "  worst release steps:    %zu\n", report->worstFreeSteps );
+}
+
+/** Parses a comma separated list of sizes, or of "SIZExCOUNT" pairs. */
+static size_t parseList( const char* text, size_t* first, size_t* second,
+                         size_t maxItems )
+{
+    size_t numItems = 0;
+    const char* cursor = text;
+    while( *cursor && numItems < maxItems )
+    {
+        char* end = NULL;
+        errno = 0;
+        first[ numItems ] = strtoul( cursor, &end, 0 );
+        if( errno || end == cursor )
+        {
+            return 0;
+        }
+        cursor = end;
+        if( second )
+        {
+            if( *cursor != 'x' )
+            {
+                return 0;
+            }
+            ++cursor;
+            second[ numItems ] = strtoul( cursor, &end, 0 );
+            if( errno || end == cursor )
+            {
+                return 0;
+            }
+            cursor = end;
+        }
+        ++numItems;
+        if( *cursor == ',' )
+        {
+            ++cursor;
+        }
+        else if( *cursor )
+        {
+            return 0;
+        }
+    }
+    return *cursor ? 0 : numItems;
+}
+
+static void usage( const char* program )
+{
+    fprintf( stderr,
+             "usage: %s [-H heapBytes] [-R b1,b2,...] [-P s1xc1,...] "
+             "[-o overhead] trace.log\n",
+             program );
+}
+
+int main( int argc, char** argv )
+{
+    size_t heapSize = 65536;
+    size_t regions[ MAX_REGIONS ];
+    size_t numRegions = 0;
+    size_t classSizes[ MAX_CLASSES ] = { 32, 64, 128, 256, 512, 1024, 2048 };
+    size_t classCounts[ MAX_CLASSES ] = { 32, 32, 16, 8, 4, 4, 4 };
+    size_t numClasses = 7;
+    size_t overhead = 0;
+    const char* path = NULL;
+
+    for( int i = 1; i < argc; ++i )
+    {
+        bool hasValue = i + 1 < argc;
+        if( !strcmp( argv[ i ], "-H" ) && hasValue )
+        {
+            heapSize = strtoul( argv[ ++i ], NULL, 0 );
+        }
+        else if( !strcmp( argv[ i ], "-R" ) && hasValue )
+        {
+            numRegions =
+                parseList( argv[ ++i ], regions, NULL, MAX_REGIONS );
+            if( !numRegions )
+            {
+                usage( argv[ 0 ] );
+                return EXIT_FAILURE;
+            }
+        }
+        else if( !strcmp( argv[ i ], "-P" ) && hasValue )
+        {
+            numClasses = parseList( argv[ ++i ], classSizes, classCounts,
+                                    MAX_CLASSES );
+            if( !numClasses )
+            {
+                usage( argv[ 0 ] );
+                return EXIT_FAILURE;
+            }
+        }
+        else if( !strcmp( argv[ i ], "-o" ) && hasValue )
+        {
+            overhead = strtoul( argv[ ++i ], NULL, 0 );
+        }
+        else if( argv[ i ][ 0 ] != '-' && !path )
+        {
+            path = argv[ i ];
+        }
+        else
+        {
+            usage( argv[ 0 ] );
+            return EXIT_FAILURE;
+        }
+    }
+    if( !path )
+    {
+        usage( argv[ 0 ] );
+        return EXIT_FAILURE;
+    }
+    if( !numRegions )
+    {
+        regions[ 0 ] = heapSize / 2;
+        regions[ 1 ] = heapSize - heapSize / 2;
+        numRegions = 2;
+    }
+
+    FILE* file = fopen( path, "r" );
+    if( !file )
+    {
+        fprintf( stderr, "Cannot open %s: %s\n", path, strerror( errno ) );
+        return EXIT_FAILURE;
+    }
+
+    size_t capacity = 1024;
+    size_t numEvents = 0;
+    TraceEvent_t* events = checkedAlloc( capacity, sizeof( TraceEvent_t ) );
+    size_t numSites = 0;
+    unsigned long dropped = 0;
+    char line[ 512 ];
+    while( fgets( line, sizeof( line ), file ) )
+    {
+        const char* marker = strstr( line, "AIATRACE " );
+        if( !marker )
+        {
+            continue;
+        }
+        marker += strlen( "AIATRACE " );
+
+        char op = marker[ 0 ];
+        if( op == 'S' )
+        {
+            ++numSites;
+            continue;
+        }
+        if( op == 'D' )
+        {
+            sscanf( marker + 1, "%lu", &dropped );
+            continue;
+        }
+
+        unsigned long tick, address, size, site;
+        if( ( op != 'A' && op != 'F' && op != 'X' ) ||
+            sscanf( marker + 1, "%lu %lx %lu %lu", &tick, &address, &size,
+                    &site ) != 4 )
+        {
+            continue;
+        }
+        if( numEvents == capacity )
+        {
+            capacity *= 2;
+            TraceEvent_t* grown =
+                realloc( events, capacity * sizeof( TraceEvent_t ) );
+            if( !grown )
+            {
+                fprintf( stderr, "Out of memory\n" );
+                return EXIT_FAILURE;
+            }
+            events = grown;
+        }
+        events[ numEvents ].op = op;
+        events[ numEvents ].address = (uint32_t)address;
+        events[ numEvents ].size = (uint32_t)size;
+        ++numEvents;
+    }
+    fclose( file );
+
+    printf( "%zu events from %zu call sites, %lu dropped on the device\n\n",
+            numEvents, numSites, dropped );
+    if( dropped )
+    {
+        printf( "Results only cover the trace window; increase "
+                "AIA_MEMORY_TRACE_CAPACITY for a complete session.\n\n" );
+    }
+
+    Report_t report;
+    char name[ 128 ];
+
+    snprintf( name, sizeof( name ), "heap_4, %zu bytes", heapSize );
+    replay( events, numEvents, &heapSize, 1, NULL, 0, overhead, &report );
+    printReport( name, &report );
+
+    int length = snprintf( name, sizeof( name ), "heap_5, regions" );
+    for( size_t i = 0; i < numRegions && length < (int)sizeof( name ); ++i )
+    {
+        length += snprintf( name + length, sizeof( name ) - length, "%s%zu",
+                            i ? "," : " ", regions[ i ] );
+    }
+    replay( events, numEvents, regions, numRegions, NULL, 0, overhead,
+            &report );
+    printReport( name, &report );
+
+    PoolClass_t classes[ MAX_CLASSES ];
+    size_t poolBytes = 0;
+    for( size_t c = 0; c < numClasses; ++c )
+    {
+        classes[ c ].blockSize = classSizes[ c ];
+        classes[ c ].blockCount = classCounts[ c ];
+        poolBytes += classSizes[ c ] * classCounts[ c ];
+    }
+    snprintf( name, sizeof( name ),
+              "pools (%zu bytes reserved) over heap_4, %zu bytes", poolBytes,
+              heapSize );
+    replay( events, numEvents, &heapSize, 1, classes, numClasses, overhead,
+            &report );
+    printReport( name, &report );
+    printf( "  heap fallbacks:         %zu\n", report.poolFallbacks );
+    for( size_t c = 0; c < numClasses; ++c )
+    {
+        printf( "  class %5zu: peak %zu of %zu blocks\n", classes[ c ].blockSize,
+                classes[ c ].peakInUse, classes[ c ].blockCount );
+    }
+
+    free( events );
+    return EXIT_SUCCESS;
+}